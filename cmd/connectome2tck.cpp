@@ -331,10 +331,10 @@ void run ()
       }
     } else if (file_format == 2) { // Single file
       std::string path = prefix;
-      if (path.rfind (".tck") != path.size() - 4)
+      if (!is_track_file (path))
         path += ".tck";
       std::string weights_path = weights_prefix;
-      if (weights_prefix.size() && weights_path.rfind (".tck") != weights_path.size() - 4)
+      if (weights_prefix.size() && !Path::has_suffix (weights_path, ".csv"))
         weights_path += ".csv";
       generator.write (path, weights_path);
     }
@@ -367,10 +367,10 @@ void run ()
         break;
       case 2: // Single file
         std::string path = prefix;
-        if (path.rfind (".tck") != path.size() - 4)
+        if (!is_track_file (path))
           path += ".tck";
         std::string weights_path = weights_prefix;
-        if (weights_prefix.size() && weights_path.rfind (".tck") != weights_path.size() - 4)
+        if (weights_prefix.size() && !Path::has_suffix (weights_path, ".csv"))
           weights_path += ".csv";
         writer.add (nodes, path, weights_path);
         break;
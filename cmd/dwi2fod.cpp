@@ -278,6 +278,7 @@ void run ()
     CSD_Processor processor (shared, mask);
     auto dwi = header_in.get_image<float>().with_direct_io (3);
     ThreadedLoop ("performing constrained spherical deconvolution", dwi, 0, 3)
+        .with_work_stealing (mask)
         .run (processor, dwi, fod);
 
   } else if (algorithm == 1) {
@@ -323,6 +324,7 @@ void run ()
                   + str(shared.num_shells()) + " shell" + (shared.num_shells() > 1 ? "s" : "") + ", "
                   + str(num_tissues) + " tissue" + (num_tissues > 1 ? "s" : "") + ")",
                   dwi, 0, 3)
+        .with_work_stealing (mask)
         .run (processor, dwi);
 
   } else {
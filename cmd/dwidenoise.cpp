@@ -17,6 +17,9 @@
 
 #include "command.h"
 #include "image.h"
+#include "math/math.h"
+
+#include <random>
 
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
@@ -29,6 +32,8 @@ const char* const dtypes[] = { "float32", "float64", NULL };
 
 const char* const estimators[] = { "exp1", "exp2", NULL };
 
+const char* const decompositions[] = { "full", "randomized", NULL };
+
 
 void usage ()
 {
@@ -64,7 +69,12 @@ void usage ()
 
     + "Cordero-Grande, L.; Christiaens, D.; Hutter, J.; Price, A.N.; Hajnal, J.V. " // Internal
     "Complex diffusion-weighted image estimation via matrix recovery under general noise models. "
-    "NeuroImage, 2019, 200, 391-404, doi: 10.1016/j.neuroimage.2019.06.039";
+    "NeuroImage, 2019, 200, 391-404, doi: 10.1016/j.neuroimage.2019.06.039"
+
+    + "* If using -decomposition randomized: \n"
+    "Halko, N.; Martinsson, P.G. & Tropp, J.A. "
+    "Finding structure with randomness: probabilistic algorithms for constructing approximate matrix decompositions. "
+    "SIAM Review, 2011, 53(2), 217-288, doi: 10.1137/090771806";
 
   ARGUMENTS
   + Argument ("dwi", "the input diffusion-weighted image.").type_image_in ()
@@ -94,7 +104,18 @@ void usage ()
     + Option ("estimator", "Select the noise level estimator (default = Exp2), either: \n"
                            "* Exp1: the original estimator used in Veraart et al. (2016), or \n"
                            "* Exp2: the improved estimator introduced in Cordero-Grande et al. (2019).")
-    +   Argument ("Exp1/Exp2").type_choice(estimators);
+    +   Argument ("Exp1/Exp2").type_choice(estimators)
+
+    + Option ("decomposition", "Select how the eigendecomposition of each patch is computed (default = full), either: \n"
+                               "* full: compute all eigenvalues & eigenvectors, or \n"
+                               "* randomized: only estimate the largest eigenvalues, and the eigenvectors of the "
+                               "signal components, using randomized subspace iteration (Halko et al., 2011). "
+                               "This is faster for data with many volumes. As the smallest eigenvalue is then "
+                               "not available, the MP threshold is based on the upper edge of the MP distribution "
+                               "instead, so that the noise level estimates and the number of signal components "
+                               "retained may differ slightly from those of the full decomposition. The subspace "
+                               "iteration starts from a fixed pseudo-random matrix, so results are reproducible.")
+    +   Argument ("full/randomized").type_choice(decompositions);
 
 
   COPYRIGHT = "Copyright (c) 2016 New York University, University of Antwerp, and the MRtrix3 contributors \n \n"
@@ -130,13 +151,25 @@ class DenoisingFunctor {
   using SValsType = Eigen::VectorXd;
 
   DenoisingFunctor (int ndwi, const vector<uint32_t>& extent,
-                    Image<bool>& mask, Image<real_type>& noise, bool exp1)
+                    Image<bool>& mask, Image<real_type>& noise, bool exp1, bool randomized)
     : extent {{extent[0]/2, extent[1]/2, extent[2]/2}},
       m (ndwi), n (extent[0]*extent[1]*extent[2]),
-      r (std::min(m,n)), q (std::max(m,n)), exp1(exp1),
+      r (std::min(m,n)), q (std::max(m,n)), exp1(exp1), randomized (randomized),
       X (m,n), pos {{0, 0, 0}},
       mask (mask), noise (noise)
-  { }
+  {
+    if (randomized) {
+      // starting point for the subspace iteration, drawn from a generator
+      // with a fixed seed, so that results are reproducible, and shared by
+      // all threads so that they don't depend on how voxels are distributed:
+      std::mt19937 rng (1);
+      std::normal_distribution<double> normal;
+      Omega.resize (r, r);
+      for (ssize_t j = 0; j < r; ++j)
+        for (ssize_t i = 0; i < r; ++i)
+          Omega(i,j) = F (normal (rng));
+    }
+  }
 
   template <typename ImageType>
   void operator () (ImageType& dwi, ImageType& out)
@@ -157,37 +190,53 @@ class DenoisingFunctor {
       XtX.template triangularView<Eigen::Lower>() = X * X.adjoint();
     else
       XtX.template triangularView<Eigen::Lower>() = X.adjoint() * X;
-    Eigen::SelfAdjointEigenSolver<MatrixType> eig (XtX);
-    // eigenvalues sorted in increasing order:
-    SValsType s = eig.eigenvalues().template cast<double>();
-
-    // Marchenko-Pastur optimal threshold
-    const double lam_r = std::max(s[0], 0.0) / q;
-    double clam = 0.0;
-    sigma2 = 0.0;
-    ssize_t cutoff_p = 0;
-    for (ssize_t p = 0; p < r; ++p)     // p+1 is the number of noise components
-    {                                   // (as opposed to the paper where p is defined as the number of signal components)
-      double lam = std::max(s[p], 0.0) / q;
-      clam += lam;
-      double gam = double(p+1) / (exp1 ? q : q-(r-p-1));
-      double sigsq1 = clam / double(p+1);
-      double sigsq2 = (lam - lam_r) / (4.0 * std::sqrt(gam));
-      // sigsq2 > sigsq1 if signal else noise
-      if (sigsq2 < sigsq1) {
-        sigma2 = sigsq1;
-        cutoff_p = p+1;
+    if (randomized) {
+      // only the largest eigenvalues & the eigenvectors of the
+      // signal components are estimated:
+      const ssize_t cutoff_p = signal_subspace (XtX);
+      // project data onto the signal components:
+      if (cutoff_p == r)
+        X.col (n/2).setZero();
+      else if (cutoff_p > 0) {
+        if (m <= n)
+          X.col (n/2) = U * ( U.adjoint() * X.col(n/2) );
+        else
+          X.col (n/2) = X * ( U * U.row(n/2).adjoint() );
       }
     }
+    else {
+      Eigen::SelfAdjointEigenSolver<MatrixType> eig (XtX);
+      // eigenvalues sorted in increasing order:
+      SValsType s = eig.eigenvalues().template cast<double>();
+
+      // Marchenko-Pastur optimal threshold
+      const double lam_r = std::max(s[0], 0.0) / q;
+      double clam = 0.0;
+      sigma2 = 0.0;
+      ssize_t cutoff_p = 0;
+      for (ssize_t p = 0; p < r; ++p)     // p+1 is the number of noise components
+      {                                   // (as opposed to the paper where p is defined as the number of signal components)
+        double lam = std::max(s[p], 0.0) / q;
+        clam += lam;
+        double gam = double(p+1) / (exp1 ? q : q-(r-p-1));
+        double sigsq1 = clam / double(p+1);
+        double sigsq2 = (lam - lam_r) / (4.0 * std::sqrt(gam));
+        // sigsq2 > sigsq1 if signal else noise
+        if (sigsq2 < sigsq1) {
+          sigma2 = sigsq1;
+          cutoff_p = p+1;
+        }
+      }
 
-    if (cutoff_p > 0) {
-      // recombine data using only eigenvectors above threshold:
-      s.head (cutoff_p).setZero();
-      s.tail (r-cutoff_p).setOnes();
-      if (m <= n)
-        X.col (n/2) = eig.eigenvectors() * ( s.cast<F>().asDiagonal() * ( eig.eigenvectors().adjoint() * X.col(n/2) ));
-      else
-        X.col (n/2) = X * ( eig.eigenvectors() * ( s.cast<F>().asDiagonal() * eig.eigenvectors().adjoint().col(n/2) ));
+      if (cutoff_p > 0) {
+        // recombine data using only eigenvectors above threshold:
+        s.head (cutoff_p).setZero();
+        s.tail (r-cutoff_p).setOnes();
+        if (m <= n)
+          X.col (n/2) = eig.eigenvectors() * ( s.cast<F>().asDiagonal() * ( eig.eigenvectors().adjoint() * X.col(n/2) ));
+        else
+          X.col (n/2) = X * ( eig.eigenvectors() * ( s.cast<F>().asDiagonal() * eig.eigenvectors().adjoint().col(n/2) ));
+      }
     }
 
     // Store output
@@ -204,8 +253,10 @@ class DenoisingFunctor {
 private:
   const std::array<ssize_t, 3> extent;
   const ssize_t m, n, r, q;
-  const bool exp1;
+  const bool exp1, randomized;
   MatrixType X;
+  MatrixType Omega, Q, CQ, U, CU;
+  Eigen::HouseholderQR<MatrixType> qr;
   std::array<ssize_t, 3> pos;
   double sigma2;
   Image<bool> mask;
@@ -233,6 +284,87 @@ class DenoisingFunctor {
     dwi.index(2) = pos[2];
   }
 
+  // Marchenko-Pastur threshold, given the l largest eigenvalues of the
+  // covariance matrix (theta, in increasing order) and its trace. As the
+  // smallest eigenvalue is not available, it is replaced by the lower edge
+  // of the MP distribution, sigma2 (1-sqrt(gamma))^2, so that an eigenvalue
+  // is deemed noise if below the upper edge, sigma2 (1+sqrt(gamma))^2; the
+  // noise variance sigma2 is obtained from the trace & the larger
+  // eigenvalues. Returns the number of noise components (setting sigma2),
+  // or -1 if the threshold lies below the eigenvalues provided:
+  ssize_t mp_threshold (const SValsType& theta, double trace)
+  {
+    const ssize_t l = theta.size();
+    double sum_above = 0.0;
+    for (ssize_t p = r-1; p >= r-l; --p) {
+      const double lam = std::max (theta[p-(r-l)], 0.0) / q;
+      const double clam = std::max (trace - sum_above, 0.0) / q;
+      const double gam = double(p+1) / (exp1 ? q : q-(r-p-1));
+      const double sigsq1 = clam / double(p+1);
+      if (lam < sigsq1 * Math::pow2 (1.0 + std::sqrt (gam))) {
+        sigma2 = sigsq1;
+        return p+1;
+      }
+      sum_above += theta[p-(r-l)];
+    }
+    sigma2 = 0.0;
+    return l == r ? 0 : -1;
+  }
+
+  // estimate the number of noise components (returned), the noise level
+  // (sigma2) and the eigenvectors of the signal components (into the columns
+  // of U), from the largest eigenvalues of C only (of which only the lower
+  // triangle is set), using randomized subspace iteration with Rayleigh-Ritz
+  // extraction. The subspace is enlarged as required to hold all signal
+  // components with some margin. Iterations stop once the residual of each
+  // Ritz pair is small relative to the gap between its Ritz value & the
+  // largest remaining eigenvalue, so that the error in the Ritz vectors is
+  // small, or can no longer be reduced at the working precision:
+  ssize_t signal_subspace (const MatrixType& C)
+  {
+    using RealType = typename Eigen::NumTraits<F>::Real;
+    const RealType tolerance = std::sqrt (std::numeric_limits<RealType>::epsilon());
+    const RealType precision = 10 * std::numeric_limits<RealType>::epsilon();
+    const size_t max_iterations = 20;
+    const ssize_t initial_subspace_size = 20;
+    const double trace = C.diagonal().real().template cast<double>().sum();
+
+    const auto S = C.template selfadjointView<Eigen::Lower>();
+    ssize_t l = std::min (initial_subspace_size, r);
+    while (true) {
+      if (l == r) {
+        Eigen::SelfAdjointEigenSolver<MatrixType> eig (S);
+        const ssize_t cutoff_p = mp_threshold (eig.eigenvalues().template cast<double>(), trace);
+        U = eig.eigenvectors().rightCols (r-cutoff_p);
+        return cutoff_p;
+      }
+
+      CQ.noalias() = S * Omega.leftCols (l);
+      for (size_t iter = 0; ; ++iter) {
+        qr.compute (CQ);
+        Q = qr.householderQ() * MatrixType::Identity (r, l);
+        CQ.noalias() = S * Q;
+        Eigen::SelfAdjointEigenSolver<MatrixType> ritz (Q.adjoint() * CQ);
+        const SValsType theta = ritz.eigenvalues().template cast<double>();
+        const ssize_t cutoff_p = mp_threshold (theta, trace);
+        const ssize_t k = r - cutoff_p;
+        if (cutoff_p < 0 || 2*k + 10 > l) {
+          l = std::min (std::max (2*l, 2*k + 10), r);
+          break;
+        }
+        if (k == 0)
+          return cutoff_p;
+        const auto theta_k = ritz.eigenvalues().tail (k);
+        U.noalias() = Q * ritz.eigenvectors().rightCols (k);
+        CU.noalias() = CQ * ritz.eigenvectors().rightCols (k);
+        CU -= U * theta_k.template cast<F>().asDiagonal();
+        if (iter+1 >= max_iterations || (CU.colwise().norm().transpose().array() <=
+              (tolerance * (theta_k.array() - RealType (theta[l-k-1]))).max (precision * theta_k[k-1])).all())
+          return cutoff_p;
+      }
+    }
+  }
+
   inline size_t wrapindex(int r, int axis, int max) const {
     // patch handling at image edges
     int rr = pos[axis] + r;
@@ -246,7 +378,7 @@ class DenoisingFunctor {
 
 template <typename T>
 void process_image (Header& data, Image<bool>& mask, Image<real_type> noise,
-                    const std::string& output_name, const vector<uint32_t>& extent, bool exp1)
+                    const std::string& output_name, const vector<uint32_t>& extent, bool exp1, bool randomized)
   {
     auto input = data.get_image<T>().with_direct_io(3);
     // create output
@@ -254,8 +386,10 @@ void process_image (Header& data, Image<bool>& mask, Image<real_type> noise,
     header.datatype() = DataType::from<T>();
     auto output = Image<T>::create (output_name, header);
     // run
-    DenoisingFunctor<T> func (data.size(3), extent, mask, noise, exp1);
-    ThreadedLoop ("running MP-PCA denoising", data, 0, 3).run (func, input, output);
+    DenoisingFunctor<T> func (data.size(3), extent, mask, noise, exp1, randomized);
+    ThreadedLoop ("running MP-PCA denoising", data, 0, 3)
+        .with_work_stealing (mask)
+        .run (func, input, output);
   }
 
 
@@ -299,6 +433,7 @@ void run ()
   INFO("selected patch size: " + str(extent[0]) + " x " + str(extent[1]) + " x " + str(extent[2]) + ".");
 
   bool exp1 = get_option_value("estimator", 1) == 0;    // default: Exp2 (unbiased estimator)
+  bool randomized = get_option_value("decomposition", 0) == 1;    // default: full eigendecomposition
 
   Image<real_type> noise;
   opt = get_options("noise");
@@ -314,19 +449,19 @@ void run ()
   switch (prec) {
     case 0:
       INFO("select real float32 for processing");
-      process_image<float>(dwi, mask, noise, argument[1], extent, exp1);
+      process_image<float>(dwi, mask, noise, argument[1], extent, exp1, randomized);
       break;
     case 1:
       INFO("select real float64 for processing");
-      process_image<double>(dwi, mask, noise, argument[1], extent, exp1);
+      process_image<double>(dwi, mask, noise, argument[1], extent, exp1, randomized);
       break;
     case 2:
       INFO("select complex float32 for processing");
-      process_image<cfloat>(dwi, mask, noise, argument[1], extent, exp1);
+      process_image<cfloat>(dwi, mask, noise, argument[1], extent, exp1, randomized);
       break;
     case 3:
       INFO("select complex float64 for processing");
-      process_image<cdouble>(dwi, mask, noise, argument[1], extent, exp1);
+      process_image<cdouble>(dwi, mask, noise, argument[1], extent, exp1, randomized);
       break;
   }
 
@@ -20,6 +20,7 @@
 #include "thread_queue.h"
 #include "transform.h"
 #include "algo/loop.h"
+#include "dwi/tractography/file_base.h"
 #include "fixel/helpers.h"
 #include "fixel/index_remapper.h"
 #include "fixel/keys.h"
@@ -199,7 +200,7 @@ class SubjectFixelImport : public Math::Stats::SubjectDataImportBase
 
 void run()
 {
-  if (Path::has_suffix (argument[4], ".tck"))
+  if (DWI::Tractography::is_track_file (argument[4]))
     throw Exception ("This version of fixelcfestats requires as input not a track file, but a "
                      "pre-calculated fixel-fixel connectivity matrix; in addition, input fixel "
                      "data must be pre-smoothed. Please check command / pipeline documentation "
@@ -57,7 +57,17 @@ void usage ()
     + Argument ("value").type_float (0.0, 90.0)
 
   + Option ("mask", "provide a fixel data file containing a mask of those fixels to be computed; fixels outside the mask will be empty in the output matrix")
-    + Argument ("file").type_image_in();
+    + Argument ("file").type_image_in()
+
+  + Option ("quantise", "store the connectivity values as unsigned integers with the specified number of bits (8 or 16), "
+                        "rather than as 32-bit floating-point; this reduces the size of the matrix on disk and in memory "
+                        "at the expense of precision (maximal error of 1/510 or 1/131070 respectively)")
+    + Argument ("bits").type_integer (8, 16)
+
+  + Option ("memory", "construct the matrix out-of-core, holding no more than approximately this amount of data (in MB) "
+                      "in RAM at any one time; intermediate results are instead written to temporary files "
+                      "(see config file option TmpFileDir). By default, the entire matrix is constructed in RAM.")
+    + Argument ("MB").type_integer (1);
 
 }
 
@@ -93,6 +103,32 @@ void run()
       fixel_mask.value() = true;
   }
 
+  DataType value_datatype = DataType::Float32;
+  opt = get_options ("quantise");
+  if (opt.size()) {
+    const int bits = opt[0][0];
+    if (bits == 8)
+      value_datatype = DataType::UInt8;
+    else if (bits == 16)
+      value_datatype = DataType::UInt16;
+    else
+      throw Exception ("Connectivity values can only be quantised to 8 or 16 bits");
+  }
+
+  opt = get_options ("memory");
+  if (opt.size()) {
+    Fixel::Matrix::generate_and_write (argument[1],
+                                       index_image,
+                                       fixel_mask,
+                                       angular_threshold,
+                                       connectivity_threshold,
+                                       argument[2],
+                                       size_t(int64_t(opt[0][0])) * 1024 * 1024,
+                                       KeyValues(),
+                                       value_datatype);
+    return;
+  }
+
   auto connectivity_matrix = Fixel::Matrix::generate (argument[1],
                                                       index_image,
                                                       fixel_mask,
@@ -100,7 +136,9 @@ void run()
 
   Fixel::Matrix::normalise_and_write (connectivity_matrix,
                                       connectivity_threshold,
-                                      argument[2]);
+                                      argument[2],
+                                      KeyValues(),
+                                      value_datatype);
 
 }
 
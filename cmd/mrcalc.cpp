@@ -295,13 +295,22 @@ class ThreadLocalStorage : public vector<ThreadLocalStorageItem> { NOMEMALIGN
           if (image.size(n) > 1)
             image.index(n) = iter->index(n);
 
+        // load entire rows at once where possible, to avoid a call per voxel
+        // when the data need converting:
+        const bool by_row = axes[0] < image.ndim() && image.size (axes[0]) > 1;
+        if (by_row)
+          image.index(axes[0]) = 0;
+
         size_t n = 0;
         for (size_t y = 0; y < size[1]; ++y) {
           if (axes[1] < image.ndim()) if (image.size (axes[1]) > 1) image.index(axes[1]) = y;
-          for (size_t x = 0; x < size[0]; ++x) {
-            if (axes[0] < image.ndim()) if (image.size (axes[0]) > 1) image.index(axes[0]) = x;
-            chunk[n++] = image.value();
+          if (by_row) {
+            image.get_values (axes[0], &chunk[n], size[0]);
+            n += size[0];
+            continue;
           }
+          for (size_t x = 0; x < size[0]; ++x)
+            chunk[n++] = image.value();
         }
       }
 
@@ -781,9 +790,11 @@ class ThreadFunctor { NOMEMALIGN
 
       Chunk& chunk = top_entry.evaluate (storage);
 
-      auto value = chunk.cbegin();
-      for (auto l = loop (image); l; ++l)
-        image.value() = *(value++);
+      image.index (storage.axes[0]) = 0;
+      for (size_t y = 0; y < storage.size[1]; ++y) {
+        image.index (storage.axes[1]) = y;
+        image.set_values (storage.axes[0], &chunk[y*storage.size[0]], storage.size[0]);
+      }
     }
 
 
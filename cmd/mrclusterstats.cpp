@@ -93,7 +93,12 @@ void usage ()
                            "This disables TFCE, which is the default otherwise.")
       + Argument ("value").type_float (1.0e-6)
 
-    + Option ("connectivity", "use 26-voxel-neighbourhood connectivity (Default: 6)");
+    + Option ("connectivity", "use 26-voxel-neighbourhood connectivity (Default: 6)")
+
+    + Option ("tfce_singlepass", "compute TFCE in a single pass over the data using a union-find algorithm, "
+                                 "rather than by repeating the connected-component analysis at each height. "
+                                 "This is much faster, but elements lying within floating-point precision "
+                                 "of a height may contribute slightly differently.");
 
 }
 
@@ -186,6 +191,9 @@ void run() {
   const value_type tfce_H = get_option_value ("tfce_h", DEFAULT_TFCE_H);
   const value_type tfce_E = get_option_value ("tfce_e", DEFAULT_TFCE_E);
   const bool use_tfce = !std::isfinite (cluster_forming_threshold);
+  const bool use_tfce_singlepass = get_options ("tfce_singlepass").size();
+  if (use_tfce_singlepass && !use_tfce)
+    WARN ("Option -tfce_singlepass has no effect when performing a threshold-based cluster analysis");
   const bool do_26_connectivity = get_options("connectivity").size();
   const bool do_nonstationarity_adjustment = get_options ("nonstationarity").size();
   const default_type empirical_skew = get_option_value ("skew_nonstationarity", DEFAULT_EMPIRICAL_SKEW);
@@ -342,8 +350,12 @@ void run() {
 
   std::shared_ptr<Stats::EnhancerBase> enhancer;
   if (use_tfce) {
-    std::shared_ptr<Stats::TFCE::EnhancerBase> base (new Stats::Cluster::ClusterSize (connector, cluster_forming_threshold));
-    enhancer.reset (new Stats::TFCE::Wrapper (base, tfce_dh, tfce_E, tfce_H));
+    if (use_tfce_singlepass) {
+      enhancer.reset (new Stats::Cluster::ClusterSizeTFCE (connector, tfce_dh, tfce_E, tfce_H));
+    } else {
+      std::shared_ptr<Stats::TFCE::EnhancerBase> base (new Stats::Cluster::ClusterSize (connector, cluster_forming_threshold));
+      enhancer.reset (new Stats::TFCE::Wrapper (base, tfce_dh, tfce_E, tfce_H));
+    }
   } else {
     enhancer.reset (new Stats::Cluster::ClusterSize (connector, cluster_forming_threshold));
   }
@@ -14,13 +14,12 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
-#include <unsupported/Eigen/FFT>
-
 #include "axes.h"
 #include "command.h"
 #include "image.h"
 #include "progressbar.h"
 #include "algo/threaded_loop.h"
+#include "math/fft.h"
 #include <numeric>
 
 using namespace MR;
@@ -97,21 +96,10 @@ class ComputeSlice
       out (out),
       im1 (in.size(slice_axes[0]), in.size(slice_axes[1])),
       im2 (im1.rows(), im1.cols()) {
-        prealloc_FFT();
-      }
-
-    ComputeSlice (const ComputeSlice& other) :
-      outer_axes (other.outer_axes),
-      slice_axes (other.slice_axes),
-      nsh (other.nsh),
-      minW (other.minW),
-      maxW (other.maxW),
-      in (other.in),
-      out (other.out),
-      fft (),
-      im1 (in.size(slice_axes[0]), in.size(slice_axes[1])),
-      im2 (im1.rows(), im1.cols()) {
-        prealloc_FFT();
+        // create all FFT plans upfront, since this isn't
+        // thread-safe in FFTW (copies create their own):
+        fft.prepare (im1.rows());
+        fft.prepare (im1.cols());
       }
 
 
@@ -135,38 +123,21 @@ class ComputeSlice
     const vector<size_t>& slice_axes;
     const int nsh, minW, maxW;
     Image<value_type> in, out;
-    Eigen::FFT<double> fft;
-    Eigen::MatrixXcd im1, im2, shifted;
-    Eigen::VectorXcd v;
-
-    void prealloc_FFT () {
-      // needed to avoid within-thread allocations,
-      // which aren't thread-safe in FFTW:
-#ifdef EIGEN_FFTW_DEFAULT
-      Eigen::VectorXcd tmp (im1.rows());
-      FFT (tmp);
-      iFFT (tmp);
-      tmp.resize (im1.cols());
-      FFT (tmp);
-      iFFT (tmp);
-#endif
-    }
+    Math::ColumnFFT<double> fft;
+    Eigen::MatrixXcd im1, im2, spectra, pairs;
+    Eigen::MatrixXd shifted;
+    Eigen::ArrayXXd TV;
+    Eigen::ArrayXd TV1arr, TV2arr;
 
-    template <typename Derived> FORCE_INLINE void FFT      (Eigen::MatrixBase<Derived>&& vec) { fft.fwd (v, vec); vec = v; }
-    template <typename Derived> FORCE_INLINE void FFT      (Eigen::MatrixBase<Derived>& vec) { FFT (std::move (vec)); }
-    template <typename Derived> FORCE_INLINE void iFFT     (Eigen::MatrixBase<Derived>&& vec) { fft.inv (v, vec); vec = v; }
-    template <typename Derived> FORCE_INLINE void iFFT     (Eigen::MatrixBase<Derived>& vec) { iFFT (std::move (vec)); }
-    template <typename Derived> FORCE_INLINE void row_FFT  (Eigen::MatrixBase<Derived>& mat) { for (auto n = 0; n < mat.rows(); ++n)  FFT (mat.row(n)); }
-    template <typename Derived> FORCE_INLINE void row_iFFT (Eigen::MatrixBase<Derived>& mat) { for (auto n = 0; n < mat.rows(); ++n) iFFT (mat.row(n)); }
-    template <typename Derived> FORCE_INLINE void col_FFT  (Eigen::MatrixBase<Derived>& mat) { for (auto n = 0; n < mat.cols(); ++n)  FFT (mat.col(n)); }
-    template <typename Derived> FORCE_INLINE void col_iFFT (Eigen::MatrixBase<Derived>& mat) { for (auto n = 0; n < mat.cols(); ++n) iFFT (mat.col(n)); }
+    // wrap index into [0, n):
+    static FORCE_INLINE int wrap (int index, int n) { return ((index % n) + n) % n; }
 
 
 
     FORCE_INLINE void unring_2d ()
     {
-      row_FFT (im1);
-      col_FFT (im1);
+      fft.forward (im1.transpose());
+      fft.forward (im1);
 
       for (int k = 0; k < im1.cols(); k++) {
         double ck = (1.0+cos(2.0*Math::pi*(double(k)/im1.cols())))*0.5;
@@ -182,8 +153,8 @@ class ComputeSlice
         }
       }
 
-      row_iFFT (im1);
-      col_iFFT (im2);
+      fft.inverse (im1.transpose());
+      fft.inverse (im2);
 
       unring_1d (im1);
       unring_1d (im2.transpose());
@@ -200,7 +171,12 @@ class ComputeSlice
       {
         const int n = eig.rows();
         const int numlines = eig.cols();
+        spectra.resize (n, nsh+1);
+        pairs.resize (n, nsh+1);
         shifted.resize (n, 2*nsh+1);
+        TV.resize (2*nsh+1, n);
+        TV1arr.resize (2*nsh+1);
+        TV2arr.resize (2*nsh+1);
 
         int shifts [2*nsh+1];
         shifts[0] = 0;
@@ -209,41 +185,53 @@ class ComputeSlice
           shifts[1+nsh+j] = -(j+1);
         }
 
-        double TV1arr[2*nsh+1];
-        double TV2arr[2*nsh+1];
-
+        // Since the input image is real and the filters applied in
+        // unring_2d() are symmetric, each line holds a Hermitian spectrum,
+        // and so do its shifted versions: these are therefore real, and two
+        // of them can be obtained from a single complex inverse FFT. Each
+        // column of spectra holds the spectra of the lines shifted by +s
+        // and -s, the latter multiplied by i:
+        const cdouble I (0.0, 1.0);
         for (int k = 0; k < numlines; k++) {
-          shifted.col(0) = eig.col(k);
+          spectra.col(0) = eig.col(k);
 
           const int maxn = (n&1) ? (n-1)/2 : n/2-1;
 
-          for (int j = 1; j < 2*nsh+1; j++) {
+          for (int j = 1; j < nsh+1; j++) {
             double phi = Math::pi*double(shifts[j])/double(n*nsh);
             cdouble u (std::cos(phi), std::sin(phi));
             cdouble e (1.0, 0.0);
-            shifted(0,j) = shifted(0,0);
+            spectra(0,j) = spectra(0,0) + I * spectra(0,0);
 
             if (!(n&1))
-              shifted(n/2,j) = cdouble(0.0, 0.0);
+              spectra(n/2,j) = cdouble(0.0, 0.0);
 
             for (int l = 0; l < maxn; l++) {
               e = u*e;
-              int L = l+1; shifted(L,j) = e * shifted(L,0);
-              L = n-1-l;   shifted(L,j) = std::conj(e) * shifted(L,0);
+              int L = l+1; spectra(L,j) = e * spectra(L,0) + I * (std::conj(e) * spectra(L,0));
+              L = n-1-l;   spectra(L,j) = std::conj(e) * spectra(L,0) + I * (e * spectra(L,0));
             }
           }
 
+          fft.inverse (spectra, pairs);
 
-          col_iFFT (shifted);
+          shifted.col(0) = pairs.col(0).real();
+          shifted.middleCols(1,nsh) = pairs.rightCols(nsh).real();
+          shifted.middleCols(1+nsh,nsh) = pairs.rightCols(nsh).imag();
+
+          // total variation between each sample & the previous one,
+          // held with all shifts for each sample contiguous:
+          for (int j = 0; j < 2*nsh+1; ++j) {
+            for (int l = 0; l < n; ++l)
+              TV(j,l) = abs (shifted(l,j) - shifted(l ? l-1 : n-1, j));
+          }
 
           for (int j = 0; j < 2*nsh+1; ++j) {
             TV1arr[j] = 0.0;
             TV2arr[j] = 0.0;
             for (int t = minW; t <= maxW; t++) {
-              TV1arr[j] += abs (shifted((n-t)%n,j).real() - shifted((n-t-1)%n,j).real());
-              TV1arr[j] += abs (shifted((n-t)%n,j).imag() - shifted((n-t-1)%n,j).imag());
-              TV2arr[j] += abs (shifted((n+t)%n,j).real() - shifted((n+t+1)%n,j).real());
-              TV2arr[j] += abs (shifted((n+t)%n,j).imag() - shifted((n+t+1)%n,j).imag());
+              TV1arr[j] += TV(j,wrap(n-t,n));
+              TV2arr[j] += TV(j,wrap(n+t+1,n));
             }
           }
 
@@ -251,7 +239,6 @@ class ComputeSlice
             double minTV = std::numeric_limits<double>::max();
             int minidx = 0;
             for (int j = 0; j < 2*nsh+1; ++j) {
-
               if (TV1arr[j] < minTV) {
                 minTV = TV1arr[j];
                 minidx = j;
@@ -260,30 +247,22 @@ class ComputeSlice
                 minTV = TV2arr[j];
                 minidx = j;
               }
-
-              TV1arr[j] += abs (shifted((l-minW+1+n)%n,j).real() - shifted((l-(minW  )+n)%n,j).real());
-              TV1arr[j] -= abs (shifted((l-maxW  +n)%n,j).real() - shifted((l-(maxW+1)+n)%n,j).real());
-              TV2arr[j] += abs (shifted((l+maxW+1+n)%n,j).real() - shifted((l+(maxW+2)+n)%n,j).real());
-              TV2arr[j] -= abs (shifted((l+minW  +n)%n,j).real() - shifted((l+(minW+1)+n)%n,j).real());
-
-              TV1arr[j] += abs (shifted((l-minW+1+n)%n,j).imag() - shifted((l-(minW  )+n)%n,j).imag());
-              TV1arr[j] -= abs (shifted((l-maxW  +n)%n,j).imag() - shifted((l-(maxW+1)+n)%n,j).imag());
-              TV2arr[j] += abs (shifted((l+maxW+1+n)%n,j).imag() - shifted((l+(maxW+2)+n)%n,j).imag());
-              TV2arr[j] -= abs (shifted((l+minW  +n)%n,j).imag() - shifted((l+(minW+1)+n)%n,j).imag());
             }
 
-            double a0r = shifted((l-1+n)%n,minidx).real();
-            double a1r = shifted(l,minidx).real();
-            double a2r = shifted((l+1+n)%n,minidx).real();
-            double a0i = shifted((l-1+n)%n,minidx).imag();
-            double a1i = shifted(l,minidx).imag();
-            double a2i = shifted((l+1+n)%n,minidx).imag();
+            TV1arr += TV.col(wrap (l-minW+1, n));
+            TV1arr -= TV.col(wrap (l-maxW, n));
+            TV2arr += TV.col(wrap (l+maxW+2, n));
+            TV2arr -= TV.col(wrap (l+minW+1, n));
+
+            double a0 = shifted((l-1+n)%n,minidx);
+            double a1 = shifted(l,minidx);
+            double a2 = shifted((l+1+n)%n,minidx);
             double s = double(shifts[minidx])/(2.0*nsh);
 
             if (s > 0.0)
-              eig(l,k) = cdouble (a1r*(1.0-s) + a0r*s, a1i*(1.0-s) + a0i*s);
+              eig(l,k) = a1*(1.0-s) + a0*s;
             else
-              eig(l,k) = cdouble (a1r*(1.0+s) - a2r*s, a1i*(1.0+s) - a2i*s);
+              eig(l,k) = a1*(1.0+s) - a2*s;
           }
         }
       }
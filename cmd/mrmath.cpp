@@ -321,6 +321,27 @@ class ImageKernel : public ImageKernelBase { NOMEMALIGN
             out.value() = op;
           }
     };
+    // as ProcessFunctor, but for an entire row of voxels along axis at once,
+    // so that the input data are converted in a single call per row:
+    class ProcessRowFunctor { NOMEMALIGN
+      public:
+        ProcessRowFunctor (size_t axis) : axis (axis) { }
+        template <class ImageType1, class ImageType2>
+          void operator() (ImageType1& out, ImageType2& in) {
+            row.resize (in.size (axis));
+            in.get_values (axis, row.data(), row.size());
+            for (ssize_t n = 0; n != row.size(); ++n) {
+              out.index (axis) = n;
+              Operation op = out.value();
+              op (row[n]);
+              out.value() = op;
+            }
+            out.index (axis) = 0;
+          }
+      protected:
+        const size_t axis;
+        Eigen::Array<value_type,Eigen::Dynamic,1> row;
+    };
     class ResultFunctor { NOMEMALIGN
       public:
         template <class ImageType1, class ImageType2>
@@ -344,6 +365,16 @@ class ImageKernel : public ImageKernelBase { NOMEMALIGN
     void process (Header& header_in)
     {
       auto in = header_in.get_image<value_type>();
+      for (size_t axis = 0; axis != image.ndim(); ++axis) {
+        if (std::abs (in.stride (axis)) == 1 && image.size (axis) > 1) {
+          vector<size_t> outer_axes;
+          for (size_t n = 0; n != image.ndim(); ++n)
+            if (n != axis)
+              outer_axes.push_back (n);
+          ThreadedLoop (image, outer_axes).run (ProcessRowFunctor (axis), image, in);
+          return;
+        }
+      }
       ThreadedLoop (image).run (ProcessFunctor(), image, in);
     }
 
@@ -145,24 +145,22 @@ void execute (Image<node_t>& node_image, const node_t max_node_index, const std:
 
   // Prepare for reading the track data
   Tractography::Properties properties;
-  Tractography::Reader<float> reader (argument[0], properties);
+  auto reader = Tractography::open_reader<float> (argument[0], properties);
 
   // Initialise classes in preparation for multi-threading
-  Mapping::TrackLoader loader (reader, properties["count"].empty() ? 0 : to<size_t>(properties["count"]), "Constructing connectome");
+  Mapping::TrackLoader loader (*reader, properties["count"].empty() ? 0 : to<size_t>(properties["count"]), "Constructing connectome");
   Tractography::Connectome::Mapper mapper (*tck2nodes, metric);
   Tractography::Connectome::Matrix<T> connectome (max_node_index, statistic, vector_output, track_assignments);
 
   // Multi-threaded connectome construction
   if (tck2nodes->provides_pair()) {
-    Thread::run_queue (
-        loader,
+    loader.run_queue (
         Thread::batch (Tractography::Streamline<float>()),
         Thread::multi (mapper),
         Thread::batch (Mapped_track_nodepair()),
         connectome);
   } else {
-    Thread::run_queue (
-        loader,
+    loader.run_queue (
         Thread::batch (Tractography::Streamline<float>()),
         Thread::multi (mapper),
         Thread::batch (Mapped_track_nodelist()),
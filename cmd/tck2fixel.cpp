@@ -173,8 +173,7 @@ void run ()
     mapper.set_upsample_ratio (DWI::Tractography::Mapping::determine_upsample_ratio (index_header, properties, 0.333f));
     mapper.set_use_precise_mapping (true);
     TrackProcessor tract_processor (index_image, directions, fixel_TDI, angular_threshold);
-    Thread::run_queue (
-        loader,
+    loader.run_queue (
         Thread::batch (DWI::Tractography::Streamline<float>()),
         mapper,
         Thread::batch (SetVoxelDir()),
@@ -38,6 +38,7 @@ void usage ()
 
   DESCRIPTION
   + "The program currently supports MRtrix .tck files (input/output), "
+    "compressed MRtrix .tckz files (input/output), "
     "ascii text files (input/output), VTK polydata files (input/output), "
     "and RenderMan RIB (export only)."
 
@@ -684,7 +685,7 @@ void run ()
   // Reader
   Properties properties;
   std::unique_ptr<ReaderInterface<float> > reader;
-  if (Path::has_suffix(argument[0], ".tck")) {
+  if (is_track_file (argument[0])) {
     reader.reset( new Reader<float>(argument[0], properties) );
   }
   else if (Path::has_suffix(argument[0], ".txt")) {
@@ -700,7 +701,7 @@ void run ()
 
   // Writer
   std::unique_ptr<WriterInterface<float> > writer;
-  if (Path::has_suffix(argument[1], ".tck")) {
+  if (is_track_file (argument[1])) {
     writer.reset( new Writer<float>(argument[1], properties) );
   }
   else if (Path::has_suffix(argument[1], ".vtk")) {
@@ -375,7 +375,7 @@ void run ()
     mapper.set_upsample_ratio (upsample_ratio);
     mapper.add_twdfc_static_image (fmri_image);
     Mapping::MapWriter<float> writer (header, argument[2], stat_vox);
-    Thread::run_queue (loader, Thread::batch (Tractography::Streamline<>()), Thread::multi (mapper), Thread::batch (Mapping::SetVoxel()), writer);
+    loader.run_queue (Thread::batch (Tractography::Streamline<>()), Thread::multi (mapper), Thread::batch (Mapping::SetVoxel()), writer);
     writer.finalise();
 
   } else {
@@ -388,7 +388,7 @@ void run ()
       Mapping::TrackMapperBase mapper (H_3D);
       mapper.set_upsample_ratio (upsample_ratio);
       Count_receiver receiver (counts);
-      Thread::run_queue (loader, Thread::batch (Tractography::Streamline<>()), Thread::multi (mapper), Thread::batch (Mapping::SetVoxel()), receiver);
+      loader.run_queue (Thread::batch (Tractography::Streamline<>()), Thread::multi (mapper), Thread::batch (Mapping::SetVoxel()), receiver);
     }
 
     Image<float> out_image (Image<float>::create (argument[2], header));
@@ -403,7 +403,7 @@ void run ()
         mapper.set_upsample_ratio (upsample_ratio);
         mapper.add_twdfc_dynamic_image (fmri_image, window, timepoint);
         Receiver receiver (H_3D, stat_vox);
-        Thread::run_queue (loader, Thread::batch (Tractography::Streamline<>()), Thread::multi (mapper), Thread::batch (Mapping::SetVoxel()), receiver);
+        loader.run_queue (Thread::batch (Tractography::Streamline<>()), Thread::multi (mapper), Thread::batch (Mapping::SetVoxel()), receiver);
 
         if (stat_vox == V_MEAN)
           receiver.scale_by_count (counts);
@@ -0,0 +1,359 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#include "command.h"
+#include "exception.h"
+#include "mrtrix.h"
+#include "raw.h"
+#include "types.h"
+#include "file/mmap.h"
+#include "file/ofstream.h"
+#include "file/utils.h"
+
+#include "dwi/tractography/compression.h"
+#include "dwi/tractography/file_base.h"
+#include "dwi/tractography/file_index.h"
+#include "dwi/tractography/properties.h"
+
+
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+
+
+
+void usage ()
+{
+  AUTHOR = "J-Donald Tournier (jdtournier@gmail.com)";
+
+  SYNOPSIS = "Concatenate track files without decoding the streamline data, combining the streamline counts in their headers";
+
+  DESCRIPTION
+  + "This command is primarily intended to merge the shards of a tractogram "
+    "generated across separate invocations of tckgen -shard (e.g. on different "
+    "machines). The streamline data are copied block by block, without being "
+    "decoded and re-encoded; all input files must therefore share the same format "
+    "(.tck or .tckz), the same data type, and (for compressed files) the same "
+    "precision. The output file must use the same format as the input files."
+
+  + "In the output header, the streamline counts (count & total_count) and the "
+    "seeding limits (max_num_tracks & max_num_seeds) are summed across the input "
+    "files, and the command histories of all input files are retained. The shard "
+    "entry is removed if the input files consist of all shards of a tractogram, "
+    "provided in order; in that case, the output matches that of a single invocation "
+    "of tckgen processing all seeds (see tckgen -shard for details). Any other "
+    "entry that differs between input files is set to \"variable\", as per tckedit."
+
+  + "For more involved manipulations of the streamline data (including concatenating "
+    "files of different formats), use tckedit.";
+
+  EXAMPLES
+  + Example ("Merge the shards of a tractogram generated in separate invocations of tckgen",
+             "for k in 0 1 2 3; do MRTRIX_RNG_SEED=42 tckgen fod.mif shard_$k.tck -seed_image mask.mif -select 0 -seeds 1M -shard $k,4; done; "
+             "tckmerge shard_0.tck shard_1.tck shard_2.tck shard_3.tck tracks.tck",
+             "Each invocation of tckgen processes 1M seeds; these could equivalently be "
+             "run concurrently on different machines. As long as the same random number "
+             "generator seed is used for all shards, the merged output is identical to "
+             "that of a single invocation of tckgen with -seeds 4M and without the -shard option.");
+
+  ARGUMENTS
+  + Argument ("tracks_in", "the input track files").type_tracks_in().allow_multiple()
+  + Argument ("tracks_out", "the output track file").type_tracks_out();
+}
+
+
+
+
+// the first coordinate of the point stored at p in format dtype
+double first_coordinate (const uint8_t* p, const DataType dtype)
+{
+  return dtype.bytes() == 4 ?
+      double (Raw::fetch_<float> (p, dtype.is_big_endian())) :
+      Raw::fetch_<double> (p, dtype.is_big_endian());
+}
+
+
+
+class Input : public __ReaderBase__
+{ NOMEMALIGN
+  public:
+    Input (const std::string& path, Properties& properties) :
+        path (path) {
+      open (path, "tracks", properties);
+    }
+
+    const std::string path;
+
+    DataType datatype () const { return dtype; }
+    bool is_compressed () const { return compressed; }
+    double get_precision () const { return precision; }
+
+    //! append the streamline data, excluding the end-of-data marker, to \a out
+    void copy_to (std::ostream& out)
+    {
+      if (compressed)
+        copy_blocks (out);
+      else
+        copy_points (out);
+    }
+
+  private:
+    vector<char> buffer;
+
+    void copy_points (std::ostream& out)
+    {
+      const int64_t point_size = 3 * dtype.bytes();
+      in.seekg (0, std::ios::end);
+      const int64_t end = int64_t (in.tellg()) - point_size;
+      buffer.resize (point_size);
+      if (end >= data_offset) {
+        in.seekg (end);
+        in.read (buffer.data(), point_size);
+      }
+      if (end < data_offset || !in.good() || !std::isinf (first_coordinate (reinterpret_cast<const uint8_t*> (buffer.data()), dtype)))
+        throw Exception ("track file \"" + path + "\" is incomplete (no end-of-data marker found)");
+
+      in.seekg (data_offset);
+      buffer.resize (std::min (end - data_offset, int64_t (4*1024*1024)));
+      for (int64_t remaining = end - data_offset; remaining > 0;) {
+        const int64_t size = std::min (remaining, int64_t (buffer.size()));
+        in.read (buffer.data(), size);
+        if (!in.good())
+          throw Exception ("error reading track file \"" + path + "\": " + strerror (errno));
+        out.write (buffer.data(), size);
+        remaining -= size;
+      }
+    }
+
+    void copy_blocks (std::ostream& out)
+    {
+      in.seekg (data_offset);
+      char header[Compression::block_header_size];
+      while (true) {
+        in.read (header, sizeof (header));
+        if (!in.good())
+          throw Exception ("compressed track file \"" + path + "\" is incomplete (no end-of-data marker found)");
+        const uint32_t compressed_size = Raw::fetch_LE<uint32_t> (header);
+        if (!compressed_size)
+          return;
+        buffer.resize (compressed_size);
+        in.read (buffer.data(), compressed_size);
+        if (!in.good())
+          throw Exception ("compressed track file \"" + path + "\" is truncated");
+        out.write (header, sizeof (header));
+        out.write (buffer.data(), compressed_size);
+      }
+    }
+};
+
+
+
+class Output : public __WriterBase__<float>
+{ NOMEMALIGN
+  public:
+    Output (const std::string& path, Properties& properties, const DataType datatype, const double quantisation) :
+        __WriterBase__<float> (path)
+    {
+      if (!Path::has_suffix (name, quantisation ? ".tckz" : ".tck"))
+        throw Exception (std::string ("output track file must use the same format as the input files (") + (quantisation ? ".tckz" : ".tck") + ")");
+      dtype = datatype;
+      precision = quantisation;
+
+      properties.set_timestamp();
+      properties.set_version_info();
+      properties.update_command_history();
+
+      out.open (name, std::ios::out | std::ios::binary | std::ios::trunc);
+      create (out, properties, "tracks");
+      data_offset = out.tellp();
+    }
+
+    void append (Input& input)
+    {
+      input.copy_to (out);
+      verify_stream (out);
+    }
+
+    //! write the end-of-data marker, and the streamline counts
+    void close ()
+    {
+      if (precision) {
+        const vector<char> end_of_data (Compression::block_header_size, 0);
+        out.write (end_of_data.data(), end_of_data.size());
+      }
+      else {
+        vector<uint8_t> barrier (3 * dtype.bytes());
+        for (size_t axis = 0; axis != 3; ++axis) {
+          if (dtype.bytes() == 4)
+            Raw::store<float> (Inf, barrier.data(), axis, dtype.is_big_endian());
+          else
+            Raw::store<double> (Inf, barrier.data(), axis, dtype.is_big_endian());
+        }
+        out.write (reinterpret_cast<const char*> (barrier.data()), barrier.size());
+      }
+      verify_stream (out);
+      out.close();
+      // counts are written on destruction:
+      open_success = true;
+    }
+
+    //! write or remove the accompanying index file, as the Writer classes do
+    void update_index () const
+    {
+      if (Index::write_enabled() && !precision) {
+        File::MMap mmap (File::Entry (name, data_offset));
+        Index index;
+        index.build (mmap.address(), mmap.size(), data_offset, dtype);
+        Index::create (Index::path (name));
+        Index::append (Index::path (name), index);
+      }
+      else if (Index::exists (name)) {
+        File::remove (Index::path (name));
+      }
+    }
+
+  private:
+    File::OFStream out;
+    int64_t data_offset;
+};
+
+
+
+
+void merge_properties (Properties& merged, const Properties& p, uint64_t& count, uint64_t& total_count)
+{
+  for (const auto& i : p.comments) {
+    if (std::find (merged.comments.begin(), merged.comments.end(), i) == merged.comments.end())
+      merged.comments.push_back (i);
+  }
+
+  for (const auto& i : p.prior_rois) {
+    const auto potential_matches = merged.prior_rois.equal_range (i.first);
+    bool present = false;
+    for (auto j = potential_matches.first; !present && j != potential_matches.second; ++j)
+      present = (i.second == j->second);
+    if (!present)
+      merged.prior_rois.insert (i);
+  }
+
+  for (const auto& i : p) {
+    if (i.first == "count") {
+      count += to<uint64_t> (i.second);
+    } else if (i.first == "total_count") {
+      total_count += to<uint64_t> (i.second);
+    } else if (i.first == "max_num_tracks" || i.first == "max_num_seeds") {
+      auto existing = merged.find (i.first);
+      if (existing == merged.end())
+        merged.insert (i);
+      else if (existing->second != "variable")
+        existing->second = str (to<uint64_t> (existing->second) + to<uint64_t> (i.second));
+    } else if (i.first == "command_history") {
+      for (const auto& line : split_lines (i.second)) {
+        const auto history = split_lines (merged["command_history"]);
+        if (std::find (history.begin(), history.end(), line) == history.end())
+          add_line (merged["command_history"], line);
+      }
+    } else {
+      auto existing = merged.find (i.first);
+      if (existing == merged.end())
+        merged.insert (i);
+      else if (i.second != existing->second)
+        existing->second = "variable";
+    }
+  }
+}
+
+
+
+// The output is truncated before any input is read, so it must not refer to
+//   one of the inputs (possibly via a different path)
+bool same_file (const std::string& a, const std::string& b)
+{
+  if (a == b)
+    return true;
+  struct stat buf_a, buf_b;
+  if (stat (a.c_str(), &buf_a) || stat (b.c_str(), &buf_b))
+    return false;
+  return buf_a.st_dev == buf_b.st_dev && buf_a.st_ino == buf_b.st_ino;
+}
+
+
+
+
+void run ()
+{
+  const size_t num_inputs = argument.size() - 1;
+  const std::string output_path = argument[num_inputs];
+  for (size_t n = 0; n != num_inputs; ++n) {
+    if (same_file (argument[n], output_path))
+      throw Exception ("output track file \"" + output_path + "\" must not be one of the input track files");
+  }
+
+  Properties properties;
+  uint64_t count = 0, total_count = 0;
+  vector<uint64_t> shard_indices;
+  uint64_t num_shards = 0;
+  DataType dtype;
+  double precision = 0.0;
+
+  // Check all headers before writing anything
+  for (size_t n = 0; n != num_inputs; ++n) {
+    Properties p;
+    Input input (argument[n], p);
+    if (!n) {
+      dtype = input.datatype();
+      precision = input.get_precision();
+    }
+    else if (input.datatype() != dtype || input.is_compressed() != bool(precision) || input.get_precision() != precision)
+      throw Exception ("track file \"" + input.path + "\" does not use the same format as \"" + std::string (argument[0]) + "\" "
+                       "(use tckedit to concatenate track files of different formats)");
+
+    const auto shard = p.find ("shard");
+    if (shard != p.end()) {
+      const auto spec = parse_ints<uint64_t> (shard->second);
+      if (spec.size() == 2 && (n == 0 || spec[1] == num_shards)) {
+        shard_indices.push_back (spec[0]);
+        num_shards = spec[1];
+      }
+    }
+
+    merge_properties (properties, p, count, total_count);
+  }
+
+  if (shard_indices.size() == num_inputs && num_inputs == num_shards) {
+    bool in_order = true;
+    for (size_t n = 0; n != num_inputs; ++n)
+      in_order = in_order && shard_indices[n] == n;
+    if (in_order)
+      properties.erase ("shard");
+    else
+      WARN ("input files consist of all " + str(num_shards) + " shards of a tractogram, but were not provided in order of shard index");
+  }
+
+  Output output (output_path, properties, dtype, precision);
+  for (size_t n = 0; n != num_inputs; ++n) {
+    Properties p;
+    Input input (argument[n], p);
+    output.append (input);
+  }
+  output.count = count;
+  output.total_count = total_count;
+  output.close();
+  output.update_index();
+}
+
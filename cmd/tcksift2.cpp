@@ -23,6 +23,8 @@
 
 #include "dwi/directions/set.h"
 
+#include "dwi/tractography/file_base.h"
+
 #include "dwi/tractography/mapping/fixel_td_map.h"
 
 #include "dwi/tractography/SIFT/proc_mask.h"
@@ -155,7 +157,7 @@ void run ()
   if (get_options("max_factor").size() && get_options("max_coeff").size())
     throw Exception ("Options -max_factor and -max_coeff are mutually exclusive");
 
-  if (Path::has_suffix (argument[2], ".tck"))
+  if (is_track_file (argument[2]))
     throw Exception ("Output of tcksift2 command should be a text file, not a tracks file");
 
   auto in_dwi = Image<float>::open (argument[1]);
@@ -17,6 +17,9 @@
 #ifndef __algo_threaded_loop_h__
 #define __algo_threaded_loop_h__
 
+#include <atomic>
+#include <numeric>
+
 #include "debug.h"
 #include "algo/loop.h"
 #include "algo/iterator.h"
@@ -231,6 +234,24 @@ namespace MR
    * invocation - the functor will need to then implement looping over the
    * inner axes from the position provided in the `Iterator`.
    *
+   * \section threaded_loop_work_stealing Load balancing
+   *
+   * By default, threads obtain the next position along the outer axes one
+   * at a time from a single shared loop. Where the cost of processing varies
+   * widely across the image (e.g. where most of the field of view lies
+   * outside a processing mask), the with_work_stealing() method can be
+   * invoked before run() or run_outer() to instead split the outer positions
+   * into contiguous ranges, one per thread; any thread that runs out of work
+   * then takes over half of the remaining range of the busiest thread. If a
+   * mask image is provided, the initial ranges are chosen to contain roughly
+   * equal numbers of voxels within the mask:
+   *
+   * \code
+   * ThreadedLoop ("processing", dwi, 0, 3)
+   *     .with_work_stealing (mask)
+   *     .run (processor, dwi, out);
+   * \endcode
+   *
    * \sa Loop
    * \sa Thread::run()
    * \sa thread_queue
@@ -304,6 +325,15 @@ namespace MR
       };
 
 
+      inline void __increment_progress (...) { }
+      template <class LoopType>
+        inline auto __increment_progress (LoopType* loop, size_t n)
+        -> decltype((void) (&loop->progress), void())
+      {
+        while (n--)
+          ++loop->progress;
+      }
+
       inline void __manage_progress (...) { }
       template <class LoopType, class ThreadType>
         inline auto __manage_progress (const LoopType* loop, const ThreadType* threads)
@@ -318,6 +348,47 @@ namespace MR
         Iterator iterator;
         OuterLoopType outer_loop;
         vector<size_t> inner_axes;
+        // only used with work-stealing:
+        bool work_stealing;
+        vector<float> cost;
+
+        //! distribute the outer positions between threads using work-stealing
+        ThreadedLoopRunOuter& with_work_stealing () {
+          work_stealing = true;
+          return *this;
+        }
+
+        //! distribute the outer positions between threads using
+        //! work-stealing, balancing the initial distribution using the
+        //! voxels within \a mask
+        /*! The mask must match the image being looped over along all of its
+         * axes, other than those of unit size (which are broadcast); if it is
+         * not valid, this is equivalent to with_work_stealing(). */
+        template <class MaskType>
+          ThreadedLoopRunOuter& with_work_stealing (MaskType& mask) {
+            work_stealing = true;
+            if (!mask.valid())
+              return *this;
+            vector<size_t> mask_inner_axes;
+            for (auto axis : inner_axes)
+              if (axis < mask.ndim() && mask.size (axis) > 1)
+                mask_inner_axes.push_back (axis);
+            cost.resize (num_outer_positions());
+            for (size_t index = 0; index < cost.size(); ++index) {
+              set_position (mask, index);
+              // each position has a nominal cost even if fully masked out:
+              size_t count = 1;
+              if (mask_inner_axes.empty())
+                count += mask.value() ? 1 : 0;
+              else {
+                for (auto l = Loop (mask_inner_axes) (mask); l; ++l)
+                  if (mask.value())
+                    ++count;
+              }
+              cost[index] = count;
+            }
+            return *this;
+          }
 
         //! invoke \a functor (const Iterator& pos) per voxel <em> in the outer axes only</em>
         template <class Functor>
@@ -329,6 +400,11 @@ namespace MR
               return;
             }
 
+            if (work_stealing) {
+              run_outer_work_stealing (functor);
+              return;
+            }
+
             std::mutex mutex;
             ProgressBar::SwitchToMultiThreaded progress_functions;
 
@@ -365,6 +441,148 @@ namespace MR
 
 
 
+        template <class Functor>
+          void run_outer_work_stealing (Functor&& functor)
+          {
+            const size_t num_threads = Thread::threads_to_execute();
+            const size_t num_positions = num_outer_positions();
+            ProgressBar::SwitchToMultiThreaded progress_functions;
+
+            // the range of outer positions (as linear indices) yet to be
+            // processed by each thread:
+            struct Range { NOMEMALIGN
+              std::mutex mutex;
+              size_t begin, end;
+            };
+
+            struct Shared { MEMALIGN(Shared)
+              ThreadedLoopRunOuter& parent;
+              decltype (outer_loop (iterator)) loop;
+              vector<Range> ranges;
+              std::atomic<size_t> next_thread;
+              std::mutex progress_mutex;
+
+              // get the next position for this thread, stealing from the
+              // thread with most remaining work if none are left:
+              bool next (size_t thread, size_t& index) {
+                Range& own (ranges[thread]);
+                {
+                  std::lock_guard<std::mutex> lock (own.mutex);
+                  if (own.begin < own.end) {
+                    index = own.begin++;
+                    return true;
+                  }
+                }
+                while (true) {
+                  size_t victim = thread, most = 0;
+                  for (size_t n = 0; n < ranges.size(); ++n) {
+                    std::lock_guard<std::mutex> lock (ranges[n].mutex);
+                    if (ranges[n].end - ranges[n].begin > most) {
+                      most = ranges[n].end - ranges[n].begin;
+                      victim = n;
+                    }
+                  }
+                  if (!most)
+                    return false;
+                  size_t begin, end;
+                  {
+                    Range& range (ranges[victim]);
+                    std::lock_guard<std::mutex> lock (range.mutex);
+                    if (range.begin >= range.end)
+                      continue;
+                    begin = range.begin + (range.end - range.begin) / 2;
+                    end = range.end;
+                    range.end = begin;
+                  }
+                  std::lock_guard<std::mutex> lock (own.mutex);
+                  own.begin = begin + 1;
+                  own.end = end;
+                  index = begin;
+                  return true;
+                }
+              }
+
+              void progress (size_t n) {
+                if (!n)
+                  return;
+                std::lock_guard<std::mutex> lock (progress_mutex);
+                __increment_progress (&loop, n);
+              }
+            } shared = { *this, outer_loop (iterator), vector<Range> (num_threads), { 0 }, { } };
+
+            // initial partition into contiguous ranges of equal cost:
+            if (cost.size() == num_positions) {
+              const double total = std::accumulate (cost.begin(), cost.end(), 0.0);
+              double cumulative = 0.0;
+              size_t thread = 0;
+              shared.ranges[0].begin = 0;
+              for (size_t index = 0; index < num_positions; ++index) {
+                while (thread+1 < num_threads && cumulative >= total * (thread+1) / num_threads) {
+                  shared.ranges[thread].end = index;
+                  shared.ranges[++thread].begin = index;
+                }
+                cumulative += cost[index];
+              }
+              shared.ranges[thread].end = num_positions;
+              while (++thread < num_threads)
+                shared.ranges[thread].begin = shared.ranges[thread].end = num_positions;
+            }
+            else {
+              for (size_t thread = 0; thread < num_threads; ++thread) {
+                shared.ranges[thread].begin = thread * num_positions / num_threads;
+                shared.ranges[thread].end = (thread+1) * num_positions / num_threads;
+              }
+            }
+
+            struct PerThread { MEMALIGN(PerThread)
+              Shared& shared;
+              typename std::remove_reference<Functor>::type func;
+              void execute () {
+                const size_t thread = shared.next_thread++;
+                Iterator pos = shared.parent.iterator;
+                size_t index, done = 0;
+                while (shared.next (thread, index)) {
+                  shared.parent.set_position (pos, index);
+                  func (pos);
+                  // update progress in batches to limit contention:
+                  if (++done >= 64) {
+                    shared.progress (done);
+                    done = 0;
+                  }
+                }
+                shared.progress (done);
+              }
+            } loop_thread = { shared, functor };
+
+            auto threads = Thread::run (Thread::multi (loop_thread, num_threads), "loop threads");
+
+            __manage_progress (&shared.loop, &threads);
+            threads.wait();
+          }
+
+
+
+        size_t num_outer_positions () const {
+          size_t count = 1;
+          for (auto axis : outer_loop.axes)
+            count *= iterator.size (axis);
+          return count;
+        }
+
+        // set the position along the outer axes from its linear index, with
+        // the first outer axis varying fastest (as in the outer loop); axes
+        // absent from pos or of unit size are left untouched:
+        template <class PositionType>
+          void set_position (PositionType& pos, size_t index) const {
+            for (auto axis : outer_loop.axes) {
+              if (axis < pos.ndim() && pos.size (axis) > 1)
+                pos.index (axis) = index % iterator.size (axis);
+              index /= iterator.size (axis);
+            }
+          }
+
+
+
         //! invoke \a functor (const Iterator& pos) per voxel <em> in the outer axes only</em>
         template <class Functor, class... ImageType>
           void run (Functor&& functor, ImageType&&... vox)
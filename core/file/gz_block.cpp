@@ -0,0 +1,379 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <atomic>
+#include <algorithm>
+#include <zlib.h>
+
+#include "app.h"
+#include "raw.h"
+#include "thread.h"
+#include "file/config.h"
+#include "file/gz_block.h"
+
+// size of the member header: 10 bytes of fixed fields, 2 bytes XLEN,
+// and a single 8-byte extra subfield holding the member size:
+#define GZBLOCK_HEADER_SIZE 20
+#define GZBLOCK_TRAILER_SIZE 8
+#define GZBLOCK_FLAG_FEXTRA 0x04
+
+namespace MR
+{
+  namespace File
+  {
+    namespace GZBlock
+    {
+
+      namespace {
+
+        template <class Functor>
+          void run_blocks (Functor& functor, size_t num_blocks, const std::string& description)
+          {
+            const size_t nthreads = std::min (Thread::threads_to_execute(), num_blocks);
+            if (nthreads <= 1) {
+              functor.execute();
+              return;
+            }
+            auto threads = Thread::run (Thread::multi (functor, nthreads), description);
+            threads.wait();
+          }
+
+
+
+        void compress (const uint8_t* data, size_t size, vector<uint8_t>& member)
+        {
+          z_stream zs;
+          memset (&zs, 0, sizeof (zs));
+          if (deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw Exception ("error initialising zlib compression");
+
+          member.resize (GZBLOCK_HEADER_SIZE + deflateBound (&zs, size) + GZBLOCK_TRAILER_SIZE);
+          zs.next_in = const_cast<Bytef*> (data);
+          zs.avail_in = size;
+          zs.next_out = member.data() + GZBLOCK_HEADER_SIZE;
+          zs.avail_out = member.size() - GZBLOCK_HEADER_SIZE - GZBLOCK_TRAILER_SIZE;
+          const int retval = deflate (&zs, Z_FINISH);
+          const size_t member_size = GZBLOCK_HEADER_SIZE + zs.total_out + GZBLOCK_TRAILER_SIZE;
+          deflateEnd (&zs);
+          if (retval != Z_STREAM_END)
+            throw Exception ("error compressing data block: " + std::string (zs.msg ? zs.msg : "unknown error"));
+          member.resize (member_size);
+
+          uint8_t* p = member.data();
+          p[0] = 0x1f; p[1] = 0x8b;         // magic number
+          p[2] = Z_DEFLATED;                 // compression method
+          p[3] = GZBLOCK_FLAG_FEXTRA;        // flags
+          memset (p+4, 0, 5);                // MTIME & XFL
+          p[9] = 0xff;                       // OS: unknown
+          Raw::store_LE<uint16_t> (8, p+10); // XLEN
+          p[12] = 'M'; p[13] = 'R';          // subfield ID
+          Raw::store_LE<uint16_t> (4, p+14);
+          Raw::store_LE<uint32_t> (member_size, p+16);
+
+          p += member_size - GZBLOCK_TRAILER_SIZE;
+          Raw::store_LE<uint32_t> (crc32 (0, data, size), p);
+          Raw::store_LE<uint32_t> (size, p+4);
+        }
+
+
+
+        void uncompress (const uint8_t* member, const Entry& entry, uint8_t* data)
+        {
+          const size_t header_size = 12 + Raw::fetch_LE<uint16_t> (member+10);
+
+          z_stream zs;
+          memset (&zs, 0, sizeof (zs));
+          if (inflateInit2 (&zs, -MAX_WBITS) != Z_OK)
+            throw Exception ("error initialising zlib decompression");
+          zs.next_in = const_cast<Bytef*> (member + header_size);
+          zs.avail_in = entry.compressed_size - header_size - GZBLOCK_TRAILER_SIZE;
+          zs.next_out = data;
+          zs.avail_out = entry.size;
+          const int retval = inflate (&zs, Z_FINISH);
+          const int64_t size = zs.total_out;
+          inflateEnd (&zs);
+
+          if (retval != Z_STREAM_END || size != entry.size)
+            throw Exception ("error uncompressing data block at offset " + str(entry.compressed_offset));
+          if (crc32 (0, data, size) != Raw::fetch_LE<uint32_t> (member + entry.compressed_size - GZBLOCK_TRAILER_SIZE))
+            throw Exception ("CRC mismatch in data block at offset " + str(entry.compressed_offset));
+        }
+
+
+
+        class Compressor { NOMEMALIGN
+          public:
+            Compressor (const uint8_t* data, size_t size, vector<vector<uint8_t>>& members, std::atomic<size_t>& next) :
+              data (data), size (size), members (members), next (next) { }
+
+            void execute () {
+              size_t n;
+              while ((n = next++) < members.size()) {
+                const size_t offset = n * block_size();
+                compress (data + offset, std::min (block_size(), size - offset), members[n]);
+              }
+            }
+
+          protected:
+            const uint8_t* data;
+            const size_t size;
+            vector<vector<uint8_t>>& members;
+            std::atomic<size_t>& next;
+        };
+
+
+
+        class Uncompressor { NOMEMALIGN
+          public:
+            Uncompressor (const uint8_t* file, const Index& index, size_t last, int64_t position, uint8_t* data, size_t size, std::atomic<size_t>& next) :
+              file (file), index (index), last (last), position (position), data (data), size (size), next (next) { }
+
+            void execute () {
+              size_t n;
+              while ((n = next++) <= last) {
+                const Entry& entry (index[n]);
+                const int64_t from = std::max (entry.offset, position);
+                const int64_t to = std::min (entry.offset + entry.size, position + int64_t(size));
+                if (from == entry.offset && to == entry.offset + entry.size) {
+                  uncompress (file + entry.compressed_offset, entry, data + (entry.offset - position));
+                }
+                else {
+                  scratch.resize (entry.size);
+                  uncompress (file + entry.compressed_offset, entry, scratch.data());
+                  memcpy (data + (from - position), scratch.data() + (from - entry.offset), to - from);
+                }
+              }
+            }
+
+          protected:
+            const uint8_t* file;
+            const Index& index;
+            const size_t last;
+            const int64_t position;
+            uint8_t* data;
+            const size_t size;
+            std::atomic<size_t>& next;
+            vector<uint8_t> scratch;
+        };
+
+      }
+
+
+
+
+
+      size_t block_size ()
+      {
+        //CONF option: GZBlockSize
+        //CONF default: 1048576
+        //CONF The amount of uncompressed data (in bytes) held in each
+        //CONF independently compressed block when writing GZip-compressed
+        //CONF images (.mif.gz, .nii.gz, .mgz). These blocks are compressed
+        //CONF and uncompressed in parallel; smaller blocks provide better
+        //CONF load balancing at the expense of compression ratio.
+        static const size_t size = std::min (std::max (File::Config::get_int ("GZBlockSize", 1048576), 4096), 268435456);
+        return size;
+      }
+
+
+
+      size_t batch_size ()
+      {
+        return 4 * std::max (Thread::threads_to_execute(), size_t(1)) * block_size();
+      }
+
+
+
+
+
+      Index::Index (const uint8_t* data, int64_t data_size)
+      {
+        int64_t compressed_offset = 0, offset = 0;
+        while (compressed_offset < data_size) {
+          const uint8_t* p = data + compressed_offset;
+          if (data_size - compressed_offset < GZBLOCK_HEADER_SIZE + GZBLOCK_TRAILER_SIZE ||
+              p[0] != 0x1f || p[1] != 0x8b || p[2] != Z_DEFLATED || p[3] != GZBLOCK_FLAG_FEXTRA) {
+            clear();
+            return;
+          }
+
+          const uint8_t* subfield = p + 12;
+          const uint8_t* end = subfield + Raw::fetch_LE<uint16_t> (p+10);
+          if (end > data + data_size) {
+            clear();
+            return;
+          }
+          int64_t compressed_size = 0;
+          for (; subfield + 4 <= end; subfield += 4 + Raw::fetch_LE<uint16_t> (subfield+2)) {
+            if (subfield[0] == 'M' && subfield[1] == 'R' && Raw::fetch_LE<uint16_t> (subfield+2) == 4 && subfield + 8 <= end)
+              compressed_size = Raw::fetch_LE<uint32_t> (subfield+4);
+          }
+          if (compressed_size < end - p + GZBLOCK_TRAILER_SIZE || compressed_offset + compressed_size > data_size) {
+            clear();
+            return;
+          }
+
+          const int64_t size = Raw::fetch_LE<uint32_t> (p + compressed_size - 4);
+          push_back ({ compressed_offset, compressed_size, offset, size });
+          compressed_offset += compressed_size;
+          offset += size;
+        }
+      }
+
+
+
+      size_t Index::find (int64_t offset) const
+      {
+        auto it = std::upper_bound (begin(), end(), offset,
+            [] (int64_t value, const Entry& entry) { return value < entry.offset; });
+        assert (it != begin());
+        return (it - begin()) - 1;
+      }
+
+
+
+
+
+      Reader::Reader (const std::string& filename) :
+        filename (filename),
+        position (0)
+      {
+        try {
+          mmap.reset (new MMap (filename));
+          index = Index (mmap->address(), mmap->size());
+        }
+        catch (Exception&) {
+          DEBUG ("unable to memory-map compressed file \"" + filename + "\"");
+        }
+
+        if (index.size()) {
+          DEBUG ("compressed file \"" + filename + "\" holds " + str(index.size()) + " independent blocks");
+        }
+        else {
+          DEBUG ("compressed file \"" + filename + "\" is not block-compressed - uncompressing sequentially");
+          mmap.reset();
+          fallback.reset (new File::GZ (filename, "rb"));
+        }
+      }
+
+
+
+      void Reader::seek (int64_t offset)
+      {
+        if (fallback)
+          fallback->seek (offset);
+        else
+          position = offset;
+      }
+
+
+
+      void Reader::read (uint8_t* data, size_t size)
+      {
+        if (!size)
+          return;
+
+        if (fallback) {
+          fallback->read (reinterpret_cast<char*> (data), size);
+          return;
+        }
+
+        read_at (position, data, size);
+        position += size;
+      }
+
+
+
+      void Reader::read_at (int64_t offset, uint8_t* data, size_t size) const
+      {
+        assert (is_indexed());
+        if (!size)
+          return;
+        if (offset + int64_t(size) > index.uncompressed_size())
+          throw Exception ("unexpected end of file in compressed file \"" + filename + "\"");
+
+        const size_t first = index.find (offset);
+        const size_t last = index.find (offset + size - 1);
+        std::atomic<size_t> next (first);
+        Uncompressor functor (mmap->address(), index, last, offset, data, size, next);
+        run_blocks (functor, last - first + 1, "GZ block decompression");
+      }
+
+
+
+
+
+      Writer::Writer (const std::string& filename) :
+        filename (filename),
+        out (filename, std::ios::out | std::ios::binary | std::ios::trunc)
+      {
+        if (!out)
+          throw Exception ("error opening file \"" + filename + "\" for writing: " + strerror (errno));
+      }
+
+
+
+      Writer::~Writer ()
+      {
+        try {
+          close();
+        }
+        catch (Exception& E) {
+          E.display();
+          App::exit_error_code = 1;
+        }
+      }
+
+
+
+      void Writer::write (const uint8_t* data, size_t size)
+      {
+        assert (out.is_open());
+        const size_t num_blocks = (size + block_size() - 1) / block_size();
+        // limit the amount of compressed data held in RAM at any one time:
+        const size_t blocks_per_batch = batch_size() / block_size();
+        vector<vector<uint8_t>> members;
+
+        for (size_t batch = 0; batch < num_blocks; batch += blocks_per_batch) {
+          const size_t offset = batch * block_size();
+          members.resize (std::min (blocks_per_batch, num_blocks - batch));
+          std::atomic<size_t> next (0);
+          Compressor functor (data + offset, std::min (members.size() * block_size(), size - offset), members, next);
+          run_blocks (functor, members.size(), "GZ block compression");
+
+          for (const auto& member : members)
+            out.write (reinterpret_cast<const char*> (member.data()), member.size());
+          if (!out.good())
+            throw Exception ("error writing to file \"" + filename + "\": " + strerror (errno));
+        }
+      }
+
+
+
+      void Writer::close ()
+      {
+        if (out.is_open()) {
+          out.close();
+          if (out.fail())
+            throw Exception ("error closing file \"" + filename + "\": " + strerror (errno));
+        }
+      }
+
+    }
+  }
+}
+
+
@@ -0,0 +1,140 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __file_gz_block_h__
+#define __file_gz_block_h__
+
+#include <fstream>
+
+#include "memory.h"
+#include "types.h"
+#include "file/gz.h"
+#include "file/mmap.h"
+
+namespace MR
+{
+  namespace File
+  {
+
+    //! Block-compressed GZip files, allowing parallel compression & decompression
+    /*! Files are written as a concatenation of independent GZip members, each
+     * holding (at most) GZBlock::block_size() bytes of uncompressed data. Each
+     * member carries an extra header field (subfield ID 'M','R') recording its
+     * total compressed size, and its trailer records its uncompressed size,
+     * so that the locations of all blocks can be established without
+     * decompressing anything (similar to the BGZF format used in genomics).
+     *
+     * Since a concatenation of GZip members is itself a valid GZip stream,
+     * these files remain readable by standard tools (gunzip, zlib's gzread(),
+     * File::GZ, ...). Conversely, files not produced in this way are still
+     * handled by the Reader, which falls back to sequential decompression
+     * via File::GZ. */
+    namespace GZBlock
+    {
+
+      //! the amount of uncompressed data held in each block (in bytes)
+      size_t block_size ();
+
+      //! a convenient amount of data to pass to each Reader::read() or
+      //! Writer::write() call, large enough to keep all threads busy
+      size_t batch_size ();
+
+      //! the location of a single GZip member within a block-compressed file
+      class Entry { NOMEMALIGN
+        public:
+          int64_t compressed_offset, compressed_size;
+          int64_t offset, size;
+      };
+
+      //! the index of all members in a block-compressed file
+      /*! This is obtained by hopping from one member header to the next. If
+       * the data provided are not a block-compressed GZip stream (e.g. it was
+       * produced by a regular gzip implementation), the index will be empty. */
+      class Index : public vector<Entry> { NOMEMALIGN
+        public:
+          Index () { }
+          Index (const uint8_t* data, int64_t data_size);
+
+          //! total size of the uncompressed data
+          int64_t uncompressed_size () const {
+            return empty() ? 0 : back().offset + back().size;
+          }
+
+          //! the index of the block holding uncompressed byte \a offset
+          size_t find (int64_t offset) const;
+      };
+
+
+
+      //! read (parts of) a GZip file, using multiple threads where possible
+      class Reader { NOMEMALIGN
+        public:
+          Reader (const std::string& filename);
+
+          const std::string& name () const { return filename; }
+          bool is_indexed () const { return index.size(); }
+          const Index& get_index () const { return index; }
+
+          //! set the position (in the uncompressed stream) of the next read()
+          void seek (int64_t offset);
+
+          //! uncompress the next \a size bytes into \a data
+          void read (uint8_t* data, size_t size);
+
+          //! uncompress \a size bytes starting from \a offset into \a data
+          /*! Unlike seek() & read(), this does not alter the state of the
+           * Reader, and so can be invoked concurrently from multiple threads.
+           * It is only available for block-compressed files (i.e. if
+           * is_indexed() returns true). */
+          void read_at (int64_t offset, uint8_t* data, size_t size) const;
+
+        protected:
+          const std::string filename;
+          std::unique_ptr<MMap> mmap;
+          Index index;
+          std::unique_ptr<File::GZ> fallback;
+          int64_t position;
+      };
+
+
+
+      //! write a block-compressed GZip file, compressing blocks in parallel
+      /*! The file is truncated on construction. Each call to write() is
+       * split into blocks of at most block_size() bytes, which are compressed
+       * concurrently and appended to the file in order; a new block is always
+       * started for each call, so that (for instance) an image header can be
+       * held in a member of its own. */
+      class Writer { NOMEMALIGN
+        public:
+          Writer (const std::string& filename);
+          ~Writer ();
+
+          const std::string& name () const { return filename; }
+
+          void write (const uint8_t* data, size_t size);
+          void close ();
+
+        protected:
+          const std::string filename;
+          std::ofstream out;
+      };
+
+    }
+  }
+}
+
+#endif
+
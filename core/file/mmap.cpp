@@ -224,6 +224,58 @@ namespace MR
 
 
 
+    void MMap::advise (Access access) const
+    {
+#ifndef MRTRIX_WINDOWS
+      if (!addr)
+        return;
+      int advice = MADV_NORMAL;
+      switch (access) {
+        case Access::Sequential: advice = MADV_SEQUENTIAL; break;
+        case Access::Random: advice = MADV_RANDOM; break;
+        default: break;
+      }
+      if (madvise (addr, start + msize, advice))
+        DEBUG ("madvise() failed for file \"" + Entry::name + "\": " + strerror (errno));
+# ifdef POSIX_FADV_NORMAL
+      int fadvice = POSIX_FADV_NORMAL;
+      switch (access) {
+        case Access::Sequential: fadvice = POSIX_FADV_SEQUENTIAL; break;
+        case Access::Random: fadvice = POSIX_FADV_RANDOM; break;
+        default: break;
+      }
+      posix_fadvise (fd, start, msize, fadvice);
+# endif
+#endif
+    }
+
+
+
+
+    void MMap::prefetch (int64_t offset, int64_t size) const
+    {
+#ifndef MRTRIX_WINDOWS
+      if (!addr)
+        return;
+      offset = std::max (offset, int64_t(0));
+      size = std::min (size, msize - offset);
+      if (size <= 0)
+        return;
+      // madvise() requires a page-aligned address; the mapping itself
+      // starts on a page boundary:
+      static const int64_t page_size = sysconf (_SC_PAGESIZE);
+      const int64_t from = ((start + offset) / page_size) * page_size;
+      if (madvise (addr + from, start + offset + size - from, MADV_WILLNEED))
+        DEBUG ("madvise() failed for file \"" + Entry::name + "\": " + strerror (errno));
+# ifdef POSIX_FADV_WILLNEED
+      posix_fadvise (fd, start + offset, size, POSIX_FADV_WILLNEED);
+# endif
+#endif
+    }
+
+
+
+
     bool MMap::changed () const
     {
       assert (fd >= 0);
@@ -31,6 +31,10 @@ namespace MR
 
     class MMap : protected Entry { NOMEMALIGN
       public:
+        //! the expected pattern of access to the mapped data
+        /*! \sa advise() */
+        enum class Access { Normal, Sequential, Random };
+
         //! create a new memory-mapping to file in \a entry
         /*! map file in \a entry at the offset in \a entry. By default, the
          * file will be mapped read-only. If \a readwrite is set to true,
@@ -73,6 +77,19 @@ namespace MR
         }
         bool changed () const;
 
+        //! declare the expected pattern of access to the mapped data
+        /*! This is passed on to the OS (via madvise() and posix_fadvise()),
+         * which can use it to adjust its readahead behaviour. It has no effect
+         * if the file is held in RAM using the delayed write-back mechanism,
+         * or if the OS does not support such hints. */
+        void advise (Access access) const;
+
+        //! request asynchronous readahead of \a size bytes from \a offset
+        /*! This returns immediately; the data will subsequently be available
+         * without stalling on page faults, provided there is sufficient RAM
+         * to hold it. The region is clamped to the mapped region. */
+        void prefetch (int64_t offset, int64_t size) const;
+
         friend std::ostream& operator<< (std::ostream& stream, const MMap& m) {
           stream << "File::MMap { " << m.name() << " [" << m.fd << "], size: "
                  << m.size() << ", mapped " << (m.readwrite ? "RW" : "RO")
@@ -97,8 +97,8 @@ namespace MR
       template <typename T>
       void Writer::fill (uint8_t* in_ptr, uint8_t* out_ptr, const DataType data_type, const size_t num_elements)
       {
-        std::function<default_type(const void*,size_t,default_type,default_type)> fetch_func;
-        std::function<void(default_type,void*,size_t,default_type,default_type)> store_func;
+        fetch_func_type<default_type> fetch_func;
+        store_func_type<default_type> store_func;
         __set_fetch_store_functions<default_type> (fetch_func, store_func, data_type);
         default_type multiplier = 1.0;
         switch (data_type() & DataType::Type) {
@@ -19,14 +19,13 @@
 
 #include <complex>
 
-#include <unsupported/Eigen/FFT>
-
 #include "datatype.h"
 #include "memory.h"
 #include "image.h"
 #include "algo/copy.h"
 #include "algo/threaded_copy.h"
 #include "filter/base.h"
+#include "math/fft.h"
 
 namespace MR
 {
@@ -133,16 +132,18 @@ namespace MR
                 data_in (vox.size (FFT_axis)),
                 data_out (data_in.size()),
                 axis (FFT_axis),
-                inverse (inverse_FFT) { }
+                inverse (inverse_FFT) {
+                  fft.prepare (data_in.size());
+                }
 
             void operator () (const Iterator& pos) {
               assign_pos_of (pos).to (vox);
               for (vox.index(axis) = 0; vox.index(axis) < vox.size(axis); ++vox.index(axis))
                 data_in[vox.index(axis)] = cdouble (vox.value());
               if (inverse)
-                fft.inv (data_out, data_in);
+                fft.inverse (data_in, data_out);
               else
-                fft.fwd (data_out, data_in);
+                fft.forward (data_in, data_out);
               for (vox.index(axis) = 0; vox.index(axis) < vox.size(axis); ++vox.index(axis))
                 vox.value() = typename ComplexImageType::value_type (data_out[vox.index(axis)]);
             }
@@ -150,7 +151,7 @@ namespace MR
           protected:
             ComplexImageType vox;
             Eigen::Matrix<cdouble, Eigen::Dynamic, 1> data_in, data_out;
-            Eigen::FFT<double> fft;
+            Math::ColumnFFT<double> fft;
             size_t axis;
             bool inverse;
         };
@@ -168,19 +169,21 @@ namespace MR
 
         struct Kernel { MEMALIGN(Kernel)
           Kernel (const ImageType& v, size_t axis, bool inverse) :
-            data_in (v.size (axis)), data_out (data_in.size()), axis (axis), inverse (inverse) { }
+            data_in (v.size (axis)), data_out (data_in.size()), axis (axis), inverse (inverse) {
+              fft.prepare (data_in.size());
+            }
 
           void operator ()(ImageType& v) {
             for (auto l = Loop (axis, axis+1) (v); l; ++l)
               data_in[v[axis]] = cdouble (v.value());
             if (inverse)
-              fft.inv (data_out, data_in);
+              fft.inverse (data_in, data_out);
             else
-              fft.fwd (data_out, data_in);
+              fft.forward (data_in, data_out);
             for (auto l = Loop (axis, axis+1) (v); l; ++l)
               v.value() = typename std::remove_reference<ImageType>::type::value_type (data_out[v[axis]]);
           }
-          Eigen::FFT<double> fft;
+          Math::ColumnFFT<double> fft;
           Eigen::Matrix<cdouble, Eigen::Dynamic, 1> data_in, data_out;
           const size_t axis;
           const bool inverse;
@@ -17,11 +17,14 @@
 #ifndef __image_filter_gaussian_h__
 #define __image_filter_gaussian_h__
 
+#include <atomic>
+#include <type_traits>
+
 #include "memory.h"
 #include "image.h"
+#include "thread.h"
 #include "algo/copy.h"
 #include "algo/threaded_copy.h"
-#include "adapter/gaussian1D.h"
 #include "filter/base.h"
 
 namespace MR
@@ -42,6 +45,15 @@ namespace MR
      * smooth_filter (input, output);
      *
      * \endcode
+     *
+     * Each axis is smoothed in turn using a separable 1D kernel. For
+     * (floating-point) images held in RAM with direct access, this is done
+     * on tiles of neighbouring lines: each tile is gathered into a small
+     * buffer whose rows hold the values of all lines at the same position
+     * along the axis being smoothed, so that the convolution operates on
+     * contiguous rows and can be vectorised, and so that the image is traversed
+     * in cache-friendly order regardless of its strides. Other images are
+     * processed one line at a time via their accessor.
      */
 
     class Smooth : public Base
@@ -122,10 +134,28 @@ namespace MR
         template <class InputImageType, class OutputImageType, typename ValueType = float>
         void operator() (InputImageType& input, OutputImageType& output)
         {
-          std::shared_ptr <Image<ValueType> > in (make_shared<Image<ValueType> > (Image<ValueType>::scratch (input)));
-          threaded_copy (input, *in);
-          std::shared_ptr <Image<ValueType> > out;
+          auto image = Image<ValueType>::scratch (input, "scratch image for smoothing");
+          threaded_copy (input, image);
+          smooth (image);
+          threaded_copy (image, output);
+        }
+
+        //! Smooth the image in place
+        template <class ImageType>
+        void operator() (ImageType& in_and_output)
+        {
+          smooth (in_and_output);
+        }
 
+      protected:
+        vector<uint32_t> extent;
+        vector<default_type> stdev;
+        const vector<size_t> stride_order;
+        bool zero_boundary;
+
+        template <class ImageType>
+        void smooth (ImageType& image)
+        {
           std::unique_ptr<ProgressBar> progress;
           if (message.size()) {
             size_t axes_to_smooth = 0;
@@ -137,54 +167,215 @@ namespace MR
 
           for (size_t dim = 0; dim < 3; dim++) {
             if (stdev[dim] > 0) {
-              DEBUG ("creating scratch image for smoothing image along dimension " + str(dim));
-              out = make_shared<Image<ValueType> > (Image<ValueType>::scratch (input));
-              Adapter::Gaussian1D<Image<ValueType> > gaussian (*in, stdev[dim], dim, extent[dim], zero_boundary);
-              threaded_copy (gaussian, *out, 0, input.ndim(), 2);
-              in = out;
+              smooth_axis (image, dim);
               if (progress)
                 ++(*progress);
             }
           }
-          threaded_copy (*in, output);
         }
 
-        //! Smooth the image in place
         template <class ImageType>
-        void operator() (ImageType& in_and_output)
+        void smooth_axis (ImageType& image, size_t dim)
         {
-          std::unique_ptr<ProgressBar> progress;
-          if (message.size()) {
-            size_t axes_to_smooth = 0;
-            for (vector<default_type>::const_iterator i = stdev.begin(); i != stdev.end(); ++i)
-              if (*i)
-                ++axes_to_smooth;
-            progress.reset (new ProgressBar (message, axes_to_smooth + 1));
+          smooth_lines (image, dim);
+        }
+
+        template <typename ValueType>
+        typename std::enable_if<std::is_floating_point<ValueType>::value>::type smooth_axis (Image<ValueType>& image, size_t dim)
+        {
+          if (!image.is_direct_io()) {
+            smooth_lines (image, dim);
+            return;
           }
+          BlockedSmooth1D<ValueType> smooth (image, kernel (stdev[dim], image.spacing (dim), extent[dim]), dim, zero_boundary);
+          DEBUG ("smoothing dimension " + str(dim) + " in place in " + str(smooth.num_tiles()) + " tiles of "
+              + str(smooth.tile_width()) + " lines along axis " + str(smooth.tile_axis()));
+          const size_t nthreads = std::min (Thread::threads_to_execute(), smooth.num_tiles());
+          if (nthreads <= 1) {
+            smooth.execute();
+            return;
+          }
+          auto threads = Thread::run (Thread::multi (smooth, nthreads), "Gaussian smoothing");
+          threads.wait();
+        }
 
-          for (size_t dim = 0; dim < 3; dim++) {
-            if (stdev[dim] > 0) {
-              vector<size_t> axes (in_and_output.ndim(), dim);
-              size_t axdim = 1;
-              for (size_t i = 0; i < in_and_output.ndim(); ++i) {
-                if (stride_order[i] == dim)
+        template <class ImageType>
+        void smooth_lines (ImageType& image, size_t dim)
+        {
+          vector<size_t> axes (image.ndim(), dim);
+          size_t axdim = 1;
+          for (size_t i = 0; i < image.ndim(); ++i) {
+            if (stride_order[i] == dim)
+              continue;
+            axes[axdim++] = stride_order[i];
+          }
+          DEBUG ("smoothing dimension " + str(dim) + " in place with stride order: " + str(axes));
+          SmoothFunctor1D<ImageType> smooth (image, stdev[dim], dim, extent[dim], zero_boundary);
+          ThreadedLoop (image, axes, 1).run (smooth, image);
+        }
+
+        // the normalised smoothing kernel along an axis, or an empty
+        // vector if no smoothing is to be performed:
+        static Eigen::VectorXd kernel (default_type stdev, default_type spacing, size_t extent)
+        {
+          ssize_t radius;
+          if (!extent)
+            radius = std::ceil (2 * stdev / spacing);
+          else if (extent == 1)
+            radius = 0;
+          else
+            radius = (extent - 1) / 2;
+
+          Eigen::VectorXd kernel;
+          if ((radius < 1) || stdev <= 0.0)
+            return kernel;
+          kernel.resize (2 * radius + 1);
+          default_type norm_factor = 0.0;
+          for (ssize_t c = 0; c < kernel.size(); ++c) {
+            kernel[c] = exp(-((c-radius) * (c-radius) * spacing * spacing)  / (2 * stdev * stdev));
+            norm_factor += kernel[c];
+          }
+          for (ssize_t c = 0; c < kernel.size(); c++) {
+            kernel[c] /= norm_factor;
+          }
+          return kernel;
+        }
+
+
+
+        // smooths an image held in RAM in place along one axis, processing
+        // tiles of (up to) max_tile_width lines adjacent along the axis with
+        // the smallest stride. Tiles are handed out to the threads in memory
+        // order via a shared counter.
+        template <typename ValueType>
+          class BlockedSmooth1D { MEMALIGN (BlockedSmooth1D<ValueType>)
+          public:
+            static constexpr ssize_t max_tile_width = 16;
+
+            BlockedSmooth1D (Image<ValueType>& image, const Eigen::VectorXd& kernel, size_t axis, bool zero_boundary) :
+                kernel (kernel),
+                radius (kernel.size() / 2),
+                length (image.size (axis)),
+                stride (image.stride (axis)),
+                zero_boundary (zero_boundary),
+                origin (image.address()),
+                inner_axis (0),
+                inner ({ 0, 0 }),
+                next (new std::atomic<size_t> (0)),
+                tile (length, max_tile_width),
+                result (max_tile_width)
+            {
+              for (size_t n = 0; n < image.ndim(); ++n)
+                origin -= image.get_index (n) * image.stride (n);
+
+              // lines within a tile are adjacent along the axis with the smallest stride,
+              // and tiles are enumerated along the remaining axes in order of increasing stride:
+              for (size_t n : Stride::order (image)) {
+                if (n == axis)
                   continue;
-                axes[axdim++] = stride_order[i];
+                if (!inner.size) {
+                  inner_axis = n;
+                  inner = { image.size (n), image.stride (n) };
+                }
+                else
+                  outer_axes.push_back ({ image.size (n), image.stride (n) });
               }
-              DEBUG ("smoothing dimension " + str(dim) + " in place with stride order: " + str(axes));
-              SmoothFunctor1D<ImageType> smooth (in_and_output, stdev[dim], dim, extent[dim], zero_boundary);
-              ThreadedLoop (in_and_output, axes, 1).run (smooth, in_and_output);
-              if (progress)
-                ++(*progress);
+              tiles_per_line = (inner.size + max_tile_width - 1) / max_tile_width;
+              total_tiles = tiles_per_line;
+              for (const auto& a : outer_axes)
+                total_tiles *= a.size;
             }
-          }
-        }
 
-      protected:
-        vector<uint32_t> extent;
-        vector<default_type> stdev;
-        const vector<size_t> stride_order;
-        bool zero_boundary;
+            size_t num_tiles () const { return total_tiles; }
+            ssize_t tile_width () const { return std::min (inner.size, ssize_t (max_tile_width)); }
+            size_t tile_axis () const { return inner_axis; }
+
+            void execute () {
+              if (!kernel.size())
+                return;
+              size_t n;
+              while ((n = (*next)++) < total_tiles)
+                process (n);
+            }
+
+          protected:
+            class Axis { NOMEMALIGN
+              public:
+                ssize_t size, stride;
+            };
+
+            const Eigen::VectorXd kernel;
+            const ssize_t radius, length, stride;
+            const bool zero_boundary;
+            ValueType* origin;
+            size_t inner_axis;
+            Axis inner;
+            vector<Axis> outer_axes;
+            size_t tiles_per_line, total_tiles;
+            std::shared_ptr<std::atomic<size_t>> next;
+            Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> tile;
+            Eigen::Matrix<double, 1, Eigen::Dynamic> result;
+
+            void process (size_t n)
+            {
+              const ssize_t first = (n % tiles_per_line) * max_tile_width;
+              const ssize_t width = std::min (ssize_t (max_tile_width), inner.size - first);
+              ValueType* start = origin + first * inner.stride;
+              n /= tiles_per_line;
+              for (const auto& a : outer_axes) {
+                start += (n % a.size) * a.stride;
+                n /= a.size;
+              }
+
+              // gather the tile, traversing memory along the smallest stride:
+              if (std::abs (stride) < std::abs (inner.stride)) {
+                for (ssize_t j = 0; j < width; ++j)
+                  for (ssize_t k = 0; k < length; ++k)
+                    tile (k, j) = start[k*stride + j*inner.stride];
+              }
+              else {
+                for (ssize_t k = 0; k < length; ++k)
+                  for (ssize_t j = 0; j < width; ++j)
+                    tile (k, j) = start[k*stride + j*inner.stride];
+              }
+
+              // the tile is held in full, so results can be written straight back:
+              for (ssize_t k = 0; k < length; ++k) {
+                ValueType* out = start + k*stride;
+                if (zero_boundary && (k == 0 || k == length-1)) {
+                  for (ssize_t j = 0; j < width; ++j)
+                    out[j*inner.stride] = ValueType (0.0);
+                  continue;
+                }
+
+                const ssize_t from = (k < radius) ? 0 : k - radius;
+                const ssize_t to = (k + radius) >= length ? length - 1 : k + radius;
+                const ssize_t c = (k < radius) ? radius - k : 0;
+                const ssize_t kernel_size = to - from + 1;
+
+                result.head (width).noalias() = kernel.segment (c, kernel_size).transpose() * tile.block (from, 0, kernel_size, width);
+                if (kernel_size != kernel.size())
+                  result.head (width) /= kernel.segment (c, kernel_size).sum();
+
+                for (ssize_t j = 0; j < width; ++j) {
+                  if (!std::isfinite (result[j])) {
+                    // ignore non-finite neighbours, and renormalise:
+                    double value = 0.0, av_weights = 0.0;
+                    for (ssize_t i = 0; i < kernel_size; ++i) {
+                      const double neighbour_value = tile (from+i, j);
+                      if (std::isfinite (neighbour_value)) {
+                        av_weights += kernel[c+i];
+                        value += neighbour_value * kernel[c+i];
+                      }
+                    }
+                    result[j] = value / av_weights;
+                  }
+                  out[j*inner.stride] = ValueType (result[j]);
+                }
+              }
+            }
+          };
+
 
         template <class ImageType>
           class SmoothFunctor1D { MEMALIGN (SmoothFunctor1D)
@@ -194,37 +385,16 @@ namespace MR
                            size_t axis_in = 0,
                            size_t extent = 0,
                            bool zero_boundary_in = false):
-                stdev (stdev_in),
                 axis (axis_in),
+                kernel (Smooth::kernel (stdev_in, image.spacing (axis_in), extent)),
                 zero_boundary (zero_boundary_in),
-                spacing (image.spacing(axis_in)),
                 buffer_size (image.size(axis_in)) {
                   buffer.resize(buffer_size);
-                  if (!extent)
-                    radius = std::ceil(2 * stdev / spacing);
-                  else if (extent == 1)
-                    radius = 0;
-                  else
-                    radius = (extent - 1) / 2;
-                  compute_kernel();
+                  radius = kernel.size() / 2;
               }
 
             using value_type = typename ImageType::value_type;
 
-            void compute_kernel() {
-              if ((radius < 1) || stdev <= 0.0)
-                return;
-              kernel.resize (2 * radius + 1);
-              default_type norm_factor = 0.0;
-              for (ssize_t c = 0; c < kernel.size(); ++c) {
-                kernel[c] = exp(-((c-radius) * (c-radius) * spacing * spacing)  / (2 * stdev * stdev));
-                norm_factor += kernel[c];
-              }
-              for (ssize_t c = 0; c < kernel.size(); c++) {
-                kernel[c] /= norm_factor;
-              }
-            }
-
             // SmoothFunctor1D operator():
             // the inner loop axis has to be the dimension the smoothing is applied to and
             // the loop has to start with image.index (smooth_axis) == 0
@@ -275,12 +445,10 @@ namespace MR
             }
 
           private:
-            const default_type stdev;
             ssize_t radius;
             size_t axis;
             Eigen::VectorXd kernel;
             const bool zero_boundary;
-            const default_type spacing;
             ssize_t buffer_size;
             Eigen::VectorXd buffer;
           };
@@ -119,6 +119,38 @@ namespace MR
 
 
 
+    bool next_keyvalue (std::istream& in, std::string& key, std::string& value)
+    {
+      key.clear(); value.clear();
+      std::string line;
+      if (!std::getline (in, line))
+        throw Exception ("unexpected end of header for image streamed through standard input");
+      line = strip (line.substr (0, line.find_first_of ('#')));
+      if (line == "END")
+        return false;
+      if (line.empty())
+        return true;
+
+      size_t colon = line.find_first_of (':');
+      if (colon == std::string::npos) {
+        INFO ("malformed key/value entry (\"" + line + "\") in streamed image header - ignored");
+      } else {
+        key   = strip (line.substr (0, colon));
+        value = strip (line.substr (colon+1));
+        if (key.empty() || value.empty()) {
+          INFO ("malformed key/value entry (\"" + line + "\") in streamed image header - ignored");
+          key.clear();
+          value.clear();
+        }
+      }
+      return true;
+    }
+
+
+
+
+
+
     void get_mrtrix_file_path (Header& H, const std::string& flag, std::string& fname, size_t& offset)
     {
 
@@ -22,6 +22,7 @@
 #include "header.h"
 #include "image_io/pipe.h"
 #include "formats/list.h"
+#include "formats/mrtrix_utils.h"
 
 namespace MR
 {
@@ -33,6 +34,11 @@ namespace MR
       if (is_dash (H.name())) {
         std::string name;
         getline (std::cin, name);
+        if (name == "mrtrix image") {
+          // image header & data streamed through the pipe:
+          read_mrtrix_header (H, std::cin);
+          return std::unique_ptr<ImageIO::Base> (new ImageIO::Pipe (H));
+        }
         H.name() = name;
       }
       else {
@@ -66,6 +72,14 @@ namespace MR
       if (isatty (STDOUT_FILENO))
         throw Exception ("attempt to pipe image to standard output (this will leave temporary files behind)");
 
+      if (ImageIO::Pipe::streaming()) {
+        H.ndim() = num_axes;
+        for (size_t i = 0; i < H.ndim(); i++)
+          if (H.size (i) < 1)
+            H.size(i) = 1;
+        return true;
+      }
+
       H.name() = File::create_tempfile (0, "mif");
 
       SignalHandler::mark_file_for_deletion (H.name());
@@ -78,6 +92,19 @@ namespace MR
 
     std::unique_ptr<ImageIO::Base> Pipe::create (Header& H) const
     {
+      if (is_dash (H.name())) {
+        // streaming: send the header straight away, so that the next
+        // command can open its input (and create its own outputs) while
+        // this one is still running; the data follow once the image is closed:
+        std::cout << "mrtrix image\n";
+        write_mrtrix_header (H, std::cout);
+        std::cout << "END\n";
+        std::cout.flush();
+        if (!std::cout.good())
+          throw Exception ("error streaming header of image \"" + H.name() + "\" to standard output");
+        return std::unique_ptr<ImageIO::Base> (new ImageIO::Pipe (H));
+      }
+
       std::unique_ptr<ImageIO::Base> original_handler (mrtrix_handler.create (H));
       std::unique_ptr<ImageIO::Pipe> io_handler (new ImageIO::Pipe (std::move (*original_handler)));
       return std::move (io_handler);
@@ -17,6 +17,7 @@
 #ifndef __image_h__
 #define __image_h__
 
+#include <algorithm>
 #include <functional>
 #include <type_traits>
 #include <tuple>
@@ -94,6 +95,16 @@ namespace MR
           else buffer->set_value (data_offset, val);
         }
 
+        //! get \a count voxel values along \a axis, starting from the current location
+        /*! The current location is left unchanged. For images using indirect
+         * IO whose data are contiguous along \a axis, these are converted in a
+         * single call (see Buffer::get_values()), rather than one call per
+         * voxel as with get_value(). */
+        void get_values (size_t axis, ValueType* values, ssize_t count) const;
+        //! set \a count voxel values along \a axis, starting from the current location
+        /*! \sa get_values() */
+        void set_values (size_t axis, const ValueType* values, ssize_t count);
+
         //! use for debugging
         friend std::ostream& operator<< (std::ostream& stream, const Image& V) {
           stream << "\"" << V.name() << "\", datatype " << DataType::from<Image::value_type>().specifier() << ", index [ ";
@@ -226,7 +237,8 @@ namespace MR
         Buffer& operator= (const Buffer&) = delete;
         Buffer& operator= (Buffer&&) = default;
         Buffer (const Buffer& b) :
-          Header (b), fetch_func (b.fetch_func), store_func (b.store_func) { }
+          Header (b), fetch_func (b.fetch_func), store_func (b.store_func),
+          fetch_block_func (b.fetch_block_func), store_block_func (b.store_block_func) { }
 
 
         FORCE_INLINE ValueType get_value (size_t offset) const {
@@ -239,17 +251,52 @@ namespace MR
           store_func (val, io->segment (nseg), offset - nseg*io->segment_size(), intensity_offset(), intensity_scale());
         }
 
+        //! get \a count consecutive values (in storage order) starting from \a offset
+        /*! This converts all values in a single call per segment, avoiding
+         * the per-voxel function call overhead of get_value(). This is used
+         * by Image::with_direct_io() to preload data (and write them back),
+         * and by Image::get_values() / Image::set_values() for row-wise
+         * access in processing loops. */
+        void get_values (size_t offset, ValueType* values, size_t count) const {
+          while (count) {
+            const size_t nseg = offset / io->segment_size();
+            const size_t n = std::min (count, (nseg+1)*io->segment_size() - offset);
+            fetch_block_func (values, io->segment (nseg), offset - nseg*io->segment_size(), n, intensity_offset(), intensity_scale());
+            offset += n;
+            values += n;
+            count -= n;
+          }
+        }
+
+        //! set \a count consecutive values (in storage order) starting from \a offset
+        void set_values (size_t offset, const ValueType* values, size_t count) const {
+          while (count) {
+            const size_t nseg = offset / io->segment_size();
+            const size_t n = std::min (count, (nseg+1)*io->segment_size() - offset);
+            store_block_func (values, io->segment (nseg), offset - nseg*io->segment_size(), n, intensity_offset(), intensity_scale());
+            offset += n;
+            values += n;
+            count -= n;
+          }
+        }
+
+        //! whether get_values() & set_values() can be used
+        bool has_block_access () const { return fetch_block_func; }
+
         std::unique_ptr<uint8_t[]> data_buffer;
         void* get_data_pointer ();
 
         FORCE_INLINE ImageIO::Base* get_io () const { return io.get(); }
 
       protected:
-        std::function<ValueType(const void*,size_t,default_type,default_type)> fetch_func;
-        std::function<void(ValueType,void*,size_t,default_type,default_type)> store_func;
+        fetch_func_type<ValueType> fetch_func = nullptr;
+        store_func_type<ValueType> store_func = nullptr;
+        fetch_block_func_type<ValueType> fetch_block_func = nullptr;
+        store_block_func_type<ValueType> store_block_func = nullptr;
 
         void set_fetch_store_functions () {
           __set_fetch_store_functions (fetch_func, store_func, datatype());
+          __set_fetch_store_block_functions (fetch_block_func, store_block_func, datatype());
         }
     };
 
@@ -303,6 +350,62 @@ namespace MR
 
     CHECK_MEM_ALIGN (TmpImage<float>);
 
+
+
+    // copy entire rows of voxels along the axis contiguous in storage between
+    // an indirect IO Image and a TmpImage, converting each row in one call:
+    template <typename ValueType>
+      struct __RowCopy { NOMEMALIGN
+        __RowCopy (size_t axis) : axis (axis) { }
+
+        void operator() (Image<ValueType>& in, TmpImage<ValueType>& out) {
+          const ssize_t n = in.size (axis);
+          const bool reverse = in.stride (axis) < 0;
+          row.resize (n);
+          in.buffer->get_values (reverse ? in.offset() - (n-1) : in.offset(), row.data(), n);
+          ssize_t offset = out.offset;
+          for (ssize_t k = 0; k < n; ++k, offset += out.stride (axis))
+            Raw::store_native<ValueType> (row[reverse ? n-1-k : k], out.data, offset);
+        }
+
+        void operator() (TmpImage<ValueType>& in, Image<ValueType>& out) {
+          const ssize_t n = out.size (axis);
+          const bool reverse = out.stride (axis) < 0;
+          row.resize (n);
+          ssize_t offset = in.offset;
+          for (ssize_t k = 0; k < n; ++k, offset += in.stride (axis))
+            row[reverse ? n-1-k : k] = Raw::fetch_native<ValueType> (in.data, offset);
+          out.buffer->set_values (reverse ? out.offset() - (n-1) : out.offset(), row.data(), n);
+        }
+
+        const size_t axis;
+        Eigen::Array<ValueType,Eigen::Dynamic,1> row;
+      };
+
+    // the axis along which rows can be copied using __RowCopy, if any (data
+    // stored as bits are supported, since the block functions handle any
+    // offset; only a ValueType of bool is excluded):
+    template <typename ValueType>
+      inline size_t __row_copy_axis (const typename Image<ValueType>::Buffer& buffer)
+      {
+        if (std::is_same<ValueType,bool>::value || !buffer.has_block_access() || buffer.ndim() < 2)
+          return buffer.ndim();
+        for (size_t axis = 0; axis < buffer.ndim(); ++axis)
+          if (std::abs (buffer.stride (axis)) == 1)
+            return axis;
+        return buffer.ndim();
+      }
+
+    template <class HeaderType>
+      inline vector<size_t> __all_axes_except (const HeaderType& header, size_t axis)
+      {
+        vector<size_t> axes;
+        for (size_t n = 0; n < header.ndim(); ++n)
+          if (n != axis)
+            axes.push_back (n);
+        return axes;
+      }
+
   }
 
 
@@ -398,7 +501,13 @@ namespace MR
             auto data_buffer = std::move (buffer->data_buffer);
             TmpImage<ValueType> src = { *buffer, data_buffer.get(), vector<ssize_t> (ndim(), 0), strides, Stride::offset (*this) };
             Image<ValueType> dest (buffer);
-            threaded_copy_with_progress_message ("writing back direct IO buffer for \"" + name() + "\"", src, dest);
+            const std::string message = "writing back direct IO buffer for \"" + name() + "\"";
+            const size_t axis = __row_copy_axis<ValueType> (*buffer);
+            if (axis < ndim())
+              ThreadedLoop (message, src, __all_axes_except (*this, axis))
+                .run (__RowCopy<ValueType> (axis), src, dest);
+            else
+              threaded_copy_with_progress_message (message, src, dest);
           }
         }
       }
@@ -406,6 +515,49 @@ namespace MR
 
 
 
+  template <typename ValueType>
+    void Image<ValueType>::get_values (size_t axis, ValueType* values, ssize_t count) const
+    {
+      const ssize_t step = stride (axis);
+      if (!data_pointer && std::abs (step) == 1 && !std::is_same<ValueType,bool>::value && buffer->has_block_access()) {
+        if (step > 0)
+          buffer->get_values (data_offset, values, count);
+        else {
+          buffer->get_values (data_offset - (count-1), values, count);
+          std::reverse (values, values + count);
+        }
+        return;
+      }
+      size_t offset = data_offset;
+      for (ssize_t n = 0; n < count; ++n, offset += step)
+        values[n] = data_pointer ? Raw::fetch_native<ValueType> (data_pointer, offset) : buffer->get_value (offset);
+    }
+
+
+
+  template <typename ValueType>
+    void Image<ValueType>::set_values (size_t axis, const ValueType* values, ssize_t count)
+    {
+      // rows stored in reverse order are written one voxel at a time, to
+      // avoid an additional copy:
+      const ssize_t step = stride (axis);
+      if (!data_pointer && step == 1 && !std::is_same<ValueType,bool>::value && buffer->has_block_access()) {
+        buffer->set_values (data_offset, values, count);
+        return;
+      }
+      size_t offset = data_offset;
+      for (ssize_t n = 0; n < count; ++n, offset += step) {
+        if (data_pointer)
+          Raw::store_native<ValueType> (values[n], data_pointer, offset);
+        else
+          buffer->set_value (offset, values[n]);
+      }
+    }
+
+
+
+
+
   template <typename ValueType>
     Image<ValueType> Image<ValueType>::with_direct_io (Stride::List with_strides)
     {
@@ -441,7 +593,19 @@ namespace MR
       else {
         auto src (*this);
         TmpImage<ValueType> dest = { *buffer, buffer->data_buffer.get(), vector<ssize_t> (ndim(), 0), with_strides, Stride::offset (with_strides, *this) };
-        threaded_copy_with_progress_message ("preloading data for \"" + name() + "\"", src, dest);
+        const std::string message = "preloading data for \"" + name() + "\"";
+        // all of the data will be read once, so start reading ahead now:
+        buffer->get_io()->advise (File::MMap::Access::Sequential);
+        buffer->get_io()->prefetch (0, voxel_count (*this));
+        const size_t axis = __row_copy_axis<ValueType> (*buffer);
+        if (axis < ndim()) {
+          src.index (axis) = 0;
+          ThreadedLoop (message, src, __all_axes_except (*this, axis))
+            .run (__RowCopy<ValueType> (axis), src, dest);
+        }
+        else
+          threaded_copy_with_progress_message (message, src, dest);
+        buffer->get_io()->advise (File::MMap::Access::Normal);
       }
 
       return Image (buffer, with_strides);
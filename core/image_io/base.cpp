@@ -34,6 +34,16 @@ namespace MR
 
     bool Base::is_file_backed () const { return true; }
 
+    void Base::advise (File::MMap::Access) const { }
+
+    void Base::prefetch (size_t, size_t) const { }
+
+    uint8_t* Base::load_segment (size_t) const
+    {
+      assert (0 && "segment address not set by IO handler");
+      return nullptr;
+    }
+
     void Base::open (const Header& header, size_t buffer_size)
     {
       if (addresses.size())
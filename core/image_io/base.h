@@ -25,6 +25,7 @@
 #include "mrtrix.h"
 #include "types.h"
 #include "file/entry.h"
+#include "file/mmap.h"
 
 #define MAX_FILES_PER_IMAGE 256U
 
@@ -75,7 +76,8 @@ namespace MR
 
         uint8_t* segment (size_t n) const {
           assert (n < addresses.size());
-          return addresses[n].get();
+          uint8_t* address = addresses[n].get();
+          return address ? address : load_segment (n);
         }
         size_t nsegments () const {
           return addresses.size();
@@ -85,6 +87,19 @@ namespace MR
           return segsize;
         }
 
+        //! declare the expected pattern of access to the image data
+        /*! This is only a hint, which handlers may use to tune readahead
+         * from the underlying files. */
+        virtual void advise (File::MMap::Access access) const;
+
+        //! request asynchronous loading of \a count voxels from \a offset
+        /*! Offsets are in voxels, in storage order (as used by the
+         * segments). This returns immediately; it can be used to load the
+         * next part of the image (e.g. the next volume) while processing the
+         * current one. It has no effect for handlers that hold their data in
+         * RAM. */
+        virtual void prefetch (size_t offset, size_t count) const;
+
         vector<File::Entry> files;
 
         void merge (const Base& B) {
@@ -110,6 +125,12 @@ namespace MR
         }
         virtual void load (const Header& header, size_t buffer_size) = 0;
         virtual void unload (const Header& header) = 0;
+
+        //! invoked on access to any segment whose address has not been set
+        /*! This allows handlers to defer loading of (parts of) the image data
+         * until they are actually accessed, by leaving the corresponding
+         * entries in \a addresses empty. Implementations must be thread-safe. */
+        virtual uint8_t* load_segment (size_t n) const;
     };
 
   }
@@ -14,6 +14,7 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include <cmath>
 #include <limits>
 
 #include "app.h"
@@ -76,6 +77,30 @@ namespace MR
 
 
 
+    void Default::advise (File::MMap::Access access) const
+    {
+      for (const auto& mmap : mmaps)
+        mmap->advise (access);
+    }
+
+
+
+    void Default::prefetch (size_t offset, size_t count) const
+    {
+      if (mmaps.empty() || offset >= mmaps.size()*segsize)
+        return;
+      const size_t end = offset + std::min (count, mmaps.size()*segsize - offset);
+      // bytes per voxel may be fractional for bitwise data:
+      const double bytes_per_voxel = double (bytes_per_segment) / segsize;
+      for (size_t n = offset / segsize; n < mmaps.size() && n*segsize < end; ++n) {
+        const int64_t from = std::floor (bytes_per_voxel * (std::max (offset, n*segsize) - n*segsize));
+        const int64_t to = std::ceil (bytes_per_voxel * (std::min (end, (n+1)*segsize) - n*segsize));
+        mmaps[n]->prefetch (from, to - from);
+      }
+    }
+
+
+
     void Default::map_files (const Header& header)
     {
       mmaps.resize (files.size());
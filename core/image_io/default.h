@@ -35,6 +35,9 @@ namespace MR
         Default (Default&&) noexcept = default;
         Default& operator=(Default&&) = delete;
 
+        virtual void advise (File::MMap::Access access) const;
+        virtual void prefetch (size_t offset, size_t count) const;
+
       protected:
         vector<std::shared_ptr<File::MMap> > mmaps;
         int64_t bytes_per_segment;
@@ -135,6 +135,93 @@ namespace MR
       }
 
 
+
+    // convert entire blocks of consecutive values:
+
+    template <typename ValueType, fetch_func_type<ValueType> fetch>
+      void __fetch_block (ValueType* values, const void* data, size_t i, size_t count, default_type offset, default_type scale) {
+        for (size_t n = 0; n < count; ++n)
+          values[n] = fetch (data, i+n, offset, scale);
+      }
+
+    template <typename ValueType, store_func_type<ValueType> store>
+      void __store_block (const ValueType* values, void* data, size_t i, size_t count, default_type offset, default_type scale) {
+        for (size_t n = 0; n < count; ++n)
+          store (values[n], data, i+n, offset, scale);
+      }
+
+
+
+    // all conversion functions for a given combination of RAM & storage types:
+
+    template <typename ValueType>
+      struct __FetchStore { NOMEMALIGN
+        fetch_func_type<ValueType> fetch;
+        store_func_type<ValueType> store;
+        fetch_block_func_type<ValueType> fetch_block;
+        store_block_func_type<ValueType> store_block;
+      };
+
+    template <typename ValueType, fetch_func_type<ValueType> fetch, store_func_type<ValueType> store>
+      inline __FetchStore<ValueType> __functions () {
+        return { fetch, store, __fetch_block<ValueType,fetch>, __store_block<ValueType,store> };
+      }
+
+    template <typename ValueType>
+      __FetchStore<ValueType> __get_fetch_store_functions (DataType datatype)
+      {
+        switch (datatype()) {
+          case DataType::Bit:
+            return __functions<ValueType, __fetch<ValueType,bool>, __store<ValueType,bool>>();
+          case DataType::Int8:
+            return __functions<ValueType, __fetch<ValueType,int8_t>, __store<ValueType,int8_t>>();
+          case DataType::UInt8:
+            return __functions<ValueType, __fetch<ValueType,uint8_t>, __store<ValueType,uint8_t>>();
+          case DataType::Int16LE:
+            return __functions<ValueType, __fetch_LE<ValueType,int16_t>, __store_LE<ValueType,int16_t>>();
+          case DataType::UInt16LE:
+            return __functions<ValueType, __fetch_LE<ValueType,uint16_t>, __store_LE<ValueType,uint16_t>>();
+          case DataType::Int16BE:
+            return __functions<ValueType, __fetch_BE<ValueType,int16_t>, __store_BE<ValueType,int16_t>>();
+          case DataType::UInt16BE:
+            return __functions<ValueType, __fetch_BE<ValueType,uint16_t>, __store_BE<ValueType,uint16_t>>();
+          case DataType::Int32LE:
+            return __functions<ValueType, __fetch_LE<ValueType,int32_t>, __store_LE<ValueType,int32_t>>();
+          case DataType::UInt32LE:
+            return __functions<ValueType, __fetch_LE<ValueType,uint32_t>, __store_LE<ValueType,uint32_t>>();
+          case DataType::Int32BE:
+            return __functions<ValueType, __fetch_BE<ValueType,int32_t>, __store_BE<ValueType,int32_t>>();
+          case DataType::UInt32BE:
+            return __functions<ValueType, __fetch_BE<ValueType,uint32_t>, __store_BE<ValueType,uint32_t>>();
+          case DataType::Int64LE:
+            return __functions<ValueType, __fetch_LE<ValueType,int64_t>, __store_LE<ValueType,int64_t>>();
+          case DataType::UInt64LE:
+            return __functions<ValueType, __fetch_LE<ValueType,uint64_t>, __store_LE<ValueType,uint64_t>>();
+          case DataType::Int64BE:
+            return __functions<ValueType, __fetch_BE<ValueType,int64_t>, __store_BE<ValueType,int64_t>>();
+          case DataType::UInt64BE:
+            return __functions<ValueType, __fetch_BE<ValueType,uint64_t>, __store_BE<ValueType,uint64_t>>();
+          case DataType::Float32LE:
+            return __functions<ValueType, __fetch_LE<ValueType,float>, __store_LE<ValueType,float>>();
+          case DataType::Float32BE:
+            return __functions<ValueType, __fetch_BE<ValueType,float>, __store_BE<ValueType,float>>();
+          case DataType::Float64LE:
+            return __functions<ValueType, __fetch_LE<ValueType,double>, __store_LE<ValueType,double>>();
+          case DataType::Float64BE:
+            return __functions<ValueType, __fetch_BE<ValueType,double>, __store_BE<ValueType,double>>();
+          case DataType::CFloat32LE:
+            return __functions<ValueType, __fetch_LE<ValueType,cfloat>, __store_LE<ValueType,cfloat>>();
+          case DataType::CFloat32BE:
+            return __functions<ValueType, __fetch_BE<ValueType,cfloat>, __store_BE<ValueType,cfloat>>();
+          case DataType::CFloat64LE:
+            return __functions<ValueType, __fetch_LE<ValueType,cdouble>, __store_LE<ValueType,cdouble>>();
+          case DataType::CFloat64BE:
+            return __functions<ValueType, __fetch_BE<ValueType,cdouble>, __store_BE<ValueType,cdouble>>();
+          default:
+            throw Exception ("invalid data type in image header");
+        }
+      }
+
   }
 
 
@@ -143,113 +230,37 @@ namespace MR
 
   template <typename ValueType>
     typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_store_functions (
-        std::function<ValueType(const void*,size_t,default_type,default_type)>& fetch_func,
-        std::function<void(ValueType,void*,size_t,default_type,default_type)>& store_func,
-        DataType datatype) {
-
-      switch (datatype()) {
-        case DataType::Bit:
-          fetch_func = __fetch<ValueType,bool>;
-          store_func = __store<ValueType,bool>;
-          return;
-        case DataType::Int8:
-          fetch_func = __fetch<ValueType,int8_t>;
-          store_func = __store<ValueType,int8_t>;
-          return;
-        case DataType::UInt8:
-          fetch_func = __fetch<ValueType,uint8_t>;
-          store_func = __store<ValueType,uint8_t>;
-          return;
-        case DataType::Int16LE:
-          fetch_func = __fetch_LE<ValueType,int16_t>;
-          store_func = __store_LE<ValueType,int16_t>;
-          return;
-        case DataType::UInt16LE:
-          fetch_func = __fetch_LE<ValueType,uint16_t>;
-          store_func = __store_LE<ValueType,uint16_t>;
-          return;
-        case DataType::Int16BE:
-          fetch_func = __fetch_BE<ValueType,int16_t>;
-          store_func = __store_BE<ValueType,int16_t>;
-          return;
-        case DataType::UInt16BE:
-          fetch_func = __fetch_BE<ValueType,uint16_t>;
-          store_func = __store_BE<ValueType,uint16_t>;
-          return;
-        case DataType::Int32LE:
-          fetch_func = __fetch_LE<ValueType,int32_t>;
-          store_func = __store_LE<ValueType,int32_t>;
-          return;
-        case DataType::UInt32LE:
-          fetch_func = __fetch_LE<ValueType,uint32_t>;
-          store_func = __store_LE<ValueType,uint32_t>;
-          return;
-        case DataType::Int32BE:
-          fetch_func = __fetch_BE<ValueType,int32_t>;
-          store_func = __store_BE<ValueType,int32_t>;
-          return;
-        case DataType::UInt32BE:
-          fetch_func = __fetch_BE<ValueType,uint32_t>;
-          store_func = __store_BE<ValueType,uint32_t>;
-          return;
-        case DataType::Int64LE:
-          fetch_func = __fetch_LE<ValueType,int64_t>;
-          store_func = __store_LE<ValueType,int64_t>;
-          return;
-        case DataType::UInt64LE:
-          fetch_func = __fetch_LE<ValueType,uint64_t>;
-          store_func = __store_LE<ValueType,uint64_t>;
-          return;
-        case DataType::Int64BE:
-          fetch_func = __fetch_BE<ValueType,int64_t>;
-          store_func = __store_BE<ValueType,int64_t>;
-          return;
-        case DataType::UInt64BE:
-          fetch_func = __fetch_BE<ValueType,uint64_t>;
-          store_func = __store_BE<ValueType,uint64_t>;
-          return;
-        case DataType::Float32LE:
-          fetch_func = __fetch_LE<ValueType,float>;
-          store_func = __store_LE<ValueType,float>;
-          return;
-        case DataType::Float32BE:
-          fetch_func = __fetch_BE<ValueType,float>;
-          store_func = __store_BE<ValueType,float>;
-          return;
-        case DataType::Float64LE:
-          fetch_func = __fetch_LE<ValueType,double>;
-          store_func = __store_LE<ValueType,double>;
-          return;
-        case DataType::Float64BE:
-          fetch_func = __fetch_BE<ValueType,double>;
-          store_func = __store_BE<ValueType,double>;
-          return;
-        case DataType::CFloat32LE:
-          fetch_func = __fetch_LE<ValueType,cfloat>;
-          store_func = __store_LE<ValueType,cfloat>;
-          return;
-        case DataType::CFloat32BE:
-          fetch_func = __fetch_BE<ValueType,cfloat>;
-          store_func = __store_BE<ValueType,cfloat>;
-          return;
-        case DataType::CFloat64LE:
-          fetch_func = __fetch_LE<ValueType,cdouble>;
-          store_func = __store_LE<ValueType,cdouble>;
-          return;
-        case DataType::CFloat64BE:
-          fetch_func = __fetch_BE<ValueType,cdouble>;
-          store_func = __store_BE<ValueType,cdouble>;
-          return;
-        default:
-          throw Exception ("invalid data type in image header");
-      }
+        fetch_func_type<ValueType>& fetch_func,
+        store_func_type<ValueType>& store_func,
+        DataType datatype)
+    {
+      const auto functions = __get_fetch_store_functions<ValueType> (datatype);
+      fetch_func = functions.fetch;
+      store_func = functions.store;
+    }
+
+
+
+  template <typename ValueType>
+    typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_store_block_functions (
+        fetch_block_func_type<ValueType>& fetch_block_func,
+        store_block_func_type<ValueType>& store_block_func,
+        DataType datatype)
+    {
+      const auto functions = __get_fetch_store_functions<ValueType> (datatype);
+      fetch_block_func = functions.fetch_block;
+      store_block_func = functions.store_block;
     }
 
   // explicit instantiation of fetch/store methods for all types:
 #define __DEFINE_FETCH_STORE_FUNCTION_FOR_TYPE(ValueType) \
   template void __set_fetch_store_functions<ValueType> ( \
-      std::function<ValueType(const void*,size_t,default_type,default_type)>& fetch_func, \
-      std::function<void(ValueType,void*,size_t,default_type,default_type)>& store_func, \
+      fetch_func_type<ValueType>& fetch_func, \
+      store_func_type<ValueType>& store_func, \
+      DataType datatype); \
+  template void __set_fetch_store_block_functions<ValueType> ( \
+      fetch_block_func_type<ValueType>& fetch_block_func, \
+      store_block_func_type<ValueType>& store_block_func, \
       DataType datatype)
 
   __DEFINE_FETCH_STORE_FUNCTION_FOR_TYPE(bool);
@@ -23,19 +23,53 @@
 namespace MR
 {
 
+  //! function to fetch the value at offset \a i from \a data, applying intensity scaling
+  template <typename ValueType>
+    using fetch_func_type = ValueType (*) (const void* data, size_t i, default_type offset, default_type scale);
+
+  //! function to store \a value at offset \a i into \a data, applying intensity scaling
+  template <typename ValueType>
+    using store_func_type = void (*) (ValueType value, void* data, size_t i, default_type offset, default_type scale);
+
+  //! function to fetch \a count consecutive values starting at offset \a i from \a data into \a values
+  template <typename ValueType>
+    using fetch_block_func_type = void (*) (ValueType* values, const void* data, size_t i, size_t count, default_type offset, default_type scale);
+
+  //! function to store \a count consecutive \a values into \a data starting at offset \a i
+  template <typename ValueType>
+    using store_block_func_type = void (*) (const ValueType* values, void* data, size_t i, size_t count, default_type offset, default_type scale);
+
+
 
   template <typename ValueType>
     typename std::enable_if<!is_data_type<ValueType>::value, void>::type __set_fetch_store_functions (
-        std::function<ValueType(const void*,size_t,default_type,default_type)>& /*fetch_func*/,
-        std::function<void(ValueType,void*,size_t,default_type,default_type)>& /*store_func*/,
+        fetch_func_type<ValueType>& /*fetch_func*/,
+        store_func_type<ValueType>& /*store_func*/,
+        DataType /*datatype*/) { }
+
+  template <typename ValueType>
+    typename std::enable_if<!is_data_type<ValueType>::value, void>::type __set_fetch_store_block_functions (
+        fetch_block_func_type<ValueType>& /*fetch_block_func*/,
+        store_block_func_type<ValueType>& /*store_block_func*/,
         DataType /*datatype*/) { }
 
 
 
   template <typename ValueType>
     typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_store_functions (
-        std::function<ValueType(const void*,size_t,default_type,default_type)>& fetch_func,
-        std::function<void(ValueType,void*,size_t,default_type,default_type)>& store_func,
+        fetch_func_type<ValueType>& fetch_func,
+        store_func_type<ValueType>& store_func,
+        DataType datatype);
+
+  //! get functions to convert entire blocks of data to/from storage
+  /*! These are resolved at compile-time for each combination of \a ValueType
+   * and storage type, allowing the compiler to inline (and where possible,
+   * vectorise) the conversion of each value, rather than incurring a call
+   * via function pointer for each value. */
+  template <typename ValueType>
+    typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_store_block_functions (
+        fetch_block_func_type<ValueType>& fetch_block_func,
+        store_block_func_type<ValueType>& store_block_func,
         DataType datatype);
 
 
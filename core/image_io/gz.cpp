@@ -19,10 +19,10 @@
 #include "app.h"
 #include "progressbar.h"
 #include "header.h"
+#include "thread.h"
 #include "image_io/gz.h"
-#include "file/gz.h"
-
-#define BYTES_PER_ZCALL 524288
+#include "file/config.h"
+#include "file/gz_block.h"
 
 namespace MR
 {
@@ -39,6 +39,44 @@ namespace MR
       if (files.size() * bytes_per_segment > std::numeric_limits<size_t>::max())
         throw Exception ("image \"" + header.name() + "\" is larger than maximum accessible memory");
 
+      //CONF option: GZLazyLoad
+      //CONF default: 0 (false)
+      //CONF A boolean value to indicate whether GZip-compressed images
+      //CONF opened read-only should be uncompressed on demand, one segment
+      //CONF at a time, as their contents are accessed, rather than in their
+      //CONF entirety when opened. This reduces the time & memory required
+      //CONF when only a subset of the image is accessed (e.g. extracting a
+      //CONF single volume), but prevents direct access to the image data
+      //CONF otherwise possible in some commands. This is only available for
+      //CONF images compressed by MRtrix3 (see :option:`GZBlockSize`).
+      if (!is_new && !writable && files.size() == 1 && header.datatype().bits() >= 8 &&
+          File::Config::get_bool ("GZLazyLoad", false)) {
+        std::unique_ptr<File::GZBlock::Reader> reader (new File::GZBlock::Reader (files[0].name));
+        if (reader->is_indexed()) {
+          // align segments with blocks in file if possible:
+          const int64_t bytes_per_voxel = header.datatype().bytes();
+          const auto& index (reader->get_index());
+          const auto& block (index[index.find (files[0].start)]);
+          int64_t bytes_per_chunk = block.offset == files[0].start ? block.size : File::GZBlock::block_size();
+          bytes_per_chunk = std::max (bytes_per_chunk - bytes_per_chunk % bytes_per_voxel, bytes_per_voxel);
+          if (bytes_per_chunk < bytes_per_segment) {
+            //CONF option: GZLazyLoadCacheSize
+            //CONF default: 1024
+            //CONF The maximum amount of RAM (in MB) to use for holding
+            //CONF uncompressed segments of images loaded on demand (see
+            //CONF :option:`GZLazyLoad`). This limit is only enforced while no
+            //CONF other threads are active.
+            const int64_t max_size = int64_t (std::max (File::Config::get_int ("GZLazyLoadCacheSize", 1024), 1)) << 20;
+            cache.reset (new SegmentCache (std::move (reader), files[0].start, bytes_per_segment, bytes_per_chunk, max_size));
+            segsize = bytes_per_chunk / bytes_per_voxel;
+            // leave addresses empty: segments will be loaded by load_segment():
+            addresses.resize ((bytes_per_segment + bytes_per_chunk - 1) / bytes_per_chunk);
+            INFO ("image \"" + header.name() + "\" will be uncompressed on demand (" + str(addresses.size()) + " segments)");
+            return;
+          }
+        }
+      }
+
       DEBUG ("loading image \"" + header.name() + "\"...");
       addresses.resize (header.datatype().bits() == 1 && files.size() > 1 ? files.size() : 1);
       addresses[0].reset (new uint8_t [files.size() * bytes_per_segment]);
@@ -48,20 +86,21 @@ namespace MR
       if (is_new)
         memset (addresses[0].get(), 0, files.size() * bytes_per_segment);
       else {
+        const size_t bytes_per_zcall = File::GZBlock::batch_size();
         ProgressBar progress ("uncompressing image \"" + header.name() + "\"",
-            files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+            files.size() * bytes_per_segment / bytes_per_zcall);
         for (size_t n = 0; n < files.size(); n++) {
-          File::GZ zf (files[n].name, "rb");
+          File::GZBlock::Reader zf (files[n].name);
           zf.seek (files[n].start);
           uint8_t* address = addresses[0].get() + n*bytes_per_segment;
-          uint8_t* last = address + bytes_per_segment - BYTES_PER_ZCALL;
+          uint8_t* last = address + bytes_per_segment - bytes_per_zcall;
           while (address < last) {
-            zf.read (reinterpret_cast<char*> (address), BYTES_PER_ZCALL);
-            address += BYTES_PER_ZCALL;
+            zf.read (address, bytes_per_zcall);
+            address += bytes_per_zcall;
             ++progress;
           }
-          last += BYTES_PER_ZCALL;
-          zf.read (reinterpret_cast<char*> (address), last - address);
+          last += bytes_per_zcall;
+          zf.read (address, last - address);
         }
       }
 
@@ -77,28 +116,34 @@ namespace MR
 
     void GZ::unload (const Header& header)
     {
+      if (cache) {
+        cache.reset();
+        return;
+      }
+
       if (addresses.size()) {
         assert (addresses[0]);
 
         if (writable) {
+          const size_t bytes_per_zcall = File::GZBlock::batch_size();
           ProgressBar progress ("compressing image \"" + header.name() + "\"",
-              files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+              files.size() * bytes_per_segment / bytes_per_zcall);
           for (size_t n = 0; n < files.size(); n++) {
             assert (files[n].start == int64_t (lead_in_size));
-            File::GZ zf (files[n].name, "wb");
+            File::GZBlock::Writer zf (files[n].name);
             if (lead_in)
-              zf.write (reinterpret_cast<const char*> (lead_in.get()), lead_in_size);
+              zf.write (lead_in.get(), lead_in_size);
             uint8_t* address = addresses[0].get() + n*bytes_per_segment;
-            uint8_t* last = address + bytes_per_segment - BYTES_PER_ZCALL;
+            uint8_t* last = address + bytes_per_segment - bytes_per_zcall;
             while (address < last) {
-              zf.write (reinterpret_cast<const char*> (address), BYTES_PER_ZCALL);
-              address += BYTES_PER_ZCALL;
+              zf.write (address, bytes_per_zcall);
+              address += bytes_per_zcall;
               ++progress;
             }
-            last += BYTES_PER_ZCALL;
-            zf.write (reinterpret_cast<const char*> (address), last - address);
+            last += bytes_per_zcall;
+            zf.write (address, last - address);
             if (lead_out)
-              zf.write (reinterpret_cast<const char*> (lead_out.get()), lead_out_size);
+              zf.write (lead_out.get(), lead_out_size);
           }
         }
 
@@ -107,8 +152,94 @@ namespace MR
 
 
 
+    uint8_t* GZ::load_segment (size_t n) const
+    {
+      assert (cache);
+      return cache->get (n);
+    }
+
+
+
+
+
+    GZ::SegmentCache::SegmentCache (std::unique_ptr<File::GZBlock::Reader>&& reader, int64_t start,
+        int64_t total_bytes, int64_t bytes_per_segment, int64_t max_size) :
+      reader (std::move (reader)),
+      start (start),
+      total_bytes (total_bytes),
+      bytes_per_segment (bytes_per_segment),
+      num_segments ((total_bytes + bytes_per_segment - 1) / bytes_per_segment),
+      max_loaded (std::max (max_size / bytes_per_segment, int64_t(1))),
+      addresses (new std::atomic<uint8_t*> [num_segments]),
+      referenced (new std::atomic<bool> [num_segments]),
+      data (num_segments),
+      loading (num_segments, false),
+      num_loaded (0),
+      clock_hand (0)
+    {
+      for (size_t n = 0; n < num_segments; ++n) {
+        addresses[n].store (nullptr);
+        referenced[n].store (false);
+      }
+    }
+
+
+
+    uint8_t* GZ::SegmentCache::load (size_t n)
+    {
+      std::unique_lock<std::mutex> lock (mutex);
+      while (loading[n])
+        loaded.wait (lock);
+      uint8_t* address = addresses[n].load (std::memory_order_relaxed);
+      if (address)
+        return address;
+
+      // uncompress without holding the lock, so that other
+      // threads can concurrently access / load other segments:
+      loading[n] = true;
+      lock.unlock();
+      const int64_t offset = n * bytes_per_segment;
+      std::unique_ptr<uint8_t[]> segment;
+      try {
+        segment.reset (new uint8_t [std::min (bytes_per_segment, total_bytes - offset)]);
+        reader->read_at (start + offset, segment.get(), std::min (bytes_per_segment, total_bytes - offset));
+      }
+      catch (...) {
+        lock.lock();
+        loading[n] = false;
+        loaded.notify_all();
+        throw;
+      }
+      lock.lock();
+
+      address = segment.get();
+      data[n] = std::move (segment);
+      referenced[n].store (true, std::memory_order_relaxed);
+      addresses[n].store (address, std::memory_order_release);
+      loading[n] = false;
+      ++num_loaded;
+      loaded.notify_all();
+
+      if (num_loaded > max_loaded && !Thread::__Backend::valid())
+        release (n);
+      return address;
+    }
 
-  }
-}
 
 
+    void GZ::SegmentCache::release (size_t keep)
+    {
+      while (num_loaded > max_loaded) {
+        clock_hand = (clock_hand + 1) % num_segments;
+        if (clock_hand == keep || !data[clock_hand])
+          continue;
+        if (referenced[clock_hand].exchange (false, std::memory_order_relaxed))
+          continue;
+        addresses[clock_hand].store (nullptr, std::memory_order_relaxed);
+        data[clock_hand].reset();
+        --num_loaded;
+      }
+    }
+
+  }
+}
@@ -17,8 +17,12 @@
 #ifndef __image_io_gz_h__
 #define __image_io_gz_h__
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
 #include "image_io/base.h"
-#include "file/mmap.h"
+#include "file/gz_block.h"
 
 namespace MR
 {
@@ -46,12 +50,50 @@ namespace MR
         }
 
       protected:
+        //! uncompresses segments of a read-only image as they are accessed
+        /*! Decompressed segments are held in RAM up to a maximum of \a
+         * max_size bytes, beyond which the least recently used segments are
+         * released (using the CLOCK approximation). Since other threads may
+         * hold on to the address of any segment while in use, segments are
+         * only ever released when no other threads are running. */
+        class SegmentCache { NOMEMALIGN
+          public:
+            SegmentCache (std::unique_ptr<File::GZBlock::Reader>&& reader, int64_t start,
+                int64_t total_bytes, int64_t bytes_per_segment, int64_t max_size);
+
+            uint8_t* get (size_t n) {
+              uint8_t* address = addresses[n].load (std::memory_order_acquire);
+              if (!address)
+                return load (n);
+              if (!referenced[n].load (std::memory_order_relaxed))
+                referenced[n].store (true, std::memory_order_relaxed);
+              return address;
+            }
+
+          protected:
+            std::unique_ptr<File::GZBlock::Reader> reader;
+            const int64_t start, total_bytes, bytes_per_segment;
+            const size_t num_segments, max_loaded;
+            std::unique_ptr<std::atomic<uint8_t*>[]> addresses;
+            std::unique_ptr<std::atomic<bool>[]> referenced;
+            vector<std::unique_ptr<uint8_t[]>> data;
+            vector<bool> loading;
+            size_t num_loaded, clock_hand;
+            std::mutex mutex;
+            std::condition_variable loaded;
+
+            uint8_t* load (size_t n);
+            void release (size_t keep);
+        };
+
         int64_t  bytes_per_segment;
         size_t   lead_in_size, lead_out_size;
         std::unique_ptr<uint8_t[]> lead_in, lead_out;
+        std::unique_ptr<SegmentCache> cache;
 
         virtual void load (const Header&, size_t);
         virtual void unload (const Header&);
+        virtual uint8_t* load_segment (size_t n) const;
     };
 
   }
@@ -20,14 +20,92 @@
 #include "signal_handler.h"
 #include "header.h"
 #include "image_io/pipe.h"
+#include "file/config.h"
 
 namespace MR
 {
   namespace ImageIO
   {
 
+    namespace {
+      // amount of data passed through the pipe in each read / write call,
+      // also used as the size of each segment of streamed input images:
+      constexpr int64_t stream_chunk_size = 1048576;
+    }
+
+
+
+    Pipe::Pipe (const Header& header) :
+      Base (header),
+      pending_bytes (footprint (header)) { }
+
+
+
+    Pipe::~Pipe ()
+    {
+      // an input stream whose data were never accessed still needs to be
+      // consumed, otherwise the upstream command would fail to write it:
+      if (is_streamed() && !is_new && pending_bytes) {
+        DEBUG ("discarding unused data for image streamed through standard input");
+        vector<char> scratch (std::min (pending_bytes, stream_chunk_size));
+        while (pending_bytes > 0 && std::cin.read (scratch.data(), std::min (pending_bytes, int64_t (scratch.size()))))
+          pending_bytes -= std::cin.gcount();
+      }
+    }
+
+
+
+    bool Pipe::streaming ()
+    {
+      //CONF option: PipeStreaming
+      //CONF default: 0 (false)
+      //CONF Whether images piped between commands (using a dash in place
+      //CONF of the image path) should be streamed through the pipe, rather
+      //CONF than written to a temporary file whose name is only passed on
+      //CONF once the command is done. This avoids the temporary file;
+      //CONF note however that the image data are only sent once the image
+      //CONF has been closed (since the order in which voxels are written is
+      //CONF not known in advance), so that the two commands do not otherwise
+      //CONF process the image concurrently. This only needs to be set for
+      //CONF the commands writing to the pipe.
+      static const bool stream = File::Config::get_bool ("PipeStreaming", false);
+      return stream;
+    }
+
+
+
     void Pipe::load (const Header& header, size_t)
     {
+      if (is_streamed()) {
+        if (is_new) {
+          DEBUG ("allocating buffer for image \"" + header.name() + "\" streamed to standard output...");
+          const int64_t bytes = footprint (header);
+          addresses.resize (1);
+          try {
+            addresses[0].reset (new uint8_t [bytes]);
+          }
+          catch (...) {
+            throw Exception ("failed to allocate memory for image \"" + header.name() + "\"");
+          }
+          memset (addresses[0].get(), 0, bytes);
+          return;
+        }
+
+        DEBUG ("receiving image \"" + header.name() + "\" streamed through standard input...");
+        int64_t bytes_per_segment = pending_bytes;
+        if (header.datatype().bits() >= 8) {
+          const int64_t bytes_per_voxel = header.datatype().bytes();
+          bytes_per_segment = std::max (stream_chunk_size - stream_chunk_size % bytes_per_voxel, bytes_per_voxel);
+          segsize = bytes_per_segment / bytes_per_voxel;
+        }
+        // leave addresses empty: segments will be provided by load_segment()
+        // as they are received:
+        addresses.resize ((pending_bytes + bytes_per_segment - 1) / bytes_per_segment);
+        receiver.reset (new Receiver (pending_bytes, bytes_per_segment));
+        pending_bytes = 0;
+        return;
+      }
+
       assert (files.size() == 1);
       DEBUG ("mapping piped image \"" + files[0].name + "\"...");
 
@@ -43,8 +121,26 @@ namespace MR
     }
 
 
-    void Pipe::unload (const Header&)
+    void Pipe::unload (const Header& header)
     {
+      if (is_streamed()) {
+        if (receiver) {
+          // wait for the remainder of the stream:
+          receiver.reset();
+          return;
+        }
+        if (is_new && addresses[0]) {
+          DEBUG ("streaming image \"" + header.name() + "\" to standard output...");
+          const int64_t bytes = footprint (header);
+          for (int64_t offset = 0; offset < bytes; offset += stream_chunk_size)
+            std::cout.write (reinterpret_cast<const char*> (addresses[0].get() + offset), std::min (stream_chunk_size, bytes - offset));
+          std::cout.flush();
+          if (!std::cout.good())
+            throw Exception ("error streaming image \"" + header.name() + "\" to standard output");
+        }
+        return;
+      }
+
       if (mmap) {
         mmap.reset();
         if (is_new) {
@@ -55,9 +151,76 @@ namespace MR
       }
     }
 
+
+
+    uint8_t* Pipe::load_segment (size_t n) const
+    {
+      assert (receiver);
+      return receiver->get (n);
+    }
+
     bool Pipe::delete_piped_images = true;
 
-  }
-}
 
 
+
+
+    Pipe::Receiver::Receiver (int64_t total_bytes, int64_t bytes_per_segment) :
+      total_bytes (total_bytes),
+      bytes_per_segment (bytes_per_segment),
+      num_received (0),
+      failed (false)
+    {
+      try {
+        data.reset (new uint8_t [total_bytes]);
+      }
+      catch (...) {
+        throw Exception ("failed to allocate memory for image streamed through standard input");
+      }
+      // not launched via Thread::run(), since that would prevent the
+      // command itself from running multi-threaded:
+      thread = std::async (std::launch::async, &Receiver::execute, this);
+    }
+
+
+
+    Pipe::Receiver::~Receiver ()
+    {
+      if (thread.valid())
+        thread.wait();
+    }
+
+
+
+    void Pipe::Receiver::execute ()
+    {
+      const size_t num_segments = (total_bytes + bytes_per_segment - 1) / bytes_per_segment;
+      for (size_t n = 0; n < num_segments; ++n) {
+        const int64_t offset = n * bytes_per_segment;
+        const int64_t size = std::min (bytes_per_segment, total_bytes - offset);
+        std::cin.read (reinterpret_cast<char*> (data.get() + offset), size);
+        std::lock_guard<std::mutex> lock (mutex);
+        if (std::cin.gcount() != size) {
+          failed = true;
+          received.notify_all();
+          return;
+        }
+        num_received.store (n+1, std::memory_order_release);
+        received.notify_all();
+      }
+    }
+
+
+
+    uint8_t* Pipe::Receiver::wait (size_t n)
+    {
+      std::unique_lock<std::mutex> lock (mutex);
+      while (num_received.load (std::memory_order_relaxed) <= n && !failed)
+        received.wait (lock);
+      if (num_received.load (std::memory_order_relaxed) <= n)
+        throw Exception ("unexpected end of data for image streamed through standard input");
+      return data.get() + n*bytes_per_segment;
+    }
+
+  }
+}
@@ -17,6 +17,11 @@
 #ifndef __image_io_pipe_h__
 #define __image_io_pipe_h__
 
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+
 #include "memory.h"
 #include "image_io/base.h"
 #include "file/mmap.h"
@@ -26,18 +31,65 @@ namespace MR
   namespace ImageIO
   {
 
+    //! handler for images passed between commands through a pipe
+    /*! By default, a piped image is written to a temporary file, whose name
+     * is passed to the next command once the image has been closed. If
+     * streaming is enabled (see streaming()), the image header is instead
+     * sent through standard output as soon as the image is created, followed
+     * by the image data (in storage order) once it is closed. Handlers
+     * constructed without any files deal with such streamed images. */
     class Pipe : public Base
     { NOMEMALIGN
       public:
-        Pipe (Base&& io_handler) : Base (std::move (io_handler)) { }
+        Pipe (Base&& io_handler) : Base (std::move (io_handler)), pending_bytes (0) { }
+        Pipe (const Header& header);
+        ~Pipe ();
 
         static bool delete_piped_images;
 
+        //! whether images piped to standard output should be streamed
+        static bool streaming ();
+
       protected:
+        //! receives the data of an image streamed through standard input
+        /*! Data are read by a separate thread, so that segments become
+         * accessible as soon as they have been received: the downstream
+         * command can therefore start processing the first parts of the
+         * image while the remainder is still being sent. */
+        class Receiver { NOMEMALIGN
+          public:
+            Receiver (int64_t total_bytes, int64_t bytes_per_segment);
+            ~Receiver ();
+
+            uint8_t* get (size_t n) {
+              if (n < num_received.load (std::memory_order_acquire))
+                return data.get() + n*bytes_per_segment;
+              return wait (n);
+            }
+
+          protected:
+            const int64_t total_bytes, bytes_per_segment;
+            std::unique_ptr<uint8_t[]> data;
+            std::atomic<size_t> num_received;
+            bool failed;
+            std::mutex mutex;
+            std::condition_variable received;
+            std::future<void> thread;
+
+            void execute ();
+            uint8_t* wait (size_t n);
+        };
+
         std::unique_ptr<File::MMap> mmap;
+        std::unique_ptr<Receiver> receiver;
+        // for streamed input: the amount of data not yet read from standard input
+        int64_t pending_bytes;
+
+        bool is_streamed () const { return files.empty(); }
 
         virtual void load (const Header&, size_t);
         virtual void unload (const Header&);
+        virtual uint8_t* load_segment (size_t n) const;
 
     };
 
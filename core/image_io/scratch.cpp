@@ -16,14 +16,49 @@
 
 #include <memory>
 
+#ifndef MRTRIX_WINDOWS
+# include <sys/mman.h>
+#endif
+
 #include "image_io/scratch.h"
 #include "header.h"
+#include "file/config.h"
 
 namespace MR
 {
   namespace ImageIO
   {
 
+    namespace {
+
+      // request transparent huge pages for large buffers, reducing the
+      // number of page faults & TLB misses on first touch & subsequent
+      // random access. This must be done before the memory is touched.
+      void use_huge_pages (uint8_t* address, size_t size)
+      {
+#ifdef MADV_HUGEPAGE
+        //CONF option: ScratchHugePages
+        //CONF default: 0 (false)
+        //CONF Whether to request transparent huge pages from the OS for
+        //CONF large scratch image buffers (Linux only). This can reduce the
+        //CONF number of page faults for large images, at the expense of
+        //CONF increased memory usage.
+        static const bool enabled = File::Config::get_bool ("ScratchHugePages", false);
+        const size_t huge_page_size = 2 * 1024 * 1024;
+        if (!enabled || size < 2*huge_page_size)
+          return;
+        // madvise() requires page alignment; only use the aligned interior:
+        uint8_t* first = reinterpret_cast<uint8_t*> ((reinterpret_cast<uintptr_t> (address) + huge_page_size - 1) & ~uintptr_t (huge_page_size - 1));
+        const size_t length = ((address + size - first) / huge_page_size) * huge_page_size;
+        if (madvise (first, length, MADV_HUGEPAGE))
+          DEBUG ("unable to request huge pages for scratch buffer: " + std::string (strerror (errno)));
+#endif
+      }
+
+    }
+
+
+
     bool Scratch::is_file_backed () const { return false; }
 
     void Scratch::load (const Header& header, size_t buffer_size)
@@ -32,6 +67,7 @@ namespace MR
       DEBUG ("allocating scratch buffer for image \"" + header.name() + "\"...");
       try {
         addresses.push_back (std::unique_ptr<uint8_t[]> (new uint8_t [buffer_size]));
+        use_huge_pages (addresses[0].get(), buffer_size);
         memset (addresses[0].get(), 0, buffer_size);
       } catch (...) {
         throw Exception ("Error allocating memory for scratch buffer");
@@ -17,6 +17,8 @@
 #ifndef __interp_base_h__
 #define __interp_base_h__
 
+#include <type_traits>
+
 #include "image_helpers.h"
 #include "transform.h"
 
@@ -32,6 +34,22 @@ namespace MR
     //! \addtogroup interp
     // @{
 
+    //! whether \a ImageType may provide direct access to its voxel values in RAM
+    /*! This is the case for Image objects (though whether direct access is
+     * actually available must be checked at runtime using is_direct_io()),
+     * but not for adapters. */
+    template <class ImageType>
+      class has_direct_io { NOMEMALIGN
+        template <class T>
+          static auto test (int) -> decltype (std::declval<const T&>().is_direct_io(), std::declval<const T&>().address(), std::true_type());
+        template <class>
+          static std::false_type test (...);
+        public:
+          static constexpr bool value = decltype (test<ImageType> (0))::value &&
+            !std::is_same<typename ImageType::value_type, bool>::value;
+      };
+
+
     //! This class defines the interface for classes that perform image interpolation
     /*! Interpolation is generally performed along the first 3 (spatial) axes;
      * the (integer) position along the remaining axes should be set using the
@@ -214,6 +232,117 @@ namespace MR
           return Eigen::Vector3d (pos[0]-std::floor (pos[0]), pos[1]-std::floor (pos[1]), pos[2]-std::floor (pos[2]));
         }
 
+        ssize_t clamp (ssize_t x, ssize_t dim) const {
+          if (x < 0) return 0;
+          if (x >= dim) return (dim-1);
+          return x;
+        }
+
+        //! get the values of the N x N x N neighbourhood whose lowest corner is voxel \a c
+        /*! Voxels are ordered with the x index varying fastest, and indices
+         * beyond the extent of the image are clamped to its edges. For images
+         * held in RAM with direct access, the memory offsets of all neighbours
+         * are computed once from the image strides, rather than setting the
+         * image indices and fetching each value in turn. Otherwise, note that
+         * the spatial indices of the image are modified. */
+        template <int N, class VectorType>
+        FORCE_INLINE void get_neighbourhood (const ssize_t* c, VectorType& values) {
+          get_neighbourhood<N> (c, values, std::integral_constant<bool, has_direct_io<ImageType>::value>());
+        }
+
+        //! get the rows along \a axis of the N x N x N neighbourhood whose lowest corner is voxel \a c
+        /*! This is equivalent to get_neighbourhood(), with each neighbour
+         * providing a column of \a values, holding all of its values along
+         * \a axis (typically the volume axis). */
+        template <int N, class MatrixType>
+        FORCE_INLINE void get_neighbourhood_rows (const ssize_t* c, size_t axis, MatrixType& values) {
+          get_neighbourhood_rows<N> (c, axis, values, std::integral_constant<bool, has_direct_io<ImageType>::value>());
+        }
+
+      private:
+        template <int N, class VectorType>
+        void get_neighbourhood (const ssize_t* c, VectorType& values, std::false_type) {
+          size_t i (0);
+          for (ssize_t z = 0; z < N; ++z) {
+            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
+            for (ssize_t y = 0; y < N; ++y) {
+              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
+              for (ssize_t x = 0; x < N; ++x) {
+                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
+                values[i++] = ImageType::value ();
+              }
+            }
+          }
+        }
+
+        template <int N, class MatrixType>
+        void get_neighbourhood_rows (const ssize_t* c, size_t axis, MatrixType& values, std::false_type) {
+          size_t i (0);
+          for (ssize_t z = 0; z < N; ++z) {
+            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
+            for (ssize_t y = 0; y < N; ++y) {
+              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
+              for (ssize_t x = 0; x < N; ++x) {
+                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
+                values.col (i++) = ImageType::row (axis);
+              }
+            }
+          }
+        }
+
+        template <int N, class VectorType>
+        void get_neighbourhood (const ssize_t* c, VectorType& values, std::true_type) {
+          if (!ImageType::is_direct_io())
+            return get_neighbourhood<N> (c, values, std::false_type());
+
+          ssize_t offsets[3][N];
+          const value_type* origin = neighbourhood_offsets<N> (c, offsets);
+          size_t i (0);
+          for (ssize_t z = 0; z < N; ++z)
+            for (ssize_t y = 0; y < N; ++y) {
+              const value_type* p = origin + offsets[1][y] + offsets[2][z];
+              for (ssize_t x = 0; x < N; ++x)
+                values[i++] = p[offsets[0][x]];
+            }
+        }
+
+        template <int N, class MatrixType>
+        void get_neighbourhood_rows (const ssize_t* c, size_t axis, MatrixType& values, std::true_type) {
+          if (!ImageType::is_direct_io())
+            return get_neighbourhood_rows<N> (c, axis, values, std::false_type());
+
+          ssize_t offsets[3][N];
+          const value_type* origin = neighbourhood_offsets<N> (c, offsets) - ImageType::get_index (axis) * ImageType::stride (axis);
+          const ssize_t size = ImageType::size (axis);
+          const ssize_t stride = ImageType::stride (axis);
+          size_t i (0);
+          for (ssize_t z = 0; z < N; ++z)
+            for (ssize_t y = 0; y < N; ++y)
+              for (ssize_t x = 0; x < N; ++x) {
+                const value_type* p = origin + offsets[0][x] + offsets[1][y] + offsets[2][z];
+                if (stride == 1)
+                  values.col (i++) = Eigen::Map<const Eigen::Matrix<value_type, Eigen::Dynamic, 1>> (p, size);
+                else {
+                  for (ssize_t n = 0; n < size; ++n)
+                    values (n, i) = p[n*stride];
+                  ++i;
+                }
+              }
+        }
+
+        // compute the offsets of the neighbourhood along each spatial axis,
+        // and return the address of the voxel at the spatial origin:
+        template <int N>
+        const value_type* neighbourhood_offsets (const ssize_t* c, ssize_t (&offsets)[3][N]) {
+          const value_type* origin = ImageType::address();
+          for (size_t axis = 0; axis < 3; ++axis) {
+            origin -= ImageType::get_index (axis) * ImageType::stride (axis);
+            for (ssize_t n = 0; n < N; ++n)
+              offsets[axis][n] = clamp (c[axis] + n, ImageType::size (axis)) * ImageType::stride (axis);
+          }
+          return origin;
+        }
+
     };
 
 
@@ -81,12 +81,6 @@ namespace MR
       protected:
         SplineType H[3];
         Eigen::Vector3d P;
-
-        ssize_t clamp (ssize_t x, ssize_t dim) const {
-          if (x < 0) return 0;
-          if (x >= dim) return (dim-1);
-          return x;
-        }
     };
 
 
@@ -110,7 +104,6 @@ namespace MR
         using value_type = typename SplineBase::value_type;
         using SplineBase::P;
         using SplineBase::H;
-        using SplineBase::clamp;
 
         SplineInterp (const ImageType& parent, value_type value_when_out_of_bounds = SplineBase::default_out_of_bounds_value()) :
             SplineInterpBase <ImageType, SplineType, Math::SplineProcessingType::Value> (parent, value_when_out_of_bounds)
@@ -164,17 +157,7 @@ namespace MR
 
           Eigen::Matrix<value_type, 64, 1> coeff_vec;
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 4; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 4; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 4; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_vec[i++] = ImageType::value ();
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood<4> (c, coeff_vec);
 
           return coeff_vec.dot (weights_vec);
         }
@@ -193,17 +176,7 @@ namespace MR
 
           Eigen::Matrix<value_type, Eigen::Dynamic, 64> coeff_matrix ( ImageType::size(3), 64 );
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 4; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 4; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 4; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_matrix.col (i++) = ImageType::row (axis);
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood_rows<4> (c, axis, coeff_matrix);
 
           return coeff_matrix * weights_vec;
         }
@@ -225,7 +198,6 @@ namespace MR
         using value_type = typename SplineBase::value_type;
         using SplineBase::P;
         using SplineBase::H;
-        using SplineBase::clamp;
 
         SplineInterp (const ImageType& parent, value_type value_when_out_of_bounds = SplineBase::default_out_of_bounds_value()) :
             SplineInterpBase <ImageType, SplineType, Math::SplineProcessingType::Derivative> (parent, value_when_out_of_bounds),
@@ -294,17 +266,7 @@ namespace MR
 
           Eigen::Matrix<value_type, 1, 64> coeff_vec;
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 4; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 4; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 4; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_vec[i++] = ImageType::value ();
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood<4> (c, coeff_vec);
 
           return coeff_vec * weights_matrix;
         }
@@ -327,17 +289,7 @@ namespace MR
 
           Eigen::Matrix<value_type, Eigen::Dynamic, 64> coeff_matrix (ImageType::size(3), 64);
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 4; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 4; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 4; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_matrix.col (i++) = ImageType::row (3);
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood_rows<4> (c, 3, coeff_matrix);
 
           return coeff_matrix * weights_matrix;
         }
@@ -371,7 +323,6 @@ namespace MR
         using value_type = typename SplineBase::value_type;
         using SplineBase::P;
         using SplineBase::H;
-        using SplineBase::clamp;
 
         SplineInterp (const ImageType& parent, value_type value_when_out_of_bounds = SplineBase::default_out_of_bounds_value()) :
             SplineInterpBase <ImageType, SplineType, Math::SplineProcessingType::ValueAndDerivative> (parent, value_when_out_of_bounds),
@@ -446,17 +397,7 @@ namespace MR
 
           Eigen::Matrix<value_type, 1, 64> coeff_vec;
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 4; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 4; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 4; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_vec[i++] = ImageType::value ();
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood<4> (c, coeff_vec);
           Eigen::Matrix<value_type, 1, 4> grad_and_value (coeff_vec * weights_matrix);
 
           gradient = grad_and_value.head(3);
@@ -484,17 +425,7 @@ namespace MR
 
           Eigen::Matrix<value_type, Eigen::Dynamic, 64> coeff_matrix (ImageType::size(3), 64);
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 4; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 4; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 4; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_matrix.col (i++) = ImageType::row (3);
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood_rows<4> (c, 3, coeff_matrix);
           Eigen::Matrix<value_type, Eigen::Dynamic, 4> grad_and_value (coeff_matrix * weights_matrix);
           gradient = grad_and_value.block(0,0,ImageType::size(3),3);
           value = grad_and_value.col(3);
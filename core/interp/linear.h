@@ -108,12 +108,6 @@ namespace MR
       protected:
         const coef_type zero, eps;
         Eigen::Vector3d P;
-
-        ssize_t clamp (ssize_t x, ssize_t dim) const {
-          if (x < 0) return 0;
-          if (x >= dim) return (dim-1);
-          return x;
-        }
     };
 
 
@@ -136,7 +130,6 @@ namespace MR
         using value_type = typename LinearBase::value_type;
         using coef_type = typename LinearBase::coef_type;
         using LinearBase::P;
-        using LinearBase::clamp;
         using LinearBase::bounds;
         using LinearBase::eps;
 
@@ -201,17 +194,7 @@ namespace MR
 
           Eigen::Matrix<value_type, 8, 1> coeff_vec;
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 2; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 2; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 2; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_vec[i++] = ImageType::value ();
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood<2> (c, coeff_vec);
 
           return coeff_vec.dot (factors);
         }
@@ -219,34 +202,36 @@ namespace MR
         //! Read interpolated values from volumes along axis >= 3
         /*! See file interp/base.h for details. */
         Eigen::Matrix<value_type, Eigen::Dynamic, 1> row (size_t axis) {
+          Eigen::Matrix<value_type, Eigen::Dynamic, 1> values (ImageType::size(axis));
+          row (axis, values);
+          return values;
+        }
+
+        //! Read interpolated values from volumes along axis >= 3 into \a values
+        /*! As row(), but writing into \a values (which must already hold
+         * ImageType::size(axis) elements), and re-using the same storage for
+         * the neighbourhood on every call, so that no memory is allocated.
+         * This is preferable when interpolating many rows in turn, as in
+         * tractography. */
+        template <class VectorType>
+        void row (size_t axis, VectorType& values) {
           if (Base<ImageType>::out_of_bounds) {
-            Eigen::Matrix<value_type, Eigen::Dynamic, 1> out_of_bounds_row (ImageType::size(axis));
-            out_of_bounds_row.setOnes();
-            out_of_bounds_row *= Base<ImageType>::out_of_bounds_value;
-            return out_of_bounds_row;
+            values.setConstant (Base<ImageType>::out_of_bounds_value);
+            return;
           }
 
           ssize_t c[] = { ssize_t (std::floor (P[0])), ssize_t (std::floor (P[1])), ssize_t (std::floor (P[2])) };
 
-          Eigen::Matrix<value_type, Eigen::Dynamic, 8> coeff_matrix ( ImageType::size(3), 8 );
+          coeff_matrix.resize (ImageType::size(axis), 8);
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 2; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 2; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 2; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_matrix.col (i++) = ImageType::row (axis);
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood_rows<2> (c, axis, coeff_matrix);
 
-          return coeff_matrix * factors;
+          values.noalias() = coeff_matrix * factors;
         }
 
       protected:
         Eigen::Matrix<coef_type, 8, 1> factors;
+        Eigen::Matrix<value_type, Eigen::Dynamic, 8> coeff_matrix;
     };
 
 
@@ -262,7 +247,6 @@ namespace MR
         using value_type = typename LinearBase::value_type;
         using coef_type = typename LinearBase::coef_type;
         using LinearBase::P;
-        using LinearBase::clamp;
         using LinearBase::bounds;
         using LinearBase::voxelsize;
 
@@ -336,17 +320,7 @@ namespace MR
 
           Eigen::Matrix<coef_type, 1, 8> coeff_vec;
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 2; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 2; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 2; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_vec[i++] = ImageType::value ();
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood<2> (c, coeff_vec);
 
           return coeff_vec * weights_matrix;
         }
@@ -371,17 +345,7 @@ namespace MR
 
           Eigen::Matrix<value_type, Eigen::Dynamic, 8> coeff_matrix (ImageType::size(3), 8);
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 2; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 2; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 2; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_matrix.col (i++) = ImageType::row (3);
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood_rows<2> (c, 3, coeff_matrix);
 
           return coeff_matrix * weights_matrix;
         }
@@ -411,7 +375,6 @@ namespace MR
         using value_type = typename LinearBase::value_type;
         using coef_type = typename LinearBase::coef_type;
         using LinearBase::P;
-        using LinearBase::clamp;
         using LinearBase::bounds;
         using LinearBase::voxelsize;
 
@@ -502,18 +465,7 @@ namespace MR
 
           Eigen::Matrix<value_type, 1, 8> coeff_vec;
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 2; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 2; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 2; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_vec[i] = ImageType::value ();
-                ++i;
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood<2> (c, coeff_vec);
 
           Eigen::Matrix<value_type, 1, 4> grad_and_value (coeff_vec * weights_matrix);
 
@@ -545,17 +497,7 @@ namespace MR
 
           Eigen::Matrix<value_type, Eigen::Dynamic, 8> coeff_matrix (ImageType::size(3), 8);
 
-          size_t i(0);
-          for (ssize_t z = 0; z < 2; ++z) {
-            ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
-            for (ssize_t y = 0; y < 2; ++y) {
-              ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
-              for (ssize_t x = 0; x < 2; ++x) {
-                ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
-                coeff_matrix.col (i++) = ImageType::row (3);
-              }
-            }
-          }
+          Base<ImageType>::template get_neighbourhood_rows<2> (c, 3, coeff_matrix);
 
           Eigen::Matrix<value_type, Eigen::Dynamic, 4> grad_and_value (coeff_matrix * weights_matrix);
           gradient = grad_and_value.block(0, 0, ImageType::size(3), 3);
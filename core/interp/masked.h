@@ -64,7 +64,7 @@ namespace MR
           InterpType::image_type::index(0) = std::round (pos[0]);
           InterpType::image_type::index(1) = std::round (pos[1]);
           InterpType::image_type::index(2) = std::round (pos[2]);
-          for (auto l_inner = Loop(*this, 3) (*this); l_inner; ++l_inner) {
+          for (auto l_inner = Loop (3, InterpType::image_type::ndim()) (*this); l_inner; ++l_inner) {
             if (InterpType::image_type::value())
               return InterpType::voxel (pos);
           }
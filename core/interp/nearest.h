@@ -125,6 +125,23 @@ namespace MR
           return ImageType::row(axis);
         }
 
+        //! Read interpolated values from volumes along axis >= 3 into \a values
+        /*! As row(), but writing into \a values (which must already hold
+         * ImageType::size(axis) elements), so that no memory is allocated. */
+        template <class VectorType>
+        void row (size_t axis, VectorType& values) {
+          assert (axis > 2);
+          assert (axis < ImageType::ndim());
+          if (out_of_bounds) {
+            values.setConstant (out_of_bounds_value);
+            return;
+          }
+          const ssize_t index = ImageType::index (axis);
+          for (ImageType::index (axis) = 0; ImageType::index (axis) < ImageType::size (axis); ++ImageType::index (axis))
+            values[ImageType::index (axis)] = ImageType::value();
+          ImageType::index (axis) = index;
+        }
+
     };
 
 
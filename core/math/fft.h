@@ -0,0 +1,167 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#ifndef __math_fft_h__
+#define __math_fft_h__
+
+#include <algorithm>
+#include <complex>
+#include <type_traits>
+
+#include <unsupported/Eigen/FFT>
+
+#include "types.h"
+
+
+namespace MR
+{
+  namespace Math
+  {
+
+    //! Perform 1D complex FFTs along each of the columns of a matrix
+    /*! The columns are transformed one at a time, reusing the same FFT plans
+     * and line buffers for all columns & all subsequent calls (Eigen::FFT
+     * provides no strided or batched plans that would transform them all at
+     * once). To transform the rows of a matrix, pass its transpose().
+     *
+     * When transforming from one matrix into another, the columns of both are
+     * passed directly to the FFT implementation if they are contiguous in
+     * memory, without any intermediate copies. Otherwise (e.g. for rows), each
+     * line is gathered into & scattered from a preallocated contiguous buffer.
+     * The versions of forward() & inverse() taking a single matrix overwrite
+     * it with the result, but always go through these buffers, since the
+     * FFT implementation is not guaranteed to support in-place operation.
+     *
+     * As for Eigen::FFT, the inverse transform is scaled by 1/N.
+     *
+     * Note that the creation of FFT plans is not thread-safe for all FFT
+     * backends (notably FFTW): each thread should use its own ColumnFFT
+     * object, and invoke prepare() for all transform lengths it will need
+     * before processing starts. Copies of a ColumnFFT create their own plans
+     * for the same transform lengths as the original. */
+    template <typename ValueType = double>
+      class ColumnFFT { MEMALIGN (ColumnFFT<ValueType>)
+        public:
+          using value_type = ValueType;
+          using complex_type = std::complex<ValueType>;
+          using vector_type = Eigen::Matrix<complex_type, Eigen::Dynamic, 1>;
+
+          ColumnFFT () { }
+          ColumnFFT (const ColumnFFT& other) : ColumnFFT () {
+            for (auto length : other.lengths)
+              prepare (length);
+          }
+          ColumnFFT& operator= (const ColumnFFT&) = delete;
+
+          //! create the plans & buffers for transforms of \a length
+          void prepare (ssize_t length) {
+            if (std::find (lengths.begin(), lengths.end(), length) != lengths.end())
+              return;
+            lengths.push_back (length);
+            if (line_in.size() < length) {
+              line_in.resize (length);
+              line_out.resize (length);
+            }
+            line_in.head (length).setZero();
+            fft.fwd (line_out.data(), line_in.data(), length);
+            fft.inv (line_out.data(), line_in.data(), length);
+          }
+
+          //! transform the columns of \a in into the columns of \a out
+          template <class InputType, class OutputType>
+            void forward (const Eigen::MatrixBase<InputType>& in, Eigen::MatrixBase<OutputType>&& out) { transform (in, out, false); }
+          template <class InputType, class OutputType>
+            void forward (const Eigen::MatrixBase<InputType>& in, Eigen::MatrixBase<OutputType>& out) { transform (in, out, false); }
+          template <class InputType, class OutputType>
+            void inverse (const Eigen::MatrixBase<InputType>& in, Eigen::MatrixBase<OutputType>&& out) { transform (in, out, true); }
+          template <class InputType, class OutputType>
+            void inverse (const Eigen::MatrixBase<InputType>& in, Eigen::MatrixBase<OutputType>& out) { transform (in, out, true); }
+
+          //! transform the columns of \a data, overwriting them with the result
+          template <class DataType>
+            void forward (Eigen::MatrixBase<DataType>&& data) { transform_overwrite (data, false); }
+          template <class DataType>
+            void forward (Eigen::MatrixBase<DataType>& data) { transform_overwrite (data, false); }
+          template <class DataType>
+            void inverse (Eigen::MatrixBase<DataType>&& data) { transform_overwrite (data, true); }
+          template <class DataType>
+            void inverse (Eigen::MatrixBase<DataType>& data) { transform_overwrite (data, true); }
+
+        protected:
+          Eigen::FFT<ValueType> fft;
+          vector<ssize_t> lengths;
+          vector_type line_in, line_out;
+
+          FORCE_INLINE void transform_line (complex_type* out, const complex_type* in, ssize_t length, bool inverse) {
+            if (inverse)
+              fft.inv (out, in, length);
+            else
+              fft.fwd (out, in, length);
+          }
+
+          // the address of column n if contiguous in memory, nullptr otherwise:
+          template <class MatrixType>
+            static complex_type* column (const Eigen::MatrixBase<MatrixType>& m, ssize_t n, std::true_type) {
+              return m.innerStride() == 1 ? const_cast<complex_type*> (m.derived().data()) + n * m.outerStride() : nullptr;
+            }
+          template <class MatrixType>
+            static complex_type* column (const Eigen::MatrixBase<MatrixType>&, ssize_t, std::false_type) {
+              return nullptr;
+            }
+          template <class MatrixType>
+            using has_contiguous_columns = std::integral_constant<bool,
+                  (MatrixType::Flags & Eigen::DirectAccessBit) && !MatrixType::IsRowMajor>;
+
+          template <class InputType, class OutputType>
+            void transform (const Eigen::MatrixBase<InputType>& in, Eigen::MatrixBase<OutputType>& out, bool inverse)
+            {
+              assert (in.rows() == out.rows() && in.cols() == out.cols());
+              const ssize_t length = in.rows();
+              prepare (length);
+              for (ssize_t n = 0; n < in.cols(); ++n) {
+                const complex_type* in_line = column (in, n, has_contiguous_columns<InputType>());
+                if (!in_line) {
+                  line_in.head (length) = in.col (n);
+                  in_line = line_in.data();
+                }
+                complex_type* out_line = column (out, n, has_contiguous_columns<OutputType>());
+                if (out_line)
+                  transform_line (out_line, in_line, length, inverse);
+                else {
+                  transform_line (line_out.data(), in_line, length, inverse);
+                  out.col (n) = line_out.head (length);
+                }
+              }
+            }
+
+          template <class DataType>
+            void transform_overwrite (Eigen::MatrixBase<DataType>& data, bool inverse)
+            {
+              const ssize_t length = data.rows();
+              prepare (length);
+              for (ssize_t n = 0; n < data.cols(); ++n) {
+                line_in.head (length) = data.col (n);
+                transform_line (line_out.data(), line_in.data(), length, inverse);
+                data.col (n) = line_out.head (length);
+              }
+            }
+      };
+
+  }
+}
+
+#endif
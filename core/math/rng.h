@@ -54,10 +54,19 @@ namespace MR
         static std::mt19937::result_type get_seed () {
           static std::mutex mutex;
           std::lock_guard<std::mutex> lock (mutex);
-          static std::mt19937::result_type current_seed = get_seed_private();
+          static std::mt19937::result_type current_seed = base_seed();
           return current_seed++;
         }
 
+        //! the seed from which those of all instances are derived
+        /*! this is the value of the MRTRIX_RNG_SEED environment variable if
+         * set, or a random value otherwise; it remains fixed for the
+         * lifetime of the application. */
+        static std::mt19937::result_type base_seed () {
+          static const std::mt19937::result_type seed = get_seed_private();
+          return seed;
+        }
+
       private:
         static std::mt19937::result_type get_seed_private () {
           //ENVVAR name: MRTRIX_RNG_SEED
@@ -553,6 +553,41 @@ namespace MR
 
 
 
+        void TestBase::operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& output) const
+        {
+          vector<matrix_type> temp;
+          (*this) (shuffling_matrices, temp, output);
+        }
+
+
+
+        void TestBase::operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& stats, vector<matrix_type>& zstats) const
+        {
+          stats.resize (shuffling_matrices.size());
+          zstats.resize (shuffling_matrices.size());
+          for (size_t is = 0; is != shuffling_matrices.size(); ++is)
+            (*this) (shuffling_matrices[is], stats[is], zstats[is]);
+        }
+
+
+
+        namespace
+        {
+          // When processing a batch of shuffles, the data are processed in
+          //   chunks of elements, such that the intermediate matrices do not
+          //   exceed (approximately) this number of entries; this depends only
+          //   on the number of inputs, so that the statistics computed for a
+          //   given shuffle do not depend on the composition of its batch
+          constexpr size_t chunk_max_entries = 1048576;
+
+          size_t chunk_num_elements (const size_t num_inputs)
+          {
+            return std::max (chunk_max_entries / num_inputs, size_t(1));
+          }
+        }
+
+
+
 
 
 
@@ -584,77 +619,91 @@ namespace MR
                                                 matrix_type& stats,
                                                 matrix_type& zstats) const
         {
-          assert (size_t(shuffling_matrix.rows()) == num_inputs());
-          stats .resize (num_elements(), num_hypotheses());
-          zstats.resize (num_elements(), num_hypotheses());
+          vector<matrix_type> batch_stats, batch_zstats;
+          (*this) (vector<matrix_type> (1, shuffling_matrix), batch_stats, batch_zstats);
+          stats = std::move (batch_stats[0]);
+          zstats = std::move (batch_zstats[0]);
+        }
+
+
+
+        void TestFixedHomoscedastic::operator() (const vector<matrix_type>& shuffling_matrices,
+                                                vector<matrix_type>& stats,
+                                                vector<matrix_type>& zstats) const
+        {
+          const size_t num_shuffles = shuffling_matrices.size();
+          stats .resize (num_shuffles);
+          zstats.resize (num_shuffles);
+          for (size_t is = 0; is != num_shuffles; ++is) {
+            assert (size_t(shuffling_matrices[is].rows()) == num_inputs());
+            stats [is].resize (num_elements(), num_hypotheses());
+            zstats[is].resize (num_elements(), num_hypotheses());
+          }
+          const size_t chunk_size = chunk_num_elements (num_inputs());
 
-          matrix_type Sy, lambdas, residuals, beta;
-          vector_type sse;
+          vector<matrix_type> SCpinvM (num_shuffles), SRm (num_shuffles);
+          matrix_type Rzy, betas, XtX_betas;
+          vector_type numerators, sse;
 
           // Freedman-Lane for fixed design matrix case
           // Each hypothesis needs to be handled explicitly on its own
           for (size_t ih = 0; ih != c.size(); ++ih) {
 
-            // First, we perform permutation of the input data
             // In Freedman-Lane, the initial 'effective' regression against the nuisance
-            //   variables, and permutation of the data, are done in a single step
-#ifdef GLM_TEST_DEBUG
-            VAR (shuffling_matrix.rows());
-            VAR (shuffling_matrix.cols());
-            VAR (partitions[ih].Rz.rows());
-            VAR (partitions[ih].Rz.cols());
-            VAR (y.rows());
-            VAR (y.cols());
-#endif
-            Sy.noalias() = shuffling_matrix * partitions[ih].Rz * y;
-#ifdef GLM_TEST_DEBUG
-            VAR (Sy.rows());
-            VAR (Sy.cols());
-            VAR (pinvM.rows());
-            VAR (pinvM.cols());
-#endif
-            // Now, we regress this shuffled data against the full model
-            lambdas.noalias() = pinvM * Sy;
+            //   variables, and permutation of the data, are done in a single step;
+            //   here the permutation is instead folded into the (small) matrices that
+            //   subsequently regress the data against the full model, such that the
+            //   regression against the nuisance variables is shared by the whole batch
+            const matrix_type CpinvM = c[ih].matrix() * pinvM;
+            for (size_t is = 0; is != num_shuffles; ++is) {
+              SCpinvM[is].noalias() = CpinvM * shuffling_matrices[is];
+              SRm[is].noalias() = Rm * shuffling_matrices[is];
+            }
 #ifdef GLM_TEST_DEBUG
-            VAR (lambdas.rows());
-            VAR (lambdas.cols());
-            //VAR (matrix_type(c[ih]).rows());
-            //VAR (matrix_type(c[ih]).cols());
-            VAR (Rm.rows());
-            VAR (Rm.cols());
+            VAR (CpinvM.rows());
+            VAR (CpinvM.cols());
             VAR (XtX[ih].rows());
             VAR (XtX[ih].cols());
-            VAR (one_over_dof);
 #endif
             const size_t dof = num_inputs() - partitions[ih].rank_x - partitions[ih].rank_z;
             const default_type one_over_dof = 1.0 / default_type(dof);
-            sse = (Rm*Sy).colwise().squaredNorm();
+
+            for (size_t first = 0; first < num_elements(); first += chunk_size) {
+              const size_t count = std::min (chunk_size, num_elements() - first);
+              Rzy.noalias() = partitions[ih].Rz * y.middleCols (first, count);
+
+              for (size_t is = 0; is != num_shuffles; ++is) {
+                betas.noalias() = SCpinvM[is] * Rzy;
+                XtX_betas.noalias() = XtX[ih] * betas;
+                numerators = betas.cwiseProduct (XtX_betas).colwise().sum();
+                sse = (SRm[is] * Rzy).colwise().squaredNorm();
 #ifdef GLM_TEST_DEBUG
-            VAR (dof);
-            VAR (one_over_dof);
-            VAR (sse.size());
+                VAR (dof);
+                VAR (one_over_dof);
+                VAR (sse.size());
 #endif
-            for (size_t ie = 0; ie != num_elements(); ++ie) {
-              beta.noalias() = c[ih].matrix() * lambdas.col (ie);
-              const default_type F = ((beta.transpose() * XtX[ih] * beta) (0,0) / c[ih].rank()) /
-                                     (one_over_dof * sse[ie]);
-              if (!std::isfinite (F)) {
-                stats  (ie, ih) = zstats (ie, ih) = value_type(0);
-              } else if (c[ih].is_F()) {
-                stats  (ie, ih) = F;
+                for (size_t i = 0; i != count; ++i) {
+                  const size_t ie = first + i;
+                  const default_type F = (numerators[i] / c[ih].rank()) / (one_over_dof * sse[i]);
+                  if (!std::isfinite (F)) {
+                    stats[is] (ie, ih) = zstats[is] (ie, ih) = value_type(0);
+                  } else if (c[ih].is_F()) {
+                    stats[is] (ie, ih) = F;
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-                zstats (ie, ih) = stat2z->F2z (F, c[ih].rank(), dof);
+                    zstats[is] (ie, ih) = stat2z->F2z (F, c[ih].rank(), dof);
 #else
-                zstats (ie, ih) = Math::F2z (F, c[ih].rank(), dof);
+                    zstats[is] (ie, ih) = Math::F2z (F, c[ih].rank(), dof);
 #endif
-              } else {
-                assert (beta.rows() == 1);
-                stats  (ie, ih) = std::sqrt (F) * (beta.sum() > 0.0 ? 1.0 : -1.0);
+                  } else {
+                    assert (betas.rows() == 1);
+                    stats[is] (ie, ih) = std::sqrt (F) * (betas (0, i) > 0.0 ? 1.0 : -1.0);
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-                zstats (ie, ih) = stat2z->t2z (stats (ie, ih), dof);
+                    zstats[is] (ie, ih) = stat2z->t2z (stats[is] (ie, ih), dof);
 #else
-                zstats (ie, ih) = Math::t2z (stats (ie, ih), dof);
+                    zstats[is] (ie, ih) = Math::t2z (stats[is] (ie, ih), dof);
 #endif
+                  }
+                }
               }
             }
 
@@ -707,109 +756,132 @@ namespace MR
 
         void TestFixedHeteroscedastic::operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const
         {
-          assert (size_t(shuffling_matrix.rows()) == num_inputs());
-          stats.resize (num_elements(), num_hypotheses());
-          zstats.resize (num_elements(), num_hypotheses());
+          vector<matrix_type> batch_stats, batch_zstats;
+          (*this) (vector<matrix_type> (1, shuffling_matrix), batch_stats, batch_zstats);
+          stats = std::move (batch_stats[0]);
+          zstats = std::move (batch_zstats[0]);
+        }
+
+
 
-          matrix_type Sy, lambdas;
+        void TestFixedHeteroscedastic::operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& stats, vector<matrix_type>& zstats) const
+        {
+          const size_t num_shuffles = shuffling_matrices.size();
+          stats.resize (num_shuffles);
+          zstats.resize (num_shuffles);
+          for (size_t is = 0; is != num_shuffles; ++is) {
+            assert (size_t(shuffling_matrices[is].rows()) == num_inputs());
+            stats[is].resize (num_elements(), num_hypotheses());
+            zstats[is].resize (num_elements(), num_hypotheses());
+          }
+          const size_t chunk_size = chunk_num_elements (num_inputs());
+
+          vector<matrix_type> SpinvM (num_shuffles), SRm (num_shuffles);
+          matrix_type Rzy, lambdas;
           Eigen::Array<default_type, Eigen::Dynamic, Eigen::Dynamic> sq_residuals, sse, Wterms;
           Eigen::Matrix<default_type, Eigen::Dynamic, 1> W (num_inputs());
-#ifdef GLM_TEST_DEBUG
-          VAR (shuffling_matrix);
-#endif
 
           for (size_t ih = 0; ih != c.size(); ++ih) {
             // First two steps are identical to the homoscedastic case
-            Sy.noalias() = shuffling_matrix * partitions[ih].Rz * y;
-#ifdef GLM_TEST_DEBUG
-            VAR (Sy);
-#endif
-            lambdas.noalias() = pinvM * Sy;
+            for (size_t is = 0; is != num_shuffles; ++is) {
+              SpinvM[is].noalias() = pinvM * shuffling_matrices[is];
+              SRm[is].noalias() = Rm * shuffling_matrices[is];
+            }
+
+            for (size_t first = 0; first < num_elements(); first += chunk_size) {
+              const size_t count = std::min (chunk_size, num_elements() - first);
+              Rzy.noalias() = partitions[ih].Rz * y.middleCols (first, count);
+
+              for (size_t is = 0; is != num_shuffles; ++is) {
+                lambdas.noalias() = SpinvM[is] * Rzy;
 #ifdef GLM_TEST_DEBUG
-            VAR (lambdas);
+                VAR (lambdas);
 #endif
-            // Compute sum of residuals per VG immediately
-            // Variance groups appear across rows, and one column per element tested
-            // Immediately calculate squared residuals; simplifies summation over variance groups
-            sq_residuals = (Rm*Sy).array().square();
+                // Compute sum of residuals per VG immediately
+                // Variance groups appear across rows, and one column per element tested
+                // Immediately calculate squared residuals; simplifies summation over variance groups
+                sq_residuals = (SRm[is] * Rzy).array().square();
 #ifdef GLM_TEST_DEBUG
-            VAR (sq_residuals);
-            VAR (sq_residuals.rows());
-            VAR (sq_residuals.cols());
+                VAR (sq_residuals);
+                VAR (sq_residuals.rows());
+                VAR (sq_residuals.cols());
 #endif
-            sse = matrix_type::Zero (num_variance_groups(), num_elements());
-            for (size_t input = 0; input != num_inputs(); ++input)
-              sse.row(VG[input]) += sq_residuals.row(input);
+                sse = matrix_type::Zero (num_variance_groups(), count);
+                for (size_t input = 0; input != num_inputs(); ++input)
+                  sse.row(VG[input]) += sq_residuals.row(input);
 #ifdef GLM_TEST_DEBUG
-            VAR (sse);
-            VAR (sse.rows());
-            VAR (sse.cols());
+                VAR (sse);
+                VAR (sse.rows());
+                VAR (sse.cols());
 #endif
-            // These terms are what appears in the weighting matrix based on the VG to which each input belongs;
-            //   one row per variance group, one column per element to be tested
-            Wterms = sse.array().inverse().colwise() * Rnn_sums;
-            for (size_t col = 0; col != num_elements(); ++col) {
-              for (size_t row = 0; row != num_vgs; ++row) {
-                if (!std::isfinite (Wterms (row, col)))
-                  Wterms (row, col) = 0.0;
-              }
-            }
+                // These terms are what appears in the weighting matrix based on the VG to which each input belongs;
+                //   one row per variance group, one column per element to be tested
+                Wterms = sse.array().inverse().colwise() * Rnn_sums;
+                for (size_t col = 0; col != count; ++col) {
+                  for (size_t row = 0; row != num_vgs; ++row) {
+                    if (!std::isfinite (Wterms (row, col)))
+                      Wterms (row, col) = 0.0;
+                  }
+                }
 #ifdef GLM_TEST_DEBUG
-            VAR (Wterms);
-            VAR (Wterms.rows());
-            VAR (Wterms.cols());
+                VAR (Wterms);
+                VAR (Wterms.rows());
+                VAR (Wterms.cols());
 #endif
-            for (size_t ie = 0; ie != num_elements(); ++ie) {
-              // Need to construct the weights diagonal matrix; is unique for each element
-              default_type W_trace (0.0);
-              for (size_t input = 0; input != num_inputs(); ++input) {
-                W[input] = Wterms(VG[input], ie);
-                W_trace += W[input];
-              }
+                for (size_t i = 0; i != count; ++i) {
+                  const size_t ie = first + i;
+                  // Need to construct the weights diagonal matrix; is unique for each element
+                  default_type W_trace (0.0);
+                  for (size_t input = 0; input != num_inputs(); ++input) {
+                    W[input] = Wterms(VG[input], i);
+                    W_trace += W[input];
+                  }
 #ifdef GLM_TEST_DEBUG
-              VAR (W_trace);
+                  VAR (W_trace);
 #endif
-              const default_type numerator = lambdas.col (ie).transpose() * c[ih].matrix().transpose() * (c[ih].matrix() * (M.transpose() * W.asDiagonal() * M).inverse() * c[ih].matrix().transpose()).inverse() * c[ih].matrix() * lambdas.col (ie);
+                  const default_type numerator = lambdas.col (i).transpose() * c[ih].matrix().transpose() * (c[ih].matrix() * (M.transpose() * W.asDiagonal() * M).inverse() * c[ih].matrix().transpose()).inverse() * c[ih].matrix() * lambdas.col (i);
 #ifdef GLM_TEST_DEBUG
-              VAR (numerator);
+                  VAR (numerator);
 #endif
-              default_type gamma (0.0);
-              for (size_t vg_index = 0; vg_index != num_vgs; ++vg_index)
-                // Since Wnn is the same for every n in the variance group, can compute that summation as the product of:
-                //   - the value inserted in W for that particular VG
-                //   - the number of inputs that are a part of that VG
-                gamma += inv_Rnn_sums[vg_index] * Math::pow2 (1.0 - ((Wterms(vg_index, ie) * inputs_per_vg[vg_index]) / W_trace));
-              gamma = 1.0 + (gamma_weights[ih] * gamma);
+                  default_type gamma (0.0);
+                  for (size_t vg_index = 0; vg_index != num_vgs; ++vg_index)
+                    // Since Wnn is the same for every n in the variance group, can compute that summation as the product of:
+                    //   - the value inserted in W for that particular VG
+                    //   - the number of inputs that are a part of that VG
+                    gamma += inv_Rnn_sums[vg_index] * Math::pow2 (1.0 - ((Wterms(vg_index, i) * inputs_per_vg[vg_index]) / W_trace));
+                  gamma = 1.0 + (gamma_weights[ih] * gamma);
 #ifdef GLM_TEST_DEBUG
-              VAR (gamma);
+                  VAR (gamma);
 #endif
-              const default_type denominator = gamma * c[ih].rank();
-              const default_type G = numerator / denominator;
-              if (!std::isfinite (G)) {
-                stats  (ie, ih) = zstats (ie, ih) = value_type(0);
-              } else {
-                stats  (ie, ih) = c[ih].is_F() ?
-                                  G :
-                                  std::sqrt (G) * ((c[ih].matrix() * lambdas.col (ie)).sum() > 0.0 ? 1.0 : -1.0);
-                if (c[ih].is_F() && c[ih].rank() > 1) {
-                  const default_type dof = 2.0 * default_type(c[ih].rank() - 1) / (3.0 * (gamma - 1.0));
+                  const default_type denominator = gamma * c[ih].rank();
+                  const default_type G = numerator / denominator;
+                  if (!std::isfinite (G)) {
+                    stats[is] (ie, ih) = zstats[is] (ie, ih) = value_type(0);
+                  } else {
+                    stats[is] (ie, ih) = c[ih].is_F() ?
+                                         G :
+                                         std::sqrt (G) * ((c[ih].matrix() * lambdas.col (i)).sum() > 0.0 ? 1.0 : -1.0);
+                    if (c[ih].is_F() && c[ih].rank() > 1) {
+                      const default_type dof = 2.0 * default_type(c[ih].rank() - 1) / (3.0 * (gamma - 1.0));
 #ifdef GLM_TEST_DEBUG
-                  VAR (dof);
+                      VAR (dof);
 #endif
-                  zstats (ie, ih) = stat2z->F2z (G, c[ih].rank(), dof);
-                } else {
-                  const default_type dof = Math::welch_satterthwaite (Wterms.col (ie).inverse(), inputs_per_vg);
+                      zstats[is] (ie, ih) = stat2z->F2z (G, c[ih].rank(), dof);
+                    } else {
+                      const default_type dof = Math::welch_satterthwaite (Wterms.col (i).inverse(), inputs_per_vg);
 #ifdef GLM_TEST_DEBUG
-                  VAR (dof);
+                      VAR (dof);
 #endif
-                  zstats (ie, ih) = c[ih].is_F() ?
+                      zstats[is] (ie, ih) = c[ih].is_F() ?
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-                                    stat2z->G2z (G, c[ih].rank(), dof) :
-                                    stat2z->v2z (stats (ie, ih), dof);
+                                            stat2z->G2z (G, c[ih].rank(), dof) :
+                                            stat2z->v2z (stats[is] (ie, ih), dof);
 #else
-                                    Math::F2z (G, c[ih].rank(), dof) :
-                                    Math::t2z (stats (ie, ih), dof);
+                                            Math::F2z (G, c[ih].rank(), dof) :
+                                            Math::t2z (stats[is] (ie, ih), dof);
 #endif
+                    }
+                  }
                 }
               }
             }
@@ -828,6 +900,7 @@ namespace MR
 
 
 
+
         TestVariableHomoscedastic::TestVariableHomoscedastic (const vector<CohortDataImport>& importers,
                                                               const matrix_type& measurements,
                                                               const matrix_type& design,
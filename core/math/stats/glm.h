@@ -242,6 +242,22 @@ namespace MR
              */
             virtual void operator() (const matrix_type& shuffling_matrix, matrix_type& stat, matrix_type& zstat) const = 0;
 
+            /*! Compute Z-statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals, one per shuffle
+             * @param output the matrices containing the output Z-statistics (one per shuffle)
+             */
+            virtual void operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& output) const;
+
+            /*! Compute the statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals, one per shuffle
+             * @param stat the matrices containing the output statistics (one per shuffle)
+             * @param zstat the matrices containing the Z-transformed statistics (one per shuffle)
+             *
+             * The default implementation simply processes each shuffle in turn; derived
+             * classes may override this to share computations between shuffles.
+             */
+            virtual void operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& stat, vector<matrix_type>& zstat) const;
+
 
             size_t num_inputs () const { return M.rows(); }
             size_t num_elements () const { return y.cols(); }
@@ -289,6 +305,17 @@ namespace MR
              */
             void operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const override;
 
+            /*! Compute the statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals, one per shuffle
+             * @param stats the matrices containing the output statistics (one per shuffle)
+             * @param zstats the matrices containing the Z-transformed output statistics (one per shuffle)
+             *
+             * Since the design matrix is fixed, the regression of the data against
+             * the nuisance variables is computed only once for the whole batch, with
+             * each shuffle then applied to the (small) model fitting matrices.
+             */
+            void operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& stats, vector<matrix_type>& zstats) const override;
+
           protected:
             // New classes to store information relevant to Freedman-Lane implementation
             vector<Hypothesis::Partition> partitions;
@@ -335,6 +362,13 @@ namespace MR
              */
             void operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const override;
 
+            /*! Compute the statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals, one per shuffle
+             * @param stats the matrices containing the output statistics (one per shuffle)
+             * @param zstats the matrices containing the Z-transformed output statistics (one per shuffle)
+             */
+            void operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& stats, vector<matrix_type>& zstats) const override;
+
           protected:
             // Variance group assignments
             const index_array_type& VG;
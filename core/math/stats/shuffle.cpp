@@ -93,7 +93,8 @@ namespace MR
       Shuffler::Shuffler (const size_t num_rows, const bool is_nonstationarity, const std::string msg) :
           rows (num_rows),
           nshuffles (is_nonstationarity ? DEFAULT_NUMBER_SHUFFLES_NONSTATIONARITY : DEFAULT_NUMBER_SHUFFLES),
-          counter (0)
+          counter (0),
+          nbatch (1)
       {
         using namespace App;
         auto opt = get_options ("errors");
@@ -177,7 +178,9 @@ namespace MR
                           const index_array_type& eb_whole,
                           const std::string msg) :
           rows (num_rows),
-          nshuffles (num_shuffles)
+          nshuffles (num_shuffles),
+          counter (0),
+          nbatch (1)
       {
         initialise (error_types, true, is_nonstationarity, eb_within, eb_whole);
         if (msg.size())
@@ -224,6 +227,24 @@ namespace MR
 
 
 
+      bool Shuffler::operator() (ShuffleBatch& output)
+      {
+        output.index.clear();
+        output.data.resize (std::min (nbatch, nshuffles - std::min (counter, nshuffles)));
+        for (auto& data : output.data) {
+          Shuffle shuffle;
+          (*this) (shuffle);
+          output.index.push_back (shuffle.index);
+          data.swap (shuffle.data);
+        }
+        if (output.data.empty())
+          progress.reset (nullptr);
+        return output.size();
+      }
+
+
+
+
 
       void Shuffler::reset()
       {
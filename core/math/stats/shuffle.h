@@ -60,6 +60,17 @@ namespace MR
 
 
 
+      // A set of consecutive shuffles, to be processed together
+      class ShuffleBatch
+      { NOMEMALIGN
+        public:
+          vector<size_t> index;
+          vector<matrix_type> data;
+          size_t size() const { return index.size(); }
+      };
+
+
+
       class Shuffler
       { NOMEMALIGN
         public:
@@ -90,8 +101,14 @@ namespace MR
           //   generate each as it is required, based on the more compressed representations
           bool operator() (Shuffle& output);
 
+          // Generate up to batch_size() shuffles at once
+          bool operator() (ShuffleBatch& output);
+
           size_t size() const { return nshuffles; }
 
+          size_t batch_size() const { return nbatch; }
+          void set_batch_size (const size_t n) { assert (n); nbatch = n; }
+
           // Go back to the first permutation
           void reset();
 
@@ -100,7 +117,7 @@ namespace MR
           const size_t rows;
           vector<PermuteLabels> permutations;
           vector<BitSet> signflips;
-          size_t nshuffles, counter;
+          size_t nshuffles, counter, nbatch;
           std::unique_ptr<ProgressBar> progress;
 
 
@@ -233,16 +233,19 @@ namespace MR {
            void execute () {
              size_t count = 0;
              auto out = writer.placeholder();
+             __BatchSizer sizer (batch_size);
              bool stop = false;
              do {
-               out->item.resize (batch_size);
-               for (size_t n = 0; n < batch_size; ++n) {
+               sizer.restart();
+               out->item.resize (sizer);
+               for (size_t n = 0; n < out->item.size(); ++n) {
                  if (!func (out->item[n])) {
                    out->item.resize(n);
                    stop = true;
                    break;
                  }
                }
+               sizer.update (out->item.size(), out.occupancy());
                out->index = count++;
              } while (out.write() && !stop);
            }
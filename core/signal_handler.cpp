@@ -39,12 +39,19 @@ namespace MR
 
       std::vector<std::string> marked_files;
       std::atomic_flag flag = ATOMIC_FLAG_INIT;
+      // Guards marked_files against concurrent modification; kept separate from
+      //   the above, which is set permanently once a signal has been received
+      std::atomic_flag marked_files_lock = ATOMIC_FLAG_INIT;
 
       void delete_temporary_files ()
       {
+        // This may be invoked from the signal handler, interrupting a thread that
+        //   currently holds the lock; hence only wait for a limited time
+        for (size_t n = 0; n != 1000000 && marked_files_lock.test_and_set(); ++n);
         for (const auto& i : marked_files)
           std::remove (i.c_str());
         marked_files.clear();
+        marked_files_lock.clear();
       }
 
 
@@ -135,14 +142,14 @@ namespace MR
 
     void mark_file_for_deletion (const std::string& filename)
     {
-      while (!flag.test_and_set());
+      while (marked_files_lock.test_and_set());
       marked_files.push_back (filename);
-      flag.clear();
+      marked_files_lock.clear();
     }
 
     void unmark_file_for_deletion (const std::string& filename)
     {
-      while (!flag.test_and_set());
+      while (marked_files_lock.test_and_set());
       auto i = marked_files.begin();
       while (i != marked_files.end()) {
         if (*i == filename)
@@ -150,7 +157,7 @@ namespace MR
         else
           ++i;
       }
-      flag.clear();
+      marked_files_lock.clear();
     }
 
   }
@@ -92,6 +92,36 @@ namespace MR
 
 
 
+    bool queue_is_lock_free ()
+    {
+      //CONF option: ThreadQueueLockFree
+      //CONF default: 0 (false)
+      //CONF Whether to use the lock-free implementation of the queues used
+      //CONF to pass data between threads (e.g. in tckgen or tcksift). This
+      //CONF reduces contention when running with many threads, at the expense
+      //CONF of some additional CPU usage by threads waiting on the queue.
+      static const bool lock_free = File::Config::get_bool ("ThreadQueueLockFree", false);
+      return lock_free;
+    }
+
+
+    bool queue_batch_is_adaptive ()
+    {
+      //CONF option: ThreadQueueAdaptiveBatch
+      //CONF default: 0 (false)
+      //CONF Whether to adjust the number of items sent in each batch between
+      //CONF threads at runtime (e.g. in tckgen, tcksift or tck2connectome),
+      //CONF based on the measured time taken to process each item and on how
+      //CONF full the queue is. If disabled, the fixed batch size requested by
+      //CONF each command is used.
+      static const bool adaptive = File::Config::get_bool ("ThreadQueueAdaptiveBatch", false);
+      return adaptive;
+    }
+
+
+
+
+
     void (*__Backend::previous_print_func) (const std::string& msg) = nullptr;
     void (*__Backend::previous_report_to_user_func) (const std::string& msg, int type) = nullptr;
 
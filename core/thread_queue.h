@@ -17,15 +17,26 @@
 #ifndef __mrtrix_thread_queue_h__
 #define __mrtrix_thread_queue_h__
 
+#include <atomic>
+#include <cmath>
 #include <stack>
 #include <condition_variable>
 
 #include "exception.h"
 #include "memory.h"
 #include "thread.h"
+#include "timer.h"
 
 #define MRTRIX_QUEUE_DEFAULT_CAPACITY 128
 #define MRTRIX_QUEUE_DEFAULT_BATCH_SIZE 128
+// number of attempts (yielding in between) before a thread blocks
+// on a lock-free queue:
+#define MRTRIX_QUEUE_SPIN_COUNT 256
+// with adaptive batch sizing, the time taken to produce each batch (in
+// seconds) that the batch size is adjusted towards, and the maximum batch
+// size relative to that requested:
+#define MRTRIX_QUEUE_BATCH_TARGET_TIME 1.0e-3
+#define MRTRIX_QUEUE_MAX_BATCH_SCALE 16
 
 namespace MR
 {
@@ -64,12 +75,118 @@ namespace MR
         };
 
 
+
+      // bounded multi-producer multi-consumer ring buffer of pointers, based
+      // on Dmitry Vyukov's algorithm: each cell holds a sequence number
+      // indicating whether it is ready to be written or read at a given
+      // position, so that producers & consumers only ever contend on a
+      // single atomic counter each, and never on a lock.
+      // push() and pop() never block, but fail if the buffer is full or
+      // empty respectively.
+      template <class T>
+        class __MPMCRing { NOMEMALIGN
+          public:
+            __MPMCRing (size_t size) :
+              mask (round_up (size) - 1),
+              cells (new Cell [mask+1]),
+              head (0),
+              tail (0) {
+                for (size_t n = 0; n <= mask; ++n)
+                  cells[n].sequence.store (n, std::memory_order_relaxed);
+              }
+
+            bool push (T* item) {
+              size_t pos = tail.load (std::memory_order_relaxed);
+              while (true) {
+                Cell& cell (cells[pos & mask]);
+                const ssize_t diff = ssize_t (cell.sequence.load (std::memory_order_acquire)) - ssize_t (pos);
+                if (diff == 0) {
+                  if (tail.compare_exchange_weak (pos, pos+1, std::memory_order_relaxed)) {
+                    cell.item = item;
+                    cell.sequence.store (pos+1, std::memory_order_release);
+                    return true;
+                  }
+                }
+                else if (diff < 0)
+                  return false;
+                else
+                  pos = tail.load (std::memory_order_relaxed);
+              }
+            }
+
+            bool pop (T*& item) {
+              size_t pos = head.load (std::memory_order_relaxed);
+              while (true) {
+                Cell& cell (cells[pos & mask]);
+                const ssize_t diff = ssize_t (cell.sequence.load (std::memory_order_acquire)) - ssize_t (pos+1);
+                if (diff == 0) {
+                  if (head.compare_exchange_weak (pos, pos+1, std::memory_order_relaxed)) {
+                    item = cell.item;
+                    cell.sequence.store (pos+mask+1, std::memory_order_release);
+                    return true;
+                  }
+                }
+                else if (diff < 0)
+                  return false;
+                else
+                  pos = head.load (std::memory_order_relaxed);
+              }
+            }
+
+            // these are only snapshots, and may be out of date by the time
+            // they return:
+            bool empty () const {
+              const size_t pos = head.load (std::memory_order_relaxed);
+              return ssize_t (cells[pos & mask].sequence.load (std::memory_order_acquire)) - ssize_t (pos+1) < 0;
+            }
+            bool full () const {
+              const size_t pos = tail.load (std::memory_order_relaxed);
+              return ssize_t (cells[pos & mask].sequence.load (std::memory_order_acquire)) - ssize_t (pos) < 0;
+            }
+            size_t size () const {
+              return tail.load (std::memory_order_relaxed) - head.load (std::memory_order_relaxed);
+            }
+
+          private:
+            struct Cell { NOMEMALIGN
+              std::atomic<size_t> sequence;
+              T* item;
+            };
+
+            const size_t mask;
+            std::unique_ptr<Cell[]> cells;
+            // keep producer & consumer counters on separate cache lines:
+            char pad0[64];
+            std::atomic<size_t> head;
+            char pad1[64];
+            std::atomic<size_t> tail;
+            char pad2[64];
+
+            static size_t round_up (size_t size) {
+              size_t n = 2;
+              while (n < size)
+                n *= 2;
+              return n;
+            }
+        };
+
     }
 
     //! \endcond
 
 
 
+    //! whether Thread::Queue uses its lock-free backend by default
+    /*! This is determined by the ThreadQueueLockFree config file option. */
+    bool queue_is_lock_free ();
+
+    //! whether batched queues adjust their batch size at runtime
+    /*! This is determined by the ThreadQueueAdaptiveBatch config file
+     * option. \sa Thread::batch() */
+    bool queue_batch_is_adaptive ();
+
+
+
 
     /** \addtogroup thread_classes
      * @{ */
@@ -340,16 +457,32 @@ namespace MR
           * queue already contains this number of items, the thread will block until
           * at least one item has been popped.  By default, the buffer size is
           * MRTRIX_QUEUE_DEFAULT_CAPACITY items.
+          * \param lock_free whether to use the lock-free backend. This uses
+          * bounded multi-producer multi-consumer ring buffers in place of a
+          * single mutex, which greatly reduces contention when many threads
+          * access the queue. Threads waiting on the queue will first retry
+          * for a short while (yielding in between), and only then block.
+          * By default, this is determined by the ThreadQueueLockFree config
+          * file option.
           */
-         Queue (const std::string& description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY) :
+         Queue (const std::string& description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY,
+             bool lock_free = queue_is_lock_free()) :
            buffer (new T* [buffer_size]),
            front (buffer),
            back (buffer),
            capacity (buffer_size),
            writer_count (0),
            reader_count (0),
-           name (description) {
+           name (description),
+           data_waiters (0),
+           space_waiters (0) {
              assert (capacity > 0);
+             if (lock_free) {
+               ring.reset (new __MPMCRing<T> (capacity));
+               // enough space to hold all items in circulation in most
+               // cases; any excess is held in item_stack:
+               recycled.reset (new __MPMCRing<T> (2*capacity + 4*threads_to_execute()));
+             }
            }
 
          Queue (const Queue&) = delete;
@@ -414,6 +547,10 @@ namespace MR
                  FORCE_INLINE bool write () {
                    return Q.push (p);
                  }
+                 //! The fraction of the queue's capacity currently in use
+                 double occupancy () const {
+                   return Q.occupancy();
+                 }
                  FORCE_INLINE T& operator*() const throw ()   {
                    return *p;
                  }
@@ -517,7 +654,8 @@ namespace MR
            std::lock_guard<std::mutex> lock (mutex);
            std::cerr << "Thread::Queue \"" + name + "\": "
              << writer_count << " writer" << (writer_count > 1 ? "s" : "") << ", "
-             << reader_count << " reader" << (reader_count > 1 ? "s" : "") << ", items waiting: " << size() << "\n";
+             << reader_count << " reader" << (reader_count > 1 ? "s" : "") << ", items waiting: " << size()
+             << (ring ? " (lock-free)" : "") << "\n";
          }
 
 
@@ -528,11 +666,15 @@ namespace MR
          T** front;
          T** back;
          size_t capacity;
-         size_t writer_count, reader_count;
+         std::atomic<size_t> writer_count, reader_count;
          std::stack<T*,vector<T*> > item_stack;
          vector<std::unique_ptr<T>> items;
          std::string name;
 
+         // only used by the lock-free backend:
+         std::unique_ptr<__MPMCRing<T>> ring, recycled;
+         std::atomic<size_t> data_waiters, space_waiters;
+
          void register_writer ()   {
            std::lock_guard<std::mutex> lock (mutex);
            ++writer_count;
@@ -567,9 +709,18 @@ namespace MR
            return (inc (back) == front);
          }
          FORCE_INLINE size_t size () const {
+           if (ring)
+             return ring->size();
            return ( (back < front ? back+capacity : back) - front);
          }
 
+         double occupancy () {
+           if (ring)
+             return double (ring->size()) / capacity;
+           std::lock_guard<std::mutex> lock (mutex);
+           return double (size()) / capacity;
+         }
+
          FORCE_INLINE T* get_item () {
            std::lock_guard<std::mutex> lock (mutex);
            T* item (new T);
@@ -578,6 +729,8 @@ namespace MR
          }
 
          FORCE_INLINE bool push (T*& item) {
+           if (ring)
+             return push_lock_free (item);
            std::unique_lock<std::mutex> lock (mutex);
            more_space.wait (lock, [this]{ return !(full() && reader_count); });
            if (!reader_count) return false;
@@ -596,6 +749,8 @@ namespace MR
          }
 
          FORCE_INLINE bool pop (T*& item) {
+           if (ring)
+             return pop_lock_free (item);
            std::unique_lock<std::mutex> lock (mutex);
            if (item)
              item_stack.push (item);
@@ -610,11 +765,97 @@ namespace MR
          }
 
          FORCE_INLINE void recycle (T*& item) {
+           if (ring) {
+             if (item)
+               recycle_lock_free (item);
+             return;
+           }
            std::unique_lock<std::mutex> lock (mutex);
            if (item)
              item_stack.push (item);
          }
 
+
+
+         bool push_lock_free (T*& item) {
+           for (size_t n = 0; reader_count; ++n) {
+             if (ring->push (item)) {
+               wake (more_data, data_waiters);
+               item = get_recycled_item();
+               return true;
+             }
+             if (n < MRTRIX_QUEUE_SPIN_COUNT)
+               std::this_thread::yield();
+             else
+               park (more_space, space_waiters, [this]{ return !(ring->full() && reader_count); });
+           }
+           return false;
+         }
+
+         bool pop_lock_free (T*& item) {
+           if (item)
+             recycle_lock_free (item);
+           item = nullptr;
+           for (size_t n = 0; ; ++n) {
+             if (ring->pop (item)) {
+               wake (more_space, space_waiters);
+               return true;
+             }
+             // writers unregister after their last push, so the queue is
+             // only guaranteed to be drained once there are none left:
+             if (!writer_count)
+               return ring->pop (item);
+             if (n < MRTRIX_QUEUE_SPIN_COUNT)
+               std::this_thread::yield();
+             else
+               park (more_data, data_waiters, [this]{ return !(ring->empty() && writer_count); });
+           }
+         }
+
+         void recycle_lock_free (T* item) {
+           if (!recycled->push (item)) {
+             std::lock_guard<std::mutex> lock (mutex);
+             item_stack.push (item);
+           }
+         }
+
+         T* get_recycled_item () {
+           T* item;
+           if (recycled->pop (item))
+             return item;
+           std::lock_guard<std::mutex> lock (mutex);
+           if (item_stack.empty()) {
+             item = new T;
+             items.push_back (std::unique_ptr<T> (item));
+           }
+           else {
+             item = item_stack.top();
+             item_stack.pop();
+           }
+           return item;
+         }
+
+         // block until condition is met. The waiter count is incremented
+         // before the condition is checked, and checked by wake() after the
+         // queue has been modified, so that either this thread sees the
+         // change, or wake() sees this thread waiting:
+         template <class Condition>
+           void park (std::condition_variable& condition, std::atomic<size_t>& waiters, Condition&& ready) {
+             std::unique_lock<std::mutex> lock (mutex);
+             ++waiters;
+             std::atomic_thread_fence (std::memory_order_seq_cst);
+             condition.wait (lock, ready);
+             --waiters;
+           }
+
+         void wake (std::condition_variable& condition, std::atomic<size_t>& waiters) {
+           std::atomic_thread_fence (std::memory_order_seq_cst);
+           if (waiters.load (std::memory_order_relaxed)) {
+             std::lock_guard<std::mutex> lock (mutex);
+             condition.notify_one();
+           }
+         }
+
          FORCE_INLINE T** inc (T** p) const {
            ++p;
            if (p >= buffer + capacity) p = buffer;
@@ -641,6 +882,50 @@ namespace MR
 
 
 
+       // the number of items per batch, adjusted at runtime if requested:
+       // the aim is for each batch to take a fixed amount of time to
+       // produce, keeping the overhead of queue operations small for cheap
+       // items, while limiting the imbalance between threads at the end of
+       // processing for expensive ones. The target time is shortened if the
+       // queue is running low (i.e. consumers are waiting on producers), and
+       // lengthened if it is nearly full.
+       class __BatchSizer { NOMEMALIGN
+         public:
+           __BatchSizer (size_t initial_size) :
+             size (std::max (initial_size, size_t(1))),
+             max_size (MRTRIX_QUEUE_MAX_BATCH_SCALE * size),
+             adaptive (queue_batch_is_adaptive()) { }
+
+           operator size_t () const { return size; }
+
+           // invoke once a batch of num_items is complete, before pushing
+           // it onto the queue:
+           void update (size_t num_items, double queue_occupancy) {
+             if (!adaptive || !num_items)
+               return;
+             double target = MRTRIX_QUEUE_BATCH_TARGET_TIME;
+             if (queue_occupancy < 0.25)
+               target /= 4.0;
+             else if (queue_occupancy > 0.75)
+               target *= 4.0;
+             const double ideal_size = num_items * target / std::max (timer.elapsed(), 1.0e-9);
+             // geometric mean with current size to damp oscillations:
+             size = std::max (size_t(1), std::min (max_size, size_t (std::round (std::sqrt (size * ideal_size)))));
+           }
+
+           // invoke once the batch has been pushed, so that the time spent
+           // waiting on the queue is not counted:
+           void restart () { if (adaptive) timer.start(); }
+
+         protected:
+           size_t size;
+           const size_t max_size;
+           const bool adaptive;
+           Timer timer;
+       };
+
+
+
        template <class Item> struct __batch_size { NOMEMALIGN
          __batch_size (const Item&) { }
          operator size_t () const { return 0; }
@@ -723,9 +1008,11 @@ namespace MR
            bool write () {
              ++n;
              if (n >= batch_size) {
+               batch_size.update (n, out.occupancy());
                n = 0;
                if (!out.write())
                  return false;
+               batch_size.restart();
                out->resize (batch_size);
              }
              return true;
@@ -733,7 +1020,7 @@ namespace MR
            Item& value () { return (*out)[n]; }
            void flush () { if (n) { out->resize (n); out.write(); } }
            typename Type<__Batch<Item>>::write_item out;
-           const size_t batch_size;
+           __BatchSizer batch_size;
            size_t n;
          };
 
@@ -852,7 +1139,11 @@ namespace MR
      //! used to request batched processing of items
      /*! This function is used in combination with Thread::run_queue to request
       * that the items \a object be processed in batches of \a number items
-      * (defaults to MRTRIX_QUEUE_DEFAULT_BATCH_SIZE).
+      * (defaults to MRTRIX_QUEUE_DEFAULT_BATCH_SIZE). If the
+      * ThreadQueueAdaptiveBatch config file option is set, \a number is only
+      * the initial batch size, which is subsequently adjusted based on the
+      * time taken to produce each batch (up to MRTRIX_QUEUE_MAX_BATCH_SCALE
+      * times larger).
       * \sa Thread::run_queue() */
      template <class Item>
        inline __Batch<Item> batch (const Item&, size_t number = MRTRIX_QUEUE_DEFAULT_BATCH_SIZE)
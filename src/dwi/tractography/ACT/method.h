@@ -18,14 +18,12 @@
 #define __dwi_tractography_act_method_h__
 
 #include "dwi/tractography/ACT/act.h"
+#include "dwi/tractography/ACT/packed_image.h"
 #include "dwi/tractography/ACT/tissues.h"
 
 #include "dwi/tractography/tracking/shared.h"
 #include "dwi/tractography/tracking/types.h"
 
-#include "interp/linear.h"
-#include "interp/masked.h"
-
 
 #define GMWMI_NORMAL_PERTURBATION 0.001
 
@@ -49,7 +47,7 @@ namespace MR
                 sgm_depth (0),
                 seed_in_sgm (false),
                 sgm_seed_to_wm (false),
-                act_image (shared.act().voxel) { }
+                act_image (*shared.act().packed) { }
 
             ACT_Method_additions (const ACT_Method_additions& that) :
                 sgm_depth (0),
@@ -139,11 +137,7 @@ namespace MR
 
             bool fetch_tissue_data (const Eigen::Vector3f& pos)
             {
-              if (!act_image.scanner (pos)) {
-                tissue_values.reset();
-                return false;
-              }
-              return tissue_values.set (act_image);
+              return act_image.get (pos, tissue_values);
             }
 
 
@@ -158,7 +152,7 @@ namespace MR
 
 
           private:
-            Interp::Masked<Interp::Linear<Image<float>>> act_image;
+            const PackedImage& act_image;
             Tissues tissue_values;
 
         };
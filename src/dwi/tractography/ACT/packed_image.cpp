@@ -0,0 +1,61 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#include "algo/loop.h"
+#include "dwi/tractography/ACT/packed_image.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace ACT
+      {
+
+
+        constexpr float PackedImage::scale;
+
+
+
+        PackedImage::PackedImage (Image<float>& image) :
+            transform (image),
+            dim {{ image.size(0), image.size(1), image.size(2) }},
+            data (image.size(0) * image.size(1) * image.size(2))
+        {
+          assert (image.ndim() == 4 && image.size(3) == 5);
+          for (auto l = Loop (image, 0, 3) (image); l; ++l) {
+            Voxel& v (data[image.index(0) + dim[0] * (image.index(1) + dim[1] * image.index(2))]);
+            v.fill (0);
+            for (auto l_inner = Loop (3) (image); l_inner; ++l_inner) {
+              const float value = image.value();
+              if (std::isnan (value))
+                v[flags] |= has_nan;
+              else
+                v[image.index(3)] = std::round (std::min (std::max (value, 0.0f), 1.0f) / scale);
+              if (value)
+                v[flags] |= has_data;
+            }
+          }
+        }
+
+
+      }
+    }
+  }
+}
@@ -0,0 +1,127 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#ifndef __dwi_tractography_act_packed_image_h__
+#define __dwi_tractography_act_packed_image_h__
+
+#include <array>
+
+#include "image.h"
+#include "transform.h"
+#include "types.h"
+
+#include "dwi/tractography/ACT/tissues.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace ACT
+      {
+
+
+        //! A compact copy of the 5TT image, for fast tissue lookups during tracking
+        /*! The five tissue fractions of each voxel are held as 16-bit
+         * fixed-point values (clamped to [0,1]), interleaved with a set of
+         * flags into a single 16-byte block per voxel, so that the 8
+         * neighbours required for trilinear interpolation are read from
+         * at most a few cache lines, rather than from 5 separate volumes.
+         *
+         * Lookups reproduce those of Interp::Masked<Interp::Linear>: the
+         * position is rejected if it lies outside the image, or if its
+         * nearest voxel contains only zeroes; and the tissues are invalid
+         * if any of the neighbours used contains a NaN. */
+        class PackedImage { MEMALIGN(PackedImage)
+          public:
+            PackedImage (Image<float>& image);
+
+            //! set \a tissues to the values at scanner-space position \a pos
+            /*! \returns false (and resets \a tissues) if the position is
+             * outside the image or the tissues are invalid, as with
+             * Tissues::set(). */
+            bool get (const Eigen::Vector3f& pos, Tissues& tissues) const
+            {
+              const Eigen::Vector3d p = transform.scanner2voxel * pos.cast<default_type>();
+              for (size_t axis = 0; axis != 3; ++axis) {
+                if (p[axis] <= -0.5 || p[axis] >= dim[axis] - 0.5) {
+                  tissues.reset();
+                  return false;
+                }
+              }
+              if (!(voxel (std::round (p[0]), std::round (p[1]), std::round (p[2]))[flags] & has_data)) {
+                tissues.reset();
+                return false;
+              }
+
+              ssize_t c[3];
+              float weights[3][2];
+              for (size_t axis = 0; axis != 3; ++axis) {
+                c[axis] = std::floor (p[axis]);
+                const float f = (p[axis] < 0.0 || p[axis] > dim[axis] - 1.0) ? 0.0 : p[axis] - c[axis];
+                weights[axis][0] = 1.0f - f;
+                weights[axis][1] = f;
+              }
+
+              float sum[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+              for (ssize_t z = 0; z < 2; ++z) {
+                for (ssize_t y = 0; y < 2; ++y) {
+                  const float partial_weight = weights[1][y] * weights[2][z];
+                  for (ssize_t x = 0; x < 2; ++x) {
+                    const float weight = weights[0][x] * partial_weight;
+                    const Voxel& v = voxel (clamp (c[0]+x, 0), clamp (c[1]+y, 1), clamp (c[2]+z, 2));
+                    if (v[flags] & has_nan) {
+                      tissues.reset();
+                      return false;
+                    }
+                    for (size_t n = 0; n != 8; ++n)
+                      sum[n] += weight * v[n];
+                  }
+                }
+              }
+
+              return tissues.set (scale * sum[0], scale * sum[1], scale * sum[2], scale * sum[3], scale * sum[4]);
+            }
+
+          private:
+            using Voxel = std::array<uint16_t,8>;
+            // the lanes of each Voxel beyond the 5 tissue fractions:
+            enum { flags = 5 };
+            enum : uint16_t { has_data = 1, has_nan = 2 };
+            static constexpr float scale = 1.0f / 65535.0f;
+
+            const Transform transform;
+            const std::array<ssize_t,3> dim;
+            vector<Voxel> data;
+
+            const Voxel& voxel (ssize_t x, ssize_t y, ssize_t z) const {
+              return data[x + dim[0] * (y + dim[1] * z)];
+            }
+            ssize_t clamp (ssize_t x, size_t axis) const {
+              return x < 0 ? 0 : (x >= dim[axis] ? dim[axis]-1 : x);
+            }
+        };
+
+
+      }
+    }
+  }
+}
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "memory.h"
 #include "dwi/tractography/ACT/gmwmi.h"
+#include "dwi/tractography/ACT/packed_image.h"
 
 
 namespace MR
@@ -39,6 +40,7 @@ namespace MR
               bt (false)
             {
               verify_5TT_image (voxel);
+              packed.reset (new PackedImage (voxel));
               property_set.set (bt, "backtrack");
               if (property_set.find ("crop_at_gmwmi") != property_set.end())
                 gmwmi_finder.reset (new GMWMI_finder (voxel));
@@ -57,6 +59,7 @@ namespace MR
 
           private:
             Image<float> voxel;
+            std::unique_ptr<PackedImage> packed;
             bool bt;
 
             std::unique_ptr<GMWMI_finder> gmwmi_finder;
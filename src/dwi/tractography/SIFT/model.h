@@ -68,6 +68,8 @@ namespace MR
               ModelBase<Fixel> (dwi, dirs)
           {
             Track_fixel_contribution::set_scaling (dwi);
+            if (App::get_options ("scratch_contributions").size())
+              TrackContribution::use_scratch_files();
           }
           Model (const Model& that) = delete;
 
@@ -170,7 +172,7 @@ namespace MR
       void Model<Fixel>::map_streamlines (const std::string& path)
       {
         Tractography::Properties properties;
-        Tractography::Reader<> file (path, properties);
+        auto file = Tractography::open_reader<> (path, properties);
 
         const track_t count = (properties.find ("count") == properties.end()) ? 0 : to<track_t>(properties["count"]);
         if (!count)
@@ -179,11 +181,10 @@ namespace MR
         contributions.assign (count, nullptr);
 
         {
-          Mapping::TrackLoader loader (file, count);
+          Mapping::TrackLoader loader (*file, count);
           TrackMappingWorker worker (*this, Mapping::determine_upsample_ratio (Fixel_map<Fixel>::header(), properties, 0.1));
-          Thread::run_queue (loader,
-                             Thread::batch (Tractography::Streamline<>()),
-                             Thread::multi (worker));
+          loader.run_queue (Thread::batch (Tractography::Streamline<>()),
+                            Thread::multi (worker));
         }
 
         if (!contributions.back()) {
@@ -385,11 +386,11 @@ namespace MR
             TrackContribution& this_cont (*master.contributions[track_index]);
             vector<Track_fixel_contribution> new_cont;
             double total_contribution = 0.0;
-            for (size_t i = 0; i != this_cont.dim(); ++i) {
-              const size_t new_index = remapper[this_cont[i].get_fixel_index()];
+            for (const auto& c : this_cont) {
+              const size_t new_index = remapper[c.get_fixel_index()];
               if (new_index) {
-                new_cont.push_back (Track_fixel_contribution (new_index, this_cont[i].get_length()));
-                total_contribution += this_cont[i].get_length() * master[new_index].get_weight();
+                new_cont.push_back (Track_fixel_contribution (new_index, c.get_length()));
+                total_contribution += c.get_length() * master[new_index].get_weight();
               }
             }
             TrackContribution* new_contribution = new TrackContribution (new_cont, total_contribution, this_cont.get_total_length());
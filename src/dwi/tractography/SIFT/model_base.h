@@ -234,18 +234,17 @@ namespace MR
         void ModelBase<Fixel>::map_streamlines (const std::string& path)
         {
           Tractography::Properties properties;
-          Tractography::Reader<> file (path, properties);
+          auto file = Tractography::open_reader<> (path, properties);
 
           const track_t count = (properties.find ("count") == properties.end()) ? 0 : to<track_t>(properties["count"]);
           if (!count)
             throw Exception ("Cannot map streamlines: track file " + Path::basename(path) + " is empty");
 
-          Mapping::TrackLoader loader (file, count);
+          Mapping::TrackLoader loader (*file, count);
           Mapping::TrackMapperBase mapper (Fixel_map<Fixel>::header(), dirs);
           mapper.set_upsample_ratio (Mapping::determine_upsample_ratio (Fixel_map<Fixel>::header(), properties, 0.1));
           mapper.set_use_precise_mapping (true);
-          Thread::run_queue (
-              loader,
+          loader.run_queue (
               Thread::batch (Tractography::Streamline<float>()),
               Thread::multi (mapper),
               Thread::batch (Mapping::SetDixel()),
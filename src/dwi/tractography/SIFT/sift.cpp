@@ -43,7 +43,12 @@ const OptionGroup SIFTModelOption = OptionGroup ("Options affecting the SIFT mod
 
   + Option ("fd_thresh", "fibre density threshold; exclude an FOD lobe from filtering processing if its integral is less than this amount "
                          "(streamlines will still be mapped to it, but it will not contribute to the cost function or the filtering)")
-    + Argument ("value").type_float (0.0, 2.0 * Math::pi);
+    + Argument ("value").type_float (0.0, 2.0 * Math::pi)
+
+  + Option ("scratch_contributions", "store the contributions of all streamlines to the fixels they traverse in memory-mapped temporary files "
+                                     "(see config file option TmpFileDir), rather than in RAM; this permits processing of tractograms "
+                                     "for which this information would otherwise exceed the available memory, with the operating system "
+                                     "paging the data in from disk as required");
 
 
 
@@ -210,8 +210,7 @@ namespace MR
               double this_actual_cf_change = current_roc_cf * mu_change;
               double quantisation = 0.0;
 
-              for (size_t f = 0; f != candidate_contribution.dim(); ++f) {
-                const Track_fixel_contribution& fixel_cont = candidate_contribution[f];
+              for (const auto& fixel_cont : candidate_contribution) {
                 const float length = fixel_cont.get_length();
                 Fixel& this_fixel = fixels[fixel_cont.get_fixel_index()];
                 quantisation += this_fixel.calc_quantisation (old_mu, length);
@@ -226,10 +225,8 @@ namespace MR
               if (this_actual_cf_change < std::min ( {required_cf_change_ratio, required_cf_change_quantisation, this_nonlinearity })) {
 
                 // Candidate streamline removal meets all criteria; remove from reconstruction
-                for (size_t f = 0; f != candidate_contribution.dim(); ++f) {
-                  const Track_fixel_contribution& fixel_cont = candidate_contribution[f];
+                for (const auto& fixel_cont : candidate_contribution)
                   fixels[fixel_cont.get_fixel_index()] -= fixel_cont.get_length();
-                }
                 TD_sum -= candidate_contribution.get_total_contribution();
                 contributing_length_removed += candidate_contribution.get_total_length();
                 delete contributions[candidate_index];
@@ -439,10 +436,10 @@ namespace MR
         const double mu_if_removed = FOD_sum / TD_sum_if_removed;
         const double mu_change_if_removed = mu_if_removed - current_mu;
         double gradient = current_roc_cost * mu_change_if_removed;
-        for (size_t f = 0; f != tck_cont.dim(); ++f) {
-          const Fixel& fixel = fixels[tck_cont[f].get_fixel_index()];
+        for (const auto& c : tck_cont) {
+          const Fixel& fixel = fixels[c.get_fixel_index()];
           const double undo_gradient_mu_only = fixel.get_d_cost_d_mu (current_mu) * mu_change_if_removed;
-          const double gradient_remove_tck = fixel.get_cost_wo_track (mu_if_removed, tck_cont[f].get_length()) - fixel.get_cost (current_mu);
+          const double gradient_remove_tck = fixel.get_cost_wo_track (mu_if_removed, c.get_length()) - fixel.get_cost (current_mu);
           gradient = gradient - undo_gradient_mu_only + gradient_remove_tck;
         }
         return gradient;
@@ -16,6 +16,15 @@
 
 #include "dwi/tractography/SIFT/track_contribution.h"
 
+#include <map>
+#include <mutex>
+
+#include "signal_handler.h"
+#include "file/config.h"
+#include "file/entry.h"
+#include "file/mmap.h"
+#include "file/utils.h"
+
 namespace MR
 {
   namespace DWI
@@ -31,9 +40,163 @@ namespace MR
         float Track_fixel_contribution::min_length_for_storage = 0.0;
 
 
+
+        namespace
+        {
+
+          // Allocates space for encoded contributions sequentially within a set of
+          //   memory-mapped temporary files; each file is erased as soon as all
+          //   contributions stored within it have been released (e.g. once those
+          //   streamlines have been filtered, or re-encoded following the removal
+          //   of excluded fixels)
+          class ScratchStorage
+          { NOMEMALIGN
+            public:
+              ScratchStorage () :
+                  chunk_size (get_chunk_size()),
+                  current (nullptr),
+                  used (0) { }
+
+              ~ScratchStorage ()
+              {
+                while (!chunks.empty())
+                  erase (chunks.begin());
+              }
+
+              uint8_t* allocate (const size_t size)
+              {
+                std::lock_guard<std::mutex> lock (mutex);
+                if (!current || used + size > size_t(current->mmap->size())) {
+                  const size_t new_chunk_size = std::max (chunk_size, size);
+                  const std::string path = File::create_tempfile (new_chunk_size, "bin");
+                  SignalHandler::mark_file_for_deletion (path);
+                  DEBUG ("Storing SIFT streamline contributions in temporary file \"" + path + "\"");
+                  Chunk chunk;
+                  chunk.mmap.reset (new File::MMap (File::Entry (path), true, false));
+                  chunk.num_allocations = 0;
+                  const uint8_t* const address = chunk.mmap->address();
+                  current = &(chunks[address] = std::move (chunk));
+                  used = 0;
+                }
+                uint8_t* const ptr = current->mmap->address() + used;
+                used += size;
+                ++current->num_allocations;
+                return ptr;
+              }
+
+              void release (const uint8_t* const ptr)
+              {
+                std::lock_guard<std::mutex> lock (mutex);
+                auto chunk = chunks.upper_bound (ptr);
+                assert (chunk != chunks.begin());
+                --chunk;
+                assert (chunk->second.num_allocations);
+                if (--chunk->second.num_allocations)
+                  return;
+                // Rather than erasing the file currently being filled, start again
+                //   from the beginning of it
+                if (&chunk->second == current)
+                  used = 0;
+                else
+                  erase (chunk);
+              }
+
+            private:
+              class Chunk { NOMEMALIGN
+                public:
+                  std::unique_ptr<File::MMap> mmap;
+                  size_t num_allocations;
+              };
+
+              const size_t chunk_size;
+              std::mutex mutex;
+              std::map<const uint8_t*, Chunk> chunks;
+              Chunk* current;
+              size_t used;
+
+              void erase (std::map<const uint8_t*, Chunk>::iterator chunk)
+              {
+                if (&chunk->second == current)
+                  current = nullptr;
+                const std::string path = chunk->second.mmap->name();
+                DEBUG ("Erasing temporary file \"" + path + "\" of SIFT streamline contributions");
+                chunks.erase (chunk);
+                try {
+                  File::remove (path);
+                  SignalHandler::unmark_file_for_deletion (path);
+                } catch (Exception& e) {
+                  e.display();
+                }
+              }
+
+              static size_t get_chunk_size ()
+              {
+                //CONF option: SIFTScratchFileSize
+                //CONF default: 268435456
+                //CONF The size (in bytes) of each temporary file used to hold
+                //CONF streamline-fixel contributions in SIFT / SIFT2 when
+                //CONF storage of these in RAM is disabled.
+                return std::max (File::Config::get_int ("SIFTScratchFileSize", 268435456), 1048576);
+              }
+          };
+
+          std::unique_ptr<ScratchStorage> scratch_storage;
+
+        }
+
+
+
+        TrackContribution::TrackContribution (const vector<Track_fixel_contribution>& in, const float c, const float l) :
+            data (nullptr),
+            in_scratch_storage (bool (scratch_storage)),
+            num_contributions (in.size()),
+            total_contribution (c),
+            total_length (l)
+        {
+          if (in.empty())
+            return;
+          // Encode into a temporary buffer first, as the size is not known in advance;
+          //   each contribution requires at most 5 bytes for the index delta and 1 byte for the length
+          vector<uint8_t> buffer (6 * in.size());
+          uint8_t* p = buffer.data();
+          uint32_t previous_index = 0;
+          for (const auto& i : in) {
+            const int64_t delta = int64_t(i.get_fixel_index()) - int64_t(previous_index);
+            uint64_t zigzag = (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+            while (zigzag >= 0x80) {
+              *p++ = uint8_t (zigzag | 0x80);
+              zigzag >>= 7;
+            }
+            *p++ = uint8_t (zigzag);
+            *p++ = i.get_length_as_int();
+            previous_index = i.get_fixel_index();
+          }
+          const size_t size = p - buffer.data();
+          uint8_t* storage = in_scratch_storage ? scratch_storage->allocate (size) : new uint8_t [size];
+          memcpy (storage, buffer.data(), size);
+          data = storage;
+        }
+
+
+
+        TrackContribution::~TrackContribution()
+        {
+          if (!in_scratch_storage)
+            delete[] data;
+          else if (data)
+            scratch_storage->release (data);
+        }
+
+
+
+        void TrackContribution::use_scratch_files()
+        {
+          if (!scratch_storage)
+            scratch_storage.reset (new ScratchStorage());
+        }
+
+
       }
     }
   }
 }
-
-
@@ -21,7 +21,7 @@
 #include <cstdint>
 
 #include "header.h"
-#include "min_mem_array.h"
+#include "types.h"
 
 #include "math/math.h"
 
@@ -38,20 +38,22 @@ namespace MR
 
 
 
+      // A single streamline-fixel contribution: the fixel index, and the length
+      //   of the streamline within that fixel quantised to 8 bits
       class Track_fixel_contribution
       { MEMALIGN(Track_fixel_contribution)
         public:
-          Track_fixel_contribution (const uint32_t fixel_index, const float length)
-          {
-            const uint32_t length_as_int = std::min (uint32_t(255), uint32_t(std::round (scale_to_storage * length)));
-            data = (fixel_index & 0x00FFFFFF) | (length_as_int << 24);
-          }
+          Track_fixel_contribution (const uint32_t fixel_index, const float length) :
+              fixel_index (fixel_index),
+              length_as_int (std::min (uint32_t(255), uint32_t(std::round (scale_to_storage * length)))) { }
 
           Track_fixel_contribution() :
-            data (0) { }
+              fixel_index (0),
+              length_as_int (0) { }
 
-          uint32_t get_fixel_index() const { return (data & 0x00FFFFFF); }
-          float    get_length()      const { return (uint32_t((data & 0xFF000000) >> 24) * scale_from_storage); }
+          uint32_t get_fixel_index() const { return fixel_index; }
+          float    get_length()      const { return length_as_int * scale_from_storage; }
+          uint8_t  get_length_as_int() const { return length_as_int; }
 
 
           bool add (const float length)
@@ -59,10 +61,9 @@ namespace MR
             // Allow summing of multiple contributions to a fixel, UNLESS it would cause truncation, in which
             //   case keep them separate
             const uint32_t increment = std::round (scale_to_storage * length);
-            const uint32_t existing = (data & 0xFF000000) >> 24;
-            if (existing + increment > 255)
+            if (length_as_int + increment > 255)
               return false;
-            data = (data & 0x00FFFFFF) | ((existing + increment) << 24);
+            length_as_int += increment;
             return true;
           }
 
@@ -78,76 +79,109 @@ namespace MR
           }
 
 
-          // Minimum length that will be non-zero once converted to an integer for word-sharing storage
+          // Minimum length that will be non-zero once converted to an integer for storage
           static float min() { return min_length_for_storage; }
 
 
         private:
-          uint32_t data;
+          uint32_t fixel_index;
+          uint8_t length_as_int;
 
           static float scale_to_storage, scale_from_storage, min_length_for_storage;
 
-      };
-
-
-
-
-/*
-// This is a 'safe' version of Track_fixel_contribution that does not use byte-sharing, but requires double the RAM
-// Simply comment the class above and un-comment this one to use
-class Track_fixel_contribution
-{ MEMALIGN(Track_fixel_contribution)
-  public:
-    Track_fixel_contribution (const uint32_t fixel_index, const float length) :
-      fixel (fixel_index),
-      length (length) { }
-
-    Track_fixel_contribution() :
-      fixel (0),
-      length (0.0) { }
-
-
-    bool add (const float length) { value += length; return true; }
+          // Used when decoding the compact representation within TrackContribution
+          Track_fixel_contribution (const uint32_t fixel_index, const uint8_t length_as_int, const bool) :
+              fixel_index (fixel_index),
+              length_as_int (length_as_int) { }
+          friend class TrackContribution;
 
-    uint32_t get_fixel_index() const { return fixel; }
-    float    get_length()      const { return length; }
-
-
-    static void set_scaling (const Image::Info& in) { min_length_for_storage = 0.0; }
-    static float min() { return min_length_for_storage; }
-
-
-  private:
-    uint32_t fixel;
-    float length;
-
-    static float scale_to_storage, scale_from_storage, min_length_for_storage;
+      };
 
-};
-*/
 
 
 
-      class TrackContribution : public Min_mem_array<Track_fixel_contribution>
+      // The contributions of a single streamline to all fixels it traverses
+      //
+      // In order to minimise memory requirements when storing this information for
+      //   every streamline in a very large tractogram, these are encoded in a compact
+      //   variable-length byte stream: for each contribution, the difference in fixel
+      //   index relative to the previous contribution (zigzag-encoded as a signed
+      //   LEB128 varint, which typically requires only one or two bytes), followed by
+      //   the quantised length. Contributions are therefore decoded on the fly when
+      //   iterating; random access is not supported.
+      //
+      // The encoded data are held either in RAM (default), or in memory-mapped
+      //   temporary files if use_scratch_files() has been invoked; in the latter
+      //   case the operating system is free to page the data out to disk, and in
+      //   to RAM again as each block of streamlines is processed. Each instance
+      //   records where its data were stored, so that they are released correctly
+      //   upon destruction.
+      class TrackContribution
       { MEMALIGN(TrackContribution)
 
         public:
-        TrackContribution (const vector<Track_fixel_contribution>& in, const float c, const float l) :
-            Min_mem_array<Track_fixel_contribution> (in),
-            total_contribution (c),
-            total_length       (l) { }
-
-        TrackContribution () :
-            Min_mem_array<Track_fixel_contribution> (),
-            total_contribution (0.0),
-            total_length       (0.0) { }
-
-        ~TrackContribution() { }
-
-        float get_total_contribution() const { return total_contribution; }
-        float get_total_length      () const { return total_length; }
+          TrackContribution (const vector<Track_fixel_contribution>& in, const float c, const float l);
+
+          TrackContribution () :
+              data (nullptr),
+              in_scratch_storage (false),
+              num_contributions (0),
+              total_contribution (0.0),
+              total_length       (0.0) { }
+
+          TrackContribution (const TrackContribution&) = delete;
+
+          ~TrackContribution();
+
+          class const_iterator
+          { NOMEMALIGN
+            public:
+              const_iterator (const uint8_t* data, const uint32_t remaining) :
+                  data (data),
+                  remaining (remaining),
+                  fixel_index (0) { decode(); }
+              FORCE_INLINE const Track_fixel_contribution& operator* () const { return current; }
+              FORCE_INLINE const Track_fixel_contribution* operator-> () const { return &current; }
+              FORCE_INLINE const_iterator& operator++ () { --remaining; decode(); return *this; }
+              FORCE_INLINE bool operator!= (const const_iterator& that) const { return remaining != that.remaining; }
+            private:
+              const uint8_t* data;
+              uint32_t remaining;
+              uint32_t fixel_index;
+              Track_fixel_contribution current;
+
+              FORCE_INLINE void decode ()
+              {
+                if (!remaining)
+                  return;
+                uint64_t zigzag = 0;
+                for (size_t shift = 0; ; shift += 7) {
+                  const uint8_t byte = *data++;
+                  zigzag |= uint64_t (byte & 0x7F) << shift;
+                  if (!(byte & 0x80))
+                    break;
+                }
+                fixel_index += uint32_t (int64_t (zigzag >> 1) ^ -int64_t (zigzag & 1));
+                current = Track_fixel_contribution (fixel_index, *data++, true);
+              }
+          };
+
+          const_iterator begin() const { return const_iterator (data, num_contributions); }
+          const_iterator end()   const { return const_iterator (nullptr, 0); }
+
+          size_t dim() const { return num_contributions; }
+
+          float get_total_contribution() const { return total_contribution; }
+          float get_total_length      () const { return total_length; }
+
+          // Store the encoded contributions of all subsequently constructed
+          //   streamlines in memory-mapped temporary files rather than in RAM
+          static void use_scratch_files();
 
         private:
+          const uint8_t* data;
+          const bool in_scratch_storage;
+          const uint32_t num_contributions;
           const float total_contribution, total_length;
 
       };
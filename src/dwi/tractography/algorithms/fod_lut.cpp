@@ -0,0 +1,251 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <zlib.h>
+
+#include "algo/loop.h"
+#include "algo/threaded_loop.h"
+#include "file/path.h"
+#include "file/utils.h"
+#include "math/SH.h"
+#include "dwi/tractography/algorithms/fod_lut.h"
+
+// layout of the file header: 16 bytes of magic number, then (in native byte
+// order) a byte order mark, the format version, the image dimensions, the
+// number of SH coefficients & directions, the checksum of the FOD data, the
+// amplitude scaling factor, and the number of voxels holding FOD data. This
+// is followed by the voxel index (one int32 per voxel), then the amplitudes
+// (one uint16 per direction per voxel holding FOD data):
+#define FODLUT_MAGIC "mrtrix FOD LUT\n"
+#define FODLUT_BYTE_ORDER_MARK 0x01020304U
+#define FODLUT_VERSION 1U
+#define FODLUT_HEADER_SIZE 64
+#define FODLUT_NUM_DIRECTIONS 1281
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Algorithms
+      {
+
+        namespace {
+
+          class FODLUTHeader { NOMEMALIGN
+            public:
+              char magic[16];
+              uint32_t byte_order_mark, version;
+              uint32_t dim[3];
+              uint32_t num_coefs, num_dirs;
+              uint32_t checksum;
+              float scale;
+              uint32_t unused;
+              uint64_t num_voxels;
+          };
+          static_assert (sizeof (FODLUTHeader) == FODLUT_HEADER_SIZE, "unexpected padding in FOD lookup table header");
+
+
+
+          uint32_t compute_checksum (Image<float>& fod)
+          {
+            uLong crc = crc32 (0L, Z_NULL, 0);
+            Eigen::VectorXf coefs (fod.size(3));
+            for (auto l = Loop (fod, 0, 3) (fod); l; ++l) {
+              coefs = fod.row (3);
+              crc = crc32 (crc, reinterpret_cast<const Bytef*> (coefs.data()), coefs.size() * sizeof (float));
+            }
+            return crc;
+          }
+
+
+
+          // an upper bound on the amplitude of an SH series along any direction,
+          // from the norm of its coefficients in each harmonic degree:
+          float max_amplitude (const Eigen::VectorXf& coefs, int lmax)
+          {
+            float bound = 0.0f;
+            for (int l = 0; l <= lmax; l += 2)
+              bound += std::sqrt ((2*l+1) / (4.0*Math::pi)) * coefs.segment (Math::SH::NforL (l-2), 2*l+1).norm();
+            return bound;
+          }
+
+
+
+          class Evaluator { MEMALIGN(Evaluator)
+            public:
+              Evaluator (const Eigen::MatrixXf& SHT, const vector<int32_t>& index, float scale, uint16_t* amplitudes) :
+                SHT (SHT),
+                index (index),
+                scale (scale),
+                amplitudes (amplitudes),
+                coefs (SHT.cols()),
+                values (SHT.rows()) { }
+
+              void operator() (Image<float>& fod)
+              {
+                const int32_t n = index[fod.index(0) + fod.size(0) * (fod.index(1) + fod.size(1) * fod.index(2))];
+                if (n < 0)
+                  return;
+                coefs = fod.row (3);
+                values.noalias() = SHT * coefs;
+                uint16_t* out = amplitudes + size_t(n) * SHT.rows();
+                for (ssize_t i = 0; i != values.size(); ++i)
+                  out[i] = std::round (std::max (values[i], 0.0f) / scale);
+              }
+
+            private:
+              const Eigen::MatrixXf& SHT;
+              const vector<int32_t>& index;
+              const float scale;
+              uint16_t* amplitudes;
+              Eigen::VectorXf coefs, values;
+          };
+
+        }
+
+
+
+
+
+        FODLUT::FODLUT (const std::string& path, const Image<float>& image) :
+            dirs (FODLUT_NUM_DIRECTIONS),
+            transform (image),
+            dim {{ image.size(0), image.size(1), image.size(2) }},
+            index (nullptr),
+            amplitudes (nullptr),
+            scale (0.0f)
+        {
+          auto fod (image);
+          const uint32_t checksum = compute_checksum (fod);
+          if (load (path, fod, checksum)) {
+            INFO ("using FOD lookup table from file \"" + path + "\"");
+            return;
+          }
+          generate (path, fod, checksum);
+          if (!load (path, fod, checksum))
+            throw Exception ("error reading FOD lookup table from file \"" + path + "\"");
+        }
+
+
+
+        bool FODLUT::load (const std::string& path, const Image<float>& fod, uint32_t checksum)
+        {
+          if (!Path::exists (path))
+            return false;
+
+          mmap.reset (new File::MMap (path));
+          const size_t num_voxels_total = dim[0] * dim[1] * dim[2];
+          FODLUTHeader H;
+          if (mmap->size() >= FODLUT_HEADER_SIZE) {
+            memcpy (&H, mmap->address(), FODLUT_HEADER_SIZE);
+            if (!memcmp (H.magic, FODLUT_MAGIC, sizeof (FODLUT_MAGIC)) &&
+                H.byte_order_mark == FODLUT_BYTE_ORDER_MARK &&
+                H.version == FODLUT_VERSION &&
+                H.dim[0] == uint32_t(dim[0]) && H.dim[1] == uint32_t(dim[1]) && H.dim[2] == uint32_t(dim[2]) &&
+                H.num_coefs == uint32_t(fod.size(3)) &&
+                H.num_dirs == dirs.size() &&
+                H.checksum == checksum &&
+                mmap->size() == int64_t (FODLUT_HEADER_SIZE + num_voxels_total * sizeof (int32_t) + H.num_voxels * dirs.size() * sizeof (uint16_t))) {
+              index = reinterpret_cast<const int32_t*> (mmap->address() + FODLUT_HEADER_SIZE);
+              amplitudes = reinterpret_cast<const uint16_t*> (index + num_voxels_total);
+              scale = H.scale;
+              mmap->advise (File::MMap::Access::Random);
+              return true;
+            }
+          }
+
+          WARN ("file \"" + path + "\" does not hold a FOD lookup table for image \"" + fod.name() + "\"");
+          mmap.reset();
+          return false;
+        }
+
+
+
+        void FODLUT::generate (const std::string& path, Image<float>& fod, uint32_t checksum)
+        {
+          const int lmax = Math::SH::LforN (fod.size(3));
+
+          // only voxels with FOD data are included, as per Interp::Masked:
+          vector<int32_t> voxel_index (dim[0] * dim[1] * dim[2], -1);
+          int32_t num_voxels = 0;
+          float max_value = 0.0f;
+          Eigen::VectorXf coefs (fod.size(3));
+          for (auto l = Loop (fod, 0, 3) (fod); l; ++l) {
+            coefs = fod.row (3);
+            if (!std::isfinite (coefs[0]) || !coefs.any())
+              continue;
+            voxel_index[fod.index(0) + dim[0] * (fod.index(1) + dim[1] * fod.index(2))] = num_voxels++;
+            max_value = std::max (max_value, max_amplitude (coefs, lmax));
+          }
+
+          Eigen::MatrixXd directions (dirs.size(), 3);
+          for (size_t n = 0; n != dirs.size(); ++n)
+            directions.row (n) = dirs[n];
+          const Eigen::MatrixXf SHT = Math::SH::init_transform_cart (directions, lmax).cast<float>();
+
+          FODLUTHeader H;
+          memset (&H, 0, sizeof (H));
+          memcpy (H.magic, FODLUT_MAGIC, sizeof (FODLUT_MAGIC));
+          H.byte_order_mark = FODLUT_BYTE_ORDER_MARK;
+          H.version = FODLUT_VERSION;
+          for (size_t axis = 0; axis != 3; ++axis)
+            H.dim[axis] = dim[axis];
+          H.num_coefs = fod.size(3);
+          H.num_dirs = dirs.size();
+          H.checksum = checksum;
+          H.scale = max_value ? max_value / std::numeric_limits<uint16_t>::max() : 1.0f;
+          H.num_voxels = num_voxels;
+
+          const int64_t file_size = FODLUT_HEADER_SIZE + voxel_index.size() * sizeof (int32_t) + int64_t (num_voxels) * dirs.size() * sizeof (uint16_t);
+          INFO ("writing FOD lookup table for " + str(num_voxels) + " voxels along " + str(dirs.size()) + " directions to file \"" + path + "\" (" + str(file_size) + " bytes)");
+          // the table is written to a temporary file in the same directory, and
+          // only moved into place once complete, so that other processes
+          // sharing the same table never map a partially written file:
+          std::string tmp_path = path + ".";
+          for (size_t n = 0; n != 6; ++n)
+            tmp_path += File::random_char();
+          tmp_path += ".tmp";
+          File::create (tmp_path, file_size);
+          try {
+            File::MMap out (File::Entry (tmp_path), true, false);
+            memcpy (out.address(), &H, FODLUT_HEADER_SIZE);
+            memcpy (out.address() + FODLUT_HEADER_SIZE, voxel_index.data(), voxel_index.size() * sizeof (int32_t));
+            uint16_t* data = reinterpret_cast<uint16_t*> (out.address() + FODLUT_HEADER_SIZE + voxel_index.size() * sizeof (int32_t));
+            ThreadedLoop ("generating FOD lookup table", fod, 0, 3).run (Evaluator (SHT, voxel_index, H.scale, data), fod);
+          }
+          catch (...) {
+            std::remove (tmp_path.c_str());
+            throw;
+          }
+#ifdef MRTRIX_WINDOWS
+          // rename() does not replace an existing file on Windows:
+          if (Path::exists (path))
+            File::remove (path);
+#endif
+          if (std::rename (tmp_path.c_str(), path.c_str())) {
+            const std::string error = strerror (errno);
+            std::remove (tmp_path.c_str());
+            throw Exception ("error moving FOD lookup table into place at \"" + path + "\": " + error);
+          }
+        }
+
+
+      }
+    }
+  }
+}
@@ -0,0 +1,121 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_algorithms_fod_lut_h__
+#define __dwi_tractography_algorithms_fod_lut_h__
+
+#include "image.h"
+#include "memory.h"
+#include "transform.h"
+#include "types.h"
+#include "file/mmap.h"
+#include "dwi/directions/set.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Algorithms
+      {
+
+
+        //! Precomputed FOD amplitudes along a dense set of directions in each voxel
+        /*! This trades memory for arithmetic: rather than interpolating all SH
+         * coefficients & evaluating the SH series for every sample, the FOD
+         * amplitude along the nearest direction in a fixed set is read from
+         * each of the 8 neighbouring voxels & interpolated trilinearly.
+         *
+         * Amplitudes are held as 16-bit fixed-point values, and only for voxels
+         * that contain FOD data; negative amplitudes are stored as zero, since
+         * they lie below any tracking threshold. The table is held in a file
+         * that is memory-mapped, so that it can be re-used by subsequent runs
+         * on the same FOD image: the file records the dimensions of the image
+         * and a checksum of its contents, and is regenerated if these do not
+         * match. */
+        class FODLUT { MEMALIGN(FODLUT)
+          public:
+            FODLUT (const std::string& path, const Image<float>& fod);
+
+            //! the FOD amplitude at scanner-space \a position along \a direction
+            /*! As with Interp::Masked, this is NaN if \a position lies outside
+             * the image, or if the nearest voxel contains no FOD data. */
+            float value (const Eigen::Vector3f& position, const Eigen::Vector3f& direction) const
+            {
+              const Eigen::Vector3d p = transform.scanner2voxel * position.cast<default_type>();
+              for (size_t axis = 0; axis != 3; ++axis) {
+                if (p[axis] <= -0.5 || p[axis] >= dim[axis] - 0.5)
+                  return NaN;
+              }
+              if (voxel_index (std::round (p[0]), std::round (p[1]), std::round (p[2])) < 0)
+                return NaN;
+
+              const size_t d = dirs.select_direction (direction.cast<default_type>());
+
+              ssize_t c[3];
+              float weights[3][2];
+              for (size_t axis = 0; axis != 3; ++axis) {
+                c[axis] = std::floor (p[axis]);
+                const float f = (p[axis] < 0.0 || p[axis] > dim[axis] - 1.0) ? 0.0 : p[axis] - c[axis];
+                weights[axis][0] = 1.0f - f;
+                weights[axis][1] = f;
+              }
+
+              float value = 0.0f;
+              for (ssize_t z = 0; z < 2; ++z) {
+                for (ssize_t y = 0; y < 2; ++y) {
+                  const float partial_weight = weights[1][y] * weights[2][z];
+                  for (ssize_t x = 0; x < 2; ++x) {
+                    const int32_t n = voxel_index (clamp (c[0]+x, 0), clamp (c[1]+y, 1), clamp (c[2]+z, 2));
+                    if (n >= 0)
+                      value += weights[0][x] * partial_weight * amplitudes[size_t(n) * dirs.size() + d];
+                  }
+                }
+              }
+              return scale * value;
+            }
+
+            size_t num_directions () const { return dirs.size(); }
+
+          private:
+            const Directions::FastLookupSet dirs;
+            const Transform transform;
+            const std::array<ssize_t,3> dim;
+            std::unique_ptr<File::MMap> mmap;
+            const int32_t* index;
+            const uint16_t* amplitudes;
+            float scale;
+
+            int32_t voxel_index (ssize_t x, ssize_t y, ssize_t z) const {
+              return index[x + dim[0] * (y + dim[1] * z)];
+            }
+            ssize_t clamp (ssize_t x, size_t axis) const {
+              return x < 0 ? 0 : (x >= dim[axis] ? dim[axis]-1 : x);
+            }
+
+            bool load (const std::string& path, const Image<float>& fod, uint32_t checksum);
+            void generate (const std::string& path, Image<float>& fod, uint32_t checksum);
+        };
+
+
+      }
+    }
+  }
+}
+
+#endif
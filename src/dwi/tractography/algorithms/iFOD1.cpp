@@ -31,13 +31,25 @@ namespace MR
         const OptionGroup iFODOptions = OptionGroup ("Options specific to the iFOD tracking algorithms")
 
         + Option ("power", "raise the FOD to the power specified (defaults are: 1.0 for iFOD1; 1.0/nsamples for iFOD2).")
-          + Argument ("value").type_float (0.0);
+          + Argument ("value").type_float (0.0)
+
+        + Option ("fod_lut", "precompute the FOD amplitudes along a dense set of directions in each voxel, "
+                             "and interpolate these rather than the SH coefficients during tracking. "
+                             "This is faster, but requires considerably more memory; amplitudes are "
+                             "also only evaluated along the nearest of the predefined directions. "
+                             "The lookup table is stored in the file specified, and re-used by "
+                             "subsequent runs on the same FOD image; it is regenerated if the file "
+                             "does not match the FOD image.")
+          + Argument ("path").type_text();
 
 
         void load_iFOD_options (Tractography::Properties& properties)
         {
           auto opt = get_options ("power");
           if (opt.size()) properties["fod_power"] = str<float> (opt[0][0]);
+
+          opt = get_options ("fod_lut");
+          if (opt.size()) properties["fod_lut"] = std::string (opt[0][0]);
         }
 
       }
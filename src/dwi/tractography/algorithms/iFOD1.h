@@ -23,6 +23,7 @@
 #include "dwi/tractography/tracking/tractography.h"
 #include "dwi/tractography/tracking/types.h"
 #include "dwi/tractography/algorithms/calibrator.h"
+#include "dwi/tractography/algorithms/fod_lut.h"
 
 
 
@@ -86,6 +87,10 @@ namespace MR
           if (precomputed)
             precomputer.init (lmax);
 
+          auto lut_path = properties.find ("fod_lut");
+          if (lut_path != properties.end())
+            lut.reset (new FODLUT (lut_path->second, source));
+
         }
 
         ~Shared ()
@@ -113,6 +118,7 @@ namespace MR
         size_t lmax, max_trials;
         float sin_max_angle_1o, fod_power;
         Math::SH::PrecomputedAL<float> precomputer;
+        std::unique_ptr<FODLUT> lut;
 
         private:
         mutable double mean_samples, mean_truncations, max_max_truncation;
@@ -179,7 +185,8 @@ namespace MR
 
       term_t next () override
       {
-        if (!get_data (source))
+        // the lookup table yields NaN outside the image, caught below:
+        if (!S.lut && !get_data (source))
           return EXIT_IMAGE;
 
         float max_val = 0.0;
@@ -229,6 +236,10 @@ namespace MR
 
       float get_metric (const Eigen::Vector3f& position, const Eigen::Vector3f& direction) override
       {
+        if (S.lut) {
+          const float value = S.lut->value (position, direction);
+          return std::isnan (value) ? 0.0 : value;
+        }
         if (!get_data (source, position))
           return 0.0;
         return FOD (direction);
@@ -245,6 +256,8 @@ namespace MR
 
       float FOD (const Eigen::Vector3f& d) const
       {
+        if (S.lut)
+          return S.lut->value (pos, d);
         return (S.precomputer ?
             S.precomputer.value (values, d) :
             Math::SH::value (values, d, S.lmax)
@@ -27,6 +27,7 @@
 #include "dwi/tractography/tracking/tractography.h"
 #include "dwi/tractography/tracking/types.h"
 #include "dwi/tractography/algorithms/calibrator.h"
+#include "dwi/tractography/algorithms/fod_lut.h"
 
 
 namespace MR
@@ -84,6 +85,10 @@ namespace MR
                   if (precomputed)
                     precomputer.init (lmax);
 
+                  auto lut_path = properties.find ("fod_lut");
+                  if (lut_path != properties.end())
+                    lut.reset (new FODLUT (lut_path->second, source));
+
                   // num_samples is number of samples excluding first point
                   --num_samples;
                   INFO ("iFOD2 generating " + str(num_samples) + " vertices per " + str (step_size) + " mm step");
@@ -132,6 +137,7 @@ namespace MR
                 size_t lmax, num_samples, max_trials;
                 float sin_max_angle_ho, fod_power;
                 Math::SH::PrecomputedAL<float> precomputer;
+                std::unique_ptr<FODLUT> lut;
 
               private:
                 mutable double mean_samples, mean_truncations, max_max_truncation;
@@ -283,6 +289,10 @@ namespace MR
 
             float get_metric (const Eigen::Vector3f& position, const Eigen::Vector3f& direction) override
             {
+              if (S.lut) {
+                const float value = S.lut->value (position, direction);
+                return std::isnan (value) ? 0.0 : value;
+              }
               if (!get_data (source, position))
                 return 0.0;
               return FOD (direction);
@@ -355,6 +365,8 @@ namespace MR
 
             FORCE_INLINE float FOD (const Eigen::Vector3f& direction) const
             {
+              if (S.lut)
+                return S.lut->value (pos, direction);
               return (S.precomputer ?
                   S.precomputer.value (values, direction) :
                   Math::SH::value (values, direction, S.lmax)
@@ -363,6 +375,8 @@ namespace MR
 
             FORCE_INLINE float FOD (const Eigen::Vector3f& position, const Eigen::Vector3f& direction)
             {
+              if (S.lut)
+                return S.lut->value (position, direction);
               if (!get_data (source, position))
                 return NaN;
               return FOD (direction);
@@ -0,0 +1,91 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <zlib.h>
+
+#include "raw.h"
+#include "file/config.h"
+#include "dwi/tractography/compression.h"
+
+namespace MR {
+  namespace DWI {
+    namespace Tractography {
+      namespace Compression {
+
+
+
+        double precision ()
+        {
+          //CONF option: TrackWriterPrecision
+          //CONF default: 0.001
+          //CONF The precision (in mm) to which streamline coordinates are
+          //CONF quantised when writing compressed track files (.tckz). Larger
+          //CONF values yield smaller files, at the expense of accuracy.
+          // limit to the number of digits recorded in the file header, so that
+          // the value used for encoding matches that used for decoding exactly:
+          static const double value = to<double> (str (File::Config::get_float ("TrackWriterPrecision", 0.001), 6));
+          if (!(value > 0.0))
+            throw Exception ("TrackWriterPrecision config file option must be positive");
+          return value;
+        }
+
+
+
+        void Encoder::compress (vector<uint8_t>& block)
+        {
+          uLongf compressed_size = compressBound (data.size());
+          block.resize (block_header_size + compressed_size);
+          if (::compress2 (block.data() + block_header_size, &compressed_size, data.data(), data.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+            throw Exception ("error compressing streamline data");
+          block.resize (block_header_size + compressed_size);
+          Raw::store_LE<uint32_t> (compressed_size, block.data());
+          Raw::store_LE<uint32_t> (data.size(), block.data() + 4);
+          data.clear();
+        }
+
+
+
+        bool Decoder::load (std::istream& in)
+        {
+          vector<uint8_t> compressed;
+          do {
+            uint8_t header[block_header_size];
+            in.read (reinterpret_cast<char*> (header), sizeof (header));
+            if (!in.good())
+              return false;
+            const uint32_t compressed_size = Raw::fetch_LE<uint32_t> (header);
+            if (!compressed_size)
+              return false;
+            uLongf size = Raw::fetch_LE<uint32_t> (header + 4);
+
+            compressed.resize (compressed_size);
+            in.read (reinterpret_cast<char*> (compressed.data()), compressed_size);
+            if (!in.good())
+              return false;
+            data.resize (size);
+            if (::uncompress (data.data(), &size, compressed.data(), compressed_size) != Z_OK || size != data.size())
+              throw Exception ("error uncompressing streamline data");
+            pos = 0;
+          } while (data.empty());
+          return true;
+        }
+
+
+
+      }
+    }
+  }
+}
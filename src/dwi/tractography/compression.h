@@ -0,0 +1,183 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_compression_h__
+#define __dwi_tractography_compression_h__
+
+#include <cmath>
+#include <fstream>
+
+#include "types.h"
+#include "dwi/tractography/streamline.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+      //! Compressed storage of streamline data, as used in .tckz files
+      /*! Compressed track files use the same header as regular track files,
+       * with the additional entries "compression: deflate" and "precision:",
+       * the latter specifying the quantisation step (in mm) applied to the
+       * streamline coordinates (see the TrackWriterPrecision config file
+       * option).
+       *
+       * The streamline data are stored as a sequence of blocks, each
+       * consisting of an 8-byte header holding the compressed & uncompressed
+       * sizes of the block (as 32-bit little-endian integers), followed by
+       * its zlib-compressed contents. A block with a compressed size of zero
+       * marks the end of the data. Once uncompressed, each block holds a
+       * series of streamlines, each stored as its number of points followed
+       * by the quantised position of each point, as zig-zag encoded
+       * variable-length integers. Each position is stored relative to its
+       * linear extrapolation from the previous two points (using the origin
+       * and a zero displacement for the first points); since streamlines
+       * are smooth and sampled at regular intervals, most of these residuals
+       * fit in a single byte, and compress well. */
+      namespace Compression
+      {
+
+        //! the size of the header preceding each block
+        /*! An empty header (i.e. all zeros) marks the end of the data. */
+        constexpr size_t block_header_size = 8;
+
+        //! the (uncompressed) size of the blocks accumulated by the WriterUnbuffered class
+        /*! Compressing each streamline into a block of its own would defeat
+         * the purpose of compression; streamlines are therefore buffered
+         * until at least this many bytes of encoded data are available. This
+         * is kept small, since many such writers may be open at once (e.g. in
+         * connectome2tck); being twice the size of the zlib window, larger
+         * blocks would improve compression only marginally. */
+        constexpr size_t block_size = 65536;
+
+        //! the quantisation step (in mm) to use when writing compressed files
+        double precision ();
+
+
+
+        //! accumulates streamlines into a compressed block
+        class Encoder { NOMEMALIGN
+          public:
+            Encoder (double precision) : scale (1.0 / precision) { }
+
+            //! add a streamline of \a num_points points to the block
+            template <class PointType>
+              void add (const PointType* points, size_t num_points)
+              {
+                put (num_points);
+                int64_t previous[3] = { 0, 0, 0 }, step[3] = { 0, 0, 0 };
+                for (size_t n = 0; n < num_points; ++n) {
+                  for (size_t axis = 0; axis < 3; ++axis) {
+                    const int64_t current = std::llround (points[n][axis] * scale);
+                    put (zigzag (current - previous[axis] - step[axis]));
+                    step[axis] = current - previous[axis];
+                    previous[axis] = current;
+                  }
+                }
+              }
+
+            bool empty () const { return data.empty(); }
+            //! the size of the (encoded, uncompressed) data added so far
+            size_t size () const { return data.size(); }
+
+            //! compress the streamlines added so far into \a block (including its header)
+            void compress (vector<uint8_t>& block);
+
+          protected:
+            const double scale;
+            vector<uint8_t> data;
+
+            static uint64_t zigzag (int64_t value) { return (uint64_t(value) << 1) ^ uint64_t(value >> 63); }
+
+            void put (uint64_t value) {
+              while (value >= 0x80) {
+                data.push_back (uint8_t (value) | 0x80);
+                value >>= 7;
+              }
+              data.push_back (uint8_t (value));
+            }
+        };
+
+
+
+        //! reads compressed blocks, and decodes the streamlines they contain
+        class Decoder { NOMEMALIGN
+          public:
+            Decoder () : precision (0.0), pos (0) { }
+
+            void set_precision (double value) { precision = value; }
+
+            //! decode the next streamline into \a tck, loading a new block from \a in if required
+            /*! \returns false once the end of the data has been reached */
+            template <typename ValueType>
+              bool next (std::istream& in, Streamline<ValueType>& tck)
+              {
+                tck.clear();
+                if (pos >= data.size() && !load (in))
+                  return false;
+
+                const size_t num_points = get();
+                tck.reserve (num_points);
+                int64_t current[3] = { 0, 0, 0 }, step[3] = { 0, 0, 0 };
+                for (size_t n = 0; n < num_points; ++n) {
+                  for (size_t axis = 0; axis < 3; ++axis) {
+                    step[axis] += unzigzag (get());
+                    current[axis] += step[axis];
+                  }
+                  tck.push_back ({ ValueType (current[0] * precision), ValueType (current[1] * precision), ValueType (current[2] * precision) });
+                }
+                if (pos > data.size())
+                  throw Exception ("malformed compressed streamline data");
+                return true;
+              }
+
+          protected:
+            double precision;
+            vector<uint8_t> data;
+            size_t pos;
+
+            static int64_t unzigzag (uint64_t value) { return int64_t (value >> 1) ^ -int64_t (value & 1); }
+
+            uint64_t get () {
+              uint64_t value = 0;
+              for (size_t shift = 0; pos < data.size() && shift < 64; shift += 7) {
+                const uint8_t byte = data[pos++];
+                value |= uint64_t (byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                  return value;
+              }
+              // ensure malformed or truncated data are detected:
+              pos = data.size() + 1;
+              return value;
+            }
+
+            //! load & uncompress the next block; returns false at the end of the data
+            bool load (std::istream& in);
+        };
+
+      }
+
+
+    }
+  }
+}
+
+
+#endif
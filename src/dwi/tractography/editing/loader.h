@@ -43,7 +43,7 @@ namespace MR {
             Loader (const vector<std::string>& files) :
               file_list (files),
               dummy_properties (),
-              reader (new Reader<> (file_list[0], dummy_properties)),
+              reader (open_reader<> (file_list[0], dummy_properties)),
               file_index (0) { }
 
             bool operator() (Streamline<>&);
@@ -52,7 +52,7 @@ namespace MR {
           private:
             const vector<std::string>& file_list;
             Properties dummy_properties;
-            std::unique_ptr<Reader<> > reader;
+            std::unique_ptr<ReaderInterface<float> > reader;
             size_t file_index;
 
         };
@@ -68,7 +68,7 @@ namespace MR {
 
           while (++file_index != file_list.size()) {
             dummy_properties.clear();
-            reader.reset (new Reader<> (file_list[file_index], dummy_properties));
+            reader = open_reader<> (file_list[file_index], dummy_properties);
             if ((*reader) (out))
               return true;
           }
@@ -17,15 +17,21 @@
 #ifndef __dwi_tractography_file_h__
 #define __dwi_tractography_file_h__
 
+#include <atomic>
 #include <map>
 
 #include "app.h"
+#include "raw.h"
 #include "types.h"
 #include "memory.h"
 #include "file/config.h"
 #include "file/key_value.h"
+#include "file/mmap.h"
 #include "file/ofstream.h"
+#include "file/utils.h"
+#include "dwi/tractography/compression.h"
 #include "dwi/tractography/file_base.h"
+#include "dwi/tractography/file_index.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
 
@@ -43,6 +49,8 @@ namespace MR
       { NOMEMALIGN
         public:
           virtual bool operator() (Streamline<ValueType>&) = 0;
+          //! whether operator() can safely be invoked from multiple threads concurrently
+          virtual bool concurrent () const { return false; }
           virtual ~ReaderInterface() { }
       };
 
@@ -67,6 +75,8 @@ namespace MR
           Reader (const std::string& file, Properties& properties)
           {
             open (file, "tracks", properties);
+            if (compressed)
+              decoder.set_precision (precision);
             auto opt = App::get_options ("tck_weights_in");
             if (opt.size())
               weights = load_vector<ValueType> (opt[0][0]);
@@ -80,6 +90,14 @@ namespace MR
               if (!in.is_open())
                 return false;
 
+              if (compressed) {
+                if (decoder.next (in, tck))
+                  return finalise (tck);
+                in.close();
+                check_excess_weights();
+                return false;
+              }
+
               do {
                 auto p = get_next_point();
                 if (std::isinf (p[0])) {
@@ -93,27 +111,8 @@ namespace MR
                   return false;
                 }
 
-                if (std::isnan (p[0])) {
-                  tck.set_index (current_index++);
-
-                  if (weights.size()) {
-
-                    if (tck.get_index() < size_t(weights.size())) {
-                      tck.weight = weights[tck.get_index()];
-                    } else {
-                      WARN ("Streamline weights file contains less entries (" + str(weights.size()) + ") than .tck file; "
-                            "ceasing reading of streamline data");
-                      in.close();
-                      tck.clear();
-                      return false;
-                    }
-
-                  } else {
-                    tck.weight = 1.0;
-                  }
-
-                  return true;
-                }
+                if (std::isnan (p[0]))
+                  return finalise (tck);
 
                 tck.push_back (p);
               } while (in.good());
@@ -128,8 +127,35 @@ namespace MR
           using __ReaderBase__::in;
           using __ReaderBase__::dtype;
           using __ReaderBase__::current_index;
+          using __ReaderBase__::compressed;
+          using __ReaderBase__::precision;
 
           Eigen::Matrix<ValueType, Eigen::Dynamic, 1> weights;
+          Compression::Decoder decoder;
+
+          //! set the index & weight of a newly read streamline
+          bool finalise (Streamline<ValueType>& tck)
+          {
+            tck.set_index (current_index++);
+
+            if (weights.size()) {
+
+              if (tck.get_index() < size_t(weights.size())) {
+                tck.weight = weights[tck.get_index()];
+              } else {
+                WARN ("Streamline weights file contains less entries (" + str(weights.size()) + ") than .tck file; "
+                      "ceasing reading of streamline data");
+                in.close();
+                tck.clear();
+                return false;
+              }
+
+            } else {
+              tck.weight = 1.0;
+            }
+
+            return true;
+          }
 
           //! takes care of byte ordering issues
 
@@ -187,6 +213,159 @@ namespace MR
 
 
 
+      //! A class to read streamlines from a track file in any order
+      /*! The track file is memory-mapped, and the location of each streamline
+       * is obtained from the accompanying index file if available (see
+       * Tractography::Index), or by scanning the file otherwise.
+       *
+       * Streamlines can be fetched directly using read(), which does not
+       * alter the state of the reader, and so can be invoked concurrently from
+       * multiple threads. The operator() method returns the streamlines in
+       * turn (as Tractography::Reader does), but is also thread-safe, so that
+       * multiple threads can share the same reader to decode the file in
+       * parallel (e.g. using Thread::multi() for the source stage of
+       * Thread::run_queue()); note that the streamlines are then not
+       * necessarily delivered in order. */
+      template <class ValueType = float>
+      class IndexedReader : public __ReaderBase__, public ReaderInterface<ValueType>
+      { NOMEMALIGN
+        public:
+
+          //! open the \c file for reading and load header into \c properties
+          IndexedReader (const std::string& file, Properties& properties) :
+              next (0)
+          {
+            open (file, "tracks", properties);
+            in.close();
+            if (compressed)
+              throw Exception ("random access is not supported for compressed track file \"" + file + "\"");
+            mmap.reset (new File::MMap (File::Entry (data_path, data_offset)));
+            mmap->advise (File::MMap::Access::Random);
+
+            if (Index::exists (file)) {
+              try {
+                index.load (Index::path (file));
+                if (properties.find ("count") != properties.end() && to<size_t> (properties["count"]) != index.size())
+                  throw Exception ("number of entries does not match streamline count in track file header");
+                if (!index.verify (mmap->address(), mmap->size(), data_offset, dtype))
+                  throw Exception ("offsets are inconsistent with streamline data");
+              }
+              catch (Exception& e) {
+                WARN ("ignoring invalid index file \"" + Index::path (file) + "\": " + e[0]);
+                index.clear();
+              }
+            }
+            if (index.empty())
+              index.build (mmap->address(), mmap->size(), data_offset, dtype);
+            num_streamlines = index.size();
+
+            auto opt = App::get_options ("tck_weights_in");
+            if (opt.size()) {
+              weights = load_vector<ValueType> (opt[0][0]);
+              if (size_t(weights.size()) < num_streamlines) {
+                WARN ("Streamline weights file contains less entries (" + str(weights.size()) + ") than .tck file; "
+                      "only the first " + str(weights.size()) + " streamlines will be read");
+                num_streamlines = weights.size();
+              }
+              else if (size_t(weights.size()) > num_streamlines) {
+                WARN ("Streamline weights file contains more entries (" + str(weights.size()) + ") than .tck file (" + str(num_streamlines) + ")");
+              }
+            }
+          }
+
+
+          //! the number of streamlines available for reading
+          size_t size () const { return num_streamlines; }
+
+          //! fetch streamline number \a n from file
+          /*! \returns false if \a n is beyond the end of the file */
+          bool read (size_t n, Streamline<ValueType>& tck) const
+          {
+            tck.clear();
+            if (n >= num_streamlines)
+              return false;
+
+            const int64_t point_size = 3 * dtype.bytes();
+            const uint8_t* p = mmap->address() + (index[n] - data_offset);
+            const uint8_t* end = mmap->address() + mmap->size() - point_size;
+            if (n+1 < index.size())
+              tck.reserve ((index[n+1] - index[n]) / point_size - 1);
+
+            for (; p <= end; p += point_size) {
+              const auto point = get_point (p);
+              if (!point.allFinite())
+                break;
+              tck.push_back (point);
+            }
+
+            tck.set_index (n);
+            tck.weight = weights.size() ? weights[n] : 1.0;
+            return true;
+          }
+
+          //! fetch next streamline from file
+          bool operator() (Streamline<ValueType>& tck) override {
+            return read (next++, tck);
+          }
+
+          bool concurrent () const override { return true; }
+
+
+        protected:
+          using __ReaderBase__::in;
+          using __ReaderBase__::dtype;
+          using __ReaderBase__::data_path;
+          using __ReaderBase__::data_offset;
+          using __ReaderBase__::compressed;
+
+          std::unique_ptr<File::MMap> mmap;
+          Index index;
+          size_t num_streamlines;
+          std::atomic<size_t> next;
+          Eigen::Matrix<ValueType, Eigen::Dynamic, 1> weights;
+
+          //! takes care of byte ordering issues
+          Eigen::Matrix<ValueType,3,1> get_point (const uint8_t* p) const
+          {
+            switch (dtype()) {
+              case DataType::Float32LE:
+                return { ValueType(Raw::fetch_LE<float> (p)), ValueType(Raw::fetch_LE<float> (p+4)), ValueType(Raw::fetch_LE<float> (p+8)) };
+              case DataType::Float32BE:
+                return { ValueType(Raw::fetch_BE<float> (p)), ValueType(Raw::fetch_BE<float> (p+4)), ValueType(Raw::fetch_BE<float> (p+8)) };
+              case DataType::Float64LE:
+                return { ValueType(Raw::fetch_LE<double> (p)), ValueType(Raw::fetch_LE<double> (p+8)), ValueType(Raw::fetch_LE<double> (p+16)) };
+              case DataType::Float64BE:
+                return { ValueType(Raw::fetch_BE<double> (p)), ValueType(Raw::fetch_BE<double> (p+8)), ValueType(Raw::fetch_BE<double> (p+16)) };
+              default:
+                assert (0);
+                break;
+            }
+            return { NaN, NaN, NaN };
+          }
+
+          IndexedReader (const IndexedReader&) = delete;
+      };
+
+
+
+
+
+      //! open a track file for reading
+      /*! This returns an IndexedReader if the file is accompanied by an index
+       * file, and a (sequential) Reader otherwise. */
+      template <class ValueType = float>
+        std::unique_ptr<ReaderInterface<ValueType>> open_reader (const std::string& file, Properties& properties)
+        {
+          if (Index::exists (file))
+            return std::unique_ptr<ReaderInterface<ValueType>> (new IndexedReader<ValueType> (file, properties));
+          return std::unique_ptr<ReaderInterface<ValueType>> (new Reader<ValueType> (file, properties));
+        }
+
+
+
+
+
+
 
       //! class to handle unbuffered writing of tracks to file
       /*! writes track header as specified in \a properties and individual
@@ -199,6 +378,9 @@ namespace MR
        * use cases where a very large number of track files are being written
        * at once. For most applications (where typically one track file is
        * written at a time), the Writer class is more appropriate.
+       *
+       * If the TrackWriterIndex config file option is set, an index file is
+       * also written alongside the track file (see Tractography::Index).
        * */
       template <class ValueType = float>
         class WriterUnbuffered : public __WriterBase__<ValueType>, public WriterInterface<ValueType>
@@ -212,15 +394,22 @@ namespace MR
           using __WriterBase__<ValueType>::verify_stream;
           using __WriterBase__<ValueType>::update_counts;
           using __WriterBase__<ValueType>::open_success;
+          using __WriterBase__<ValueType>::precision;
 
           using vector_type = Eigen::Matrix<ValueType,3,1>;
 
           //! create a new track file with the specified properties
+          /*! If the file name uses the .tckz suffix, the streamline data will
+           * be compressed (see Tractography::Compression). */
           WriterUnbuffered (const std::string& file, const Properties& properties) :
               __WriterBase__<ValueType> (file) {
 
-            if (!Path::has_suffix (name, ".tck"))
-              throw Exception ("output track files must use the .tck suffix");
+            if (Path::has_suffix (name, ".tckz")) {
+              precision = Compression::precision();
+              encoder.reset (new Compression::Encoder (precision));
+            }
+            else if (!Path::has_suffix (name, ".tck"))
+              throw Exception ("output track files must use the .tck or .tckz suffix");
 
             File::OFStream out;
             try {
@@ -236,20 +425,55 @@ namespace MR
             create (out, properties, "tracks");
             barrier_addr = out.tellp();
 
-            vector_type x;
-            format_point (barrier(), x);
-            out.write (reinterpret_cast<char*> (&x[0]), sizeof (x));
+            if (encoder) {
+              const vector<uint8_t> end_of_data (Compression::block_header_size, 0);
+              out.write (reinterpret_cast<const char*> (end_of_data.data()), end_of_data.size());
+            }
+            else {
+              vector_type x;
+              format_point (barrier(), x);
+              out.write (reinterpret_cast<char*> (&x[0]), sizeof (x));
+            }
             if (!out.good())
               throw Exception ("error writing tracks file \"" + name + "\": " + strerror (errno));
             open_success = true;
 
+            if (Index::write_enabled() && !encoder) {
+              index_name = Index::path (name);
+              Index::create (index_name);
+            }
+            else if (Index::exists (name)) {
+              // any existing index file would no longer match the track file:
+              File::remove (Index::path (name));
+            }
+
             auto opt = App::get_options ("tck_weights_out");
             if (opt.size())
               set_weights_path (opt[0][0]);
           }
 
+          //! commits any streamlines still held by the encoder to file
+          ~WriterUnbuffered () {
+            try { commit_block(); }
+            catch (Exception& e) { e.display(); }
+          }
+
           //! append track to file
+          /*! For compressed files, streamlines are accumulated in the
+           * encoder, and only committed to file once the block reaches
+           * Compression::block_size bytes (or on destruction). */
           bool operator() (const Streamline<ValueType>& tck) {
+            if (encoder) {
+              encoder->add (tck.data(), tck.size());
+              if (weights_name.size())
+                write_weights (str(tck.weight) + "\n");
+              ++count;
+              ++total_count;
+              if (encoder->size() >= Compression::block_size)
+                commit_block();
+              return true;
+            }
+
             // allocate buffer on the stack for performance:
             NON_POD_VLA (buffer, vector_type, tck.size()+2);
             for (size_t n = 0; n < tck.size(); ++n) {
@@ -258,6 +482,8 @@ namespace MR
             }
             format_point (delimiter(), buffer[tck.size()]);
 
+            if (index_name.size())
+              index_buffer.push_back (barrier_addr);
             commit (buffer, tck.size()+1);
 
             if (weights_name.size())
@@ -279,8 +505,11 @@ namespace MR
           }
 
         protected:
-          std::string weights_name;
+          std::string weights_name, index_name;
+          vector<int64_t> index_buffer;
           int64_t barrier_addr;
+          std::unique_ptr<Compression::Encoder> encoder;
+          vector<uint8_t> block;
 
           //! indicates end of track and start of new track
           vector_type delimiter () const { return { ValueType(NaN), ValueType(NaN), ValueType(NaN) }; }
@@ -312,16 +541,56 @@ namespace MR
             if (num_points == 0 || !open_success)
               return;
 
+            if (encoder) {
+              size_t start = 0;
+              for (size_t n = 0; n < num_points; ++n) {
+                if (std::isnan (data[n][0])) {
+                  encoder->add (data + start, n - start);
+                  start = n + 1;
+                }
+              }
+              commit_block();
+              return;
+            }
+
             int64_t prev_barrier_addr = barrier_addr;
 
-            format_point (barrier(), data[num_points]);
             File::OFStream out (name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+            format_point (barrier(), data[num_points]);
             out.write (reinterpret_cast<const char* const> (data+1), sizeof (vector_type) * num_points);
             verify_stream (out);
             barrier_addr = int64_t (out.tellp()) - sizeof(vector_type);
             out.seekp (prev_barrier_addr, out.beg);
             out.write (reinterpret_cast<const char* const> (data), sizeof(vector_type));
             verify_stream (out);
+
+            if (index_name.size()) {
+              Index::append (index_name, index_buffer);
+              index_buffer.clear();
+            }
+
+            update_counts (out);
+          }
+
+
+          //! compress the streamlines held by the encoder & append the block to file
+          void commit_block () {
+            if (!encoder || encoder->empty() || !open_success)
+              return;
+
+            const int64_t prev_barrier_addr = barrier_addr;
+            encoder->compress (block);
+            // as for uncompressed data, the header of the new block only
+            // overwrites the previous barrier once the rest of the data has
+            // been written:
+            block.resize (block.size() + Compression::block_header_size, 0);
+            File::OFStream out (name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+            out.write (reinterpret_cast<const char*> (block.data() + Compression::block_header_size), block.size() - Compression::block_header_size);
+            verify_stream (out);
+            barrier_addr = int64_t (out.tellp()) - Compression::block_header_size;
+            out.seekp (prev_barrier_addr, out.beg);
+            out.write (reinterpret_cast<const char*> (block.data()), Compression::block_header_size);
+            verify_stream (out);
             update_counts (out);
           }
 
@@ -358,6 +627,9 @@ namespace MR
           using WriterUnbuffered<ValueType>::format_point;
           using WriterUnbuffered<ValueType>::weights_name;
           using WriterUnbuffered<ValueType>::write_weights;
+          using WriterUnbuffered<ValueType>::index_name;
+          using WriterUnbuffered<ValueType>::index_buffer;
+          using WriterUnbuffered<ValueType>::barrier_addr;
           using vector_type = typename WriterUnbuffered<ValueType>::vector_type;
 
           //! create new RAM-buffered track file with specified properties
@@ -389,6 +661,9 @@ namespace MR
             if (buffer_size + tck.size() + 2 > buffer_capacity)
               commit ();
 
+            if (index_name.size())
+              index_buffer.push_back (barrier_addr + buffer_size * sizeof (vector_type));
+
             for (const auto& i : tck) {
               assert (i.allFinite());
               add_point (i);
@@ -26,6 +26,8 @@ namespace MR {
       {
         properties.clear();
         dtype = DataType::Undefined;
+        compressed = false;
+        precision = 0.0;
 
         const std::string firstline ("mrtrix " + type);
         File::KeyValue::Reader kv (file, firstline.c_str());
@@ -45,6 +47,12 @@ namespace MR {
           else if (key == "comment") properties.comments.push_back (kv.value());
           else if (key == "file") data_file = kv.value();
           else if (key == "datatype") dtype = DataType::parse (kv.value());
+          else if (key == "compression") {
+            if (lowercase (kv.value()) != "deflate")
+              throw Exception ("unsupported compression \"" + kv.value() + "\" in " + type + " file \"" + file + "\"");
+            compressed = true;
+          }
+          else if (key == "precision") precision = to<double> (kv.value());
           else add_line (properties[kv.key()], kv.value());
         }
 
@@ -55,6 +63,9 @@ namespace MR {
           throw Exception ("only supported datatype for tracks file are "
               "Float32LE, Float32BE, Float64LE & Float64BE (in " + type  + " file \"" + file + "\")");
 
+        if (compressed && !(precision > 0.0))
+          throw Exception ("missing or invalid precision for compressed " + type + " file \"" + file + "\"");
+
         if (data_file.empty())
           throw Exception ("missing \"files\" specification for " + type  + " file \"" + file + "\"");
 
@@ -79,6 +90,8 @@ namespace MR {
         if (!in)
           throw Exception ("error opening " + type  + " data file \"" + fname + "\": " + strerror(errno));
         in.seekg (offset);
+        data_path = fname;
+        data_offset = offset;
       }
 
     }
@@ -37,11 +37,18 @@ namespace MR
     namespace Tractography
     {
 
+      //! whether \a path uses the suffix of a track file (.tck, or .tckz if compressed)
+      inline bool is_track_file (const std::string& path)
+      {
+        return Path::has_suffix (path, ".tck") || Path::has_suffix (path, ".tckz");
+      }
+
+
       //! \cond skip
       class __ReaderBase__
       { NOMEMALIGN
         public:
-            __ReaderBase__() : current_index (0) { }
+            __ReaderBase__() : current_index (0), data_offset (0), compressed (false), precision (0.0) { }
           ~__ReaderBase__ () {
             if (in.is_open())
               in.close();
@@ -55,6 +62,10 @@ namespace MR
           std::ifstream in;
           DataType dtype;
           uint64_t current_index;
+          std::string data_path;
+          int64_t data_offset;
+          bool compressed;
+          double precision;
       };
 
 
@@ -70,7 +81,8 @@ namespace MR
               name (name),
               dtype (DataType::from<ValueType>()),
               count_offset (0),
-              open_success (false)
+              open_success (false),
+              precision (0.0)
           {
             dtype.set_byte_order_native();
             if (dtype != DataType::Float32LE && dtype != DataType::Float32BE &&
@@ -114,6 +126,8 @@ namespace MR
               for (const auto& it : properties.prior_rois)
                 out << "prior_roi: " << it.first << " " << it.second << "\n";
 
+              if (precision)
+                out << "compression: deflate\nprecision: " << str (precision, 6) << "\n";
               out << "datatype: " << dtype.specifier() << "\n";
               int64_t data_offset = int64_t(out.tellp()) + 65;
               data_offset += (4 - (data_offset % 4)) % 4;
@@ -138,6 +152,8 @@ namespace MR
             DataType dtype;
             int64_t count_offset;
             bool open_success;
+            //! the quantisation step for compressed files, zero otherwise
+            double precision;
 
 
             void verify_stream (const File::OFStream& out) {
@@ -0,0 +1,255 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <atomic>
+#include <algorithm>
+
+#include "mrtrix.h"
+#include "raw.h"
+#include "thread.h"
+#include "file/config.h"
+#include "file/key_value.h"
+#include "file/ofstream.h"
+#include "dwi/tractography/file_index.h"
+
+// the fixed size of the index file header, which precedes the offsets:
+#define TRACK_INDEX_HEADER_SIZE 64
+// the number of points processed by each thread in turn when scanning:
+#define TRACK_INDEX_SCAN_CHUNK 1048576
+
+namespace MR {
+  namespace DWI {
+    namespace Tractography {
+
+
+
+      namespace {
+
+        template <typename ValueType>
+          inline ValueType first_coordinate (const uint8_t* p, DataType dtype)
+          {
+            return dtype.is_little_endian() ? Raw::fetch_LE<ValueType> (p) : Raw::fetch_BE<ValueType> (p);
+          }
+
+        template <typename ValueType>
+          inline bool is_finite (const uint8_t* p, DataType dtype)
+          {
+            return std::isfinite (first_coordinate<ValueType> (p, dtype));
+          }
+
+        inline bool is_delimiter (const uint8_t* p, DataType dtype)
+        {
+          return dtype.bytes() == 4 ?
+            std::isnan (first_coordinate<float> (p, dtype)) :
+            std::isnan (first_coordinate<double> (p, dtype));
+        }
+
+
+
+        // locates the delimiters & barrier within successive chunks of the
+        // streamline data:
+        template <typename ValueType>
+          class Scanner { NOMEMALIGN
+            public:
+              Scanner (const uint8_t* data, int64_t num_points, DataType dtype,
+                  vector<vector<int64_t>>& delimiters, vector<int64_t>& barriers, std::atomic<size_t>& next) :
+                data (data), num_points (num_points), dtype (dtype),
+                delimiters (delimiters), barriers (barriers), next (next) { }
+
+              void execute () {
+                const int64_t point_size = 3 * sizeof (ValueType);
+                size_t n;
+                while ((n = next++) < delimiters.size()) {
+                  const int64_t end = std::min (num_points, int64_t(n+1) * TRACK_INDEX_SCAN_CHUNK);
+                  for (int64_t i = int64_t(n) * TRACK_INDEX_SCAN_CHUNK; i < end; ++i) {
+                    const uint8_t* p = data + i * point_size;
+                    if (is_finite<ValueType> (p, dtype))
+                      continue;
+                    if (is_delimiter (p, dtype)) {
+                      delimiters[n].push_back (i);
+                    }
+                    else {
+                      barriers[n] = i;
+                      break;
+                    }
+                  }
+                }
+              }
+
+            protected:
+              const uint8_t* data;
+              const int64_t num_points;
+              const DataType dtype;
+              vector<vector<int64_t>>& delimiters;
+              vector<int64_t>& barriers;
+              std::atomic<size_t>& next;
+          };
+
+
+        template <typename ValueType>
+          void scan (const uint8_t* data, int64_t num_points, DataType dtype, vector<vector<int64_t>>& delimiters, vector<int64_t>& barriers)
+          {
+            const size_t num_chunks = (num_points + TRACK_INDEX_SCAN_CHUNK - 1) / TRACK_INDEX_SCAN_CHUNK;
+            delimiters.assign (num_chunks, vector<int64_t>());
+            barriers.assign (num_chunks, -1);
+            std::atomic<size_t> next (0);
+            Scanner<ValueType> functor (data, num_points, dtype, delimiters, barriers, next);
+            const size_t nthreads = std::min (Thread::threads_to_execute(), num_chunks);
+            if (nthreads <= 1) {
+              functor.execute();
+              return;
+            }
+            auto threads = Thread::run (Thread::multi (functor, nthreads), "track file index scan");
+            threads.wait();
+          }
+
+      }
+
+
+
+
+      bool Index::write_enabled ()
+      {
+        //CONF option: TrackWriterIndex
+        //CONF default: 0 (false)
+        //CONF Whether to write an index file alongside each track file, holding
+        //CONF the location of each streamline within the file (with the same
+        //CONF name as the track file, and an additional ".idx" suffix). This
+        //CONF allows commands to access streamlines directly, and to decode
+        //CONF the file using multiple threads.
+        static const bool value = File::Config::get_bool ("TrackWriterIndex", false);
+        return value;
+      }
+
+
+
+      void Index::create (const std::string& index_path)
+      {
+        File::OFStream out (index_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        std::string header = "mrtrix track index\ndatatype: Int64LE\nfile: . " + str(TRACK_INDEX_HEADER_SIZE) + "\nEND\n";
+        assert (header.size() <= TRACK_INDEX_HEADER_SIZE);
+        header.resize (TRACK_INDEX_HEADER_SIZE, '\0');
+        out.write (header.data(), header.size());
+        if (!out.good())
+          throw Exception ("error writing track index file \"" + index_path + "\": " + strerror (errno));
+      }
+
+
+
+      void Index::append (const std::string& index_path, const vector<int64_t>& offsets)
+      {
+        vector<int64_t> data (offsets.size());
+        for (size_t n = 0; n < offsets.size(); ++n)
+          Raw::store_LE<int64_t> (offsets[n], &data[n]);
+        File::OFStream out (index_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+        out.write (reinterpret_cast<const char*> (data.data()), data.size() * sizeof (int64_t));
+        if (!out.good())
+          throw Exception ("error writing track index file \"" + index_path + "\": " + strerror (errno));
+      }
+
+
+
+      void Index::load (const std::string& index_path)
+      {
+        clear();
+        File::KeyValue::Reader kv (index_path, "mrtrix track index");
+        std::string datatype, data_file;
+        while (kv.next()) {
+          const std::string key = lowercase (kv.key());
+          if (key == "datatype") datatype = kv.value();
+          else if (key == "file") data_file = kv.value();
+        }
+        kv.close();
+
+        if (lowercase (datatype) != "int64le")
+          throw Exception ("unsupported datatype \"" + datatype + "\"");
+        const auto file = split (data_file, " \t", true);
+        if (file.size() != 2 || file[0] != ".")
+          throw Exception ("invalid \"file\" specification");
+        const int64_t offset = to<int64_t> (file[1]);
+
+        std::ifstream in (index_path, std::ios::in | std::ios::binary);
+        in.seekg (0, std::ios::end);
+        const int64_t size = int64_t (in.tellg()) - offset;
+        if (size < 0 || size % sizeof (int64_t))
+          throw Exception ("unexpected file size");
+        resize (size / sizeof (int64_t));
+        in.seekg (offset);
+        in.read (reinterpret_cast<char*> (data()), size);
+        if (!in.good())
+          throw Exception ("error reading file: " + std::string (strerror (errno)));
+        for (auto& entry : *this)
+          entry = Raw::fetch_LE<int64_t> (&entry);
+      }
+
+
+
+      void Index::build (const uint8_t* data, int64_t size, int64_t data_offset, DataType dtype)
+      {
+        clear();
+        const int64_t point_size = 3 * dtype.bytes();
+        const int64_t num_points = size / point_size;
+
+        vector<vector<int64_t>> delimiters;
+        vector<int64_t> barriers;
+        if (dtype.bytes() == 4)
+          scan<float> (data, num_points, dtype, delimiters, barriers);
+        else
+          scan<double> (data, num_points, dtype, delimiters, barriers);
+
+        // each streamline starts immediately after the previous delimiter,
+        // and ends with a delimiter of its own:
+        int64_t start = 0;
+        for (size_t n = 0; n < delimiters.size(); ++n) {
+          for (auto i : delimiters[n]) {
+            push_back (data_offset + start * point_size);
+            start = i + 1;
+          }
+          if (barriers[n] >= 0)
+            break;
+        }
+      }
+
+
+
+      bool Index::verify (const uint8_t* data, int64_t size, int64_t data_offset, DataType dtype) const
+      {
+        if (empty())
+          return true;
+        const int64_t point_size = 3 * dtype.bytes();
+        if (front() != data_offset)
+          return false;
+        for (size_t n = 1; n < this->size(); ++n) {
+          if ((*this)[n] <= (*this)[n-1] || ((*this)[n] - data_offset) % point_size)
+            return false;
+        }
+        // the last streamline must be preceded by a delimiter, and must
+        // itself be terminated within the data:
+        const int64_t last = back() - data_offset;
+        if (last >= size || (last && !is_delimiter (data + last - point_size, dtype)))
+          return false;
+        for (int64_t i = last; i + point_size <= size; i += point_size) {
+          if (is_delimiter (data + i, dtype))
+            return true;
+        }
+        return false;
+      }
+
+
+
+    }
+  }
+}
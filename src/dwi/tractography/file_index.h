@@ -0,0 +1,90 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_file_index_h__
+#define __dwi_tractography_file_index_h__
+
+#include "datatype.h"
+#include "types.h"
+#include "file/path.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+      //! the locations of the streamlines within a track file
+      /*! This holds the byte offset within the track file of the first point
+       * of each streamline, so that any streamline can be accessed directly
+       * without reading all those that precede it, and the file can be split
+       * between multiple threads for decoding.
+       *
+       * An index file can optionally be written alongside a .tck file by the
+       * Writer classes (see the TrackWriterIndex config file option); it
+       * takes the name of the track file with an additional ".idx" suffix,
+       * and consists of a short text header followed by the offsets stored as
+       * 64-bit little-endian integers. If no index file is available, the
+       * index can instead be established by scanning the streamline data
+       * (using multiple threads). */
+      class Index : public vector<int64_t>
+      { NOMEMALIGN
+        public:
+
+          //! the path of the index file accompanying the track file \a tck_path
+          static std::string path (const std::string& tck_path) { return tck_path + ".idx"; }
+
+          //! whether the track file \a tck_path is accompanied by an index file
+          static bool exists (const std::string& tck_path) { return Path::exists (path (tck_path)); }
+
+          //! whether the Writer classes should produce index files
+          static bool write_enabled ();
+
+          //! create a new (empty) index file at \a index_path
+          static void create (const std::string& index_path);
+
+          //! append \a offsets to the index file at \a index_path
+          static void append (const std::string& index_path, const vector<int64_t>& offsets);
+
+
+
+          //! load the offsets from the index file at \a index_path
+          void load (const std::string& index_path);
+
+          //! establish the offsets by scanning the streamline data
+          /*! \a data points to the first point of the streamline data, which
+           * is located at byte offset \a data_offset in the track file, and
+           * holds (at most) \a size bytes of data in format \a dtype. */
+          void build (const uint8_t* data, int64_t size, int64_t data_offset, DataType dtype);
+
+          //! check that the offsets are consistent with the streamline data
+          /*! This performs a quick sanity check, to detect index files that
+           * do not (or no longer) correspond to the track file; the arguments
+           * are as for build(). */
+          bool verify (const uint8_t* data, int64_t size, int64_t data_offset, DataType dtype) const;
+      };
+
+
+
+    }
+  }
+}
+
+
+#endif
@@ -18,8 +18,14 @@
 #define __dwi_tractography_mapping_loader_h__
 
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <tuple>
+
 #include "memory.h"
 #include "progressbar.h"
+#include "thread.h"
 #include "thread_queue.h"
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/streamline.h"
@@ -32,36 +38,129 @@ namespace MR {
 
 
 
+        //! a source functor for Thread::run_queue(), feeding streamlines from a track file
+        /*! If the reader allows concurrent reads (as the IndexedReader does),
+         * multiple copies of the loader are run to decode the file in
+         * parallel. The pipeline should be launched through run_queue(),
+         * for example:
+         * \code
+         * loader.run_queue (Thread::batch (Streamline<>()), Thread::multi (mapper), ...);
+         * \endcode
+         * The copies then only count the streamlines they have read; the
+         * ProgressBar is updated and displayed exclusively from the thread
+         * that called run_queue(), or directly from the main thread if the
+         * loader is invoked there without it. */
         class TrackLoader
         { MEMALIGN(TrackLoader)
 
           public:
-            TrackLoader (Reader<>& file, const size_t to_load = 0, const std::string& msg = "mapping tracks to image") :
+            TrackLoader (ReaderInterface<float>& file, const size_t to_load = 0, const std::string& msg = "mapping tracks to image") :
               reader (file),
               tracks_to_load (to_load),
-              progress (msg.size() ? new ProgressBar (msg, tracks_to_load) : nullptr) { }
+              shared (std::make_shared<Shared> (msg, tracks_to_load)),
+              pending (0) { }
+
+            TrackLoader (const TrackLoader& that) :
+              reader (that.reader),
+              tracks_to_load (that.tracks_to_load),
+              shared (that.shared),
+              pending (0) { }
 
             virtual ~TrackLoader() { }
             virtual bool operator() (Streamline<>& out)
             {
-              if (!reader (out)) {
-                progress.reset();
-                return false;
-              }
-              if (tracks_to_load && out.get_index() >= tracks_to_load) {
+              if (!reader (out) || (tracks_to_load && out.get_index() >= tracks_to_load)) {
                 out.clear();
-                progress.reset();
+                update_progress();
+                if (std::this_thread::get_id() == App::main_thread_ID) {
+                  show_progress();
+                  shared->progress.reset();
+                }
                 return false;
               }
-              if (progress)
-                ++(*progress);
+              if (++pending == progress_batch_size)
+                update_progress();
               return true;
             }
 
+            //! the number of threads worth running this loader in
+            /*! Decoding streamlines is cheap compared to most processing
+             * applied to them, so only a fraction of the available threads
+             * are used (and only one if the reader is sequential). */
+            size_t num_threads () const {
+              return reader.concurrent() ? std::max (Thread::threads_to_execute() / 4, size_t(1)) : 1;
+            }
+
+            //! run a Thread::run_queue() pipeline fed by this loader
+            /*! The remaining \a stages are passed to Thread::run_queue()
+             * after num_threads() copies of this loader. The pipeline runs in
+             * a separate thread, while the calling thread updates the
+             * ProgressBar until it completes. */
+            template <class... Stages>
+              void run_queue (Stages&&... stages)
+              {
+                auto source = Thread::multi (*this, num_threads());
+                Pipeline<decltype(source), Stages...> pipeline (std::move (source), std::forward<Stages> (stages)...);
+                auto thread = Thread::run (pipeline, "track loader pipeline");
+                while (!thread.finished()) {
+                  show_progress();
+                  std::this_thread::sleep_for (std::chrono::milliseconds (10));
+                }
+                thread.wait();
+                show_progress();
+                shared->progress.reset();
+              }
+
           protected:
-            Reader<>& reader;
+            class Shared
+            { NOMEMALIGN
+              public:
+                Shared (const std::string& msg, const size_t to_load) :
+                  progress (msg.size() ? new ProgressBar (msg, to_load) : nullptr),
+                  count (0),
+                  displayed (0) { }
+                std::unique_ptr<ProgressBar> progress;
+                std::atomic<size_t> count;
+                size_t displayed;
+            };
+
+            template <class... Stages>
+              class Pipeline
+              { NOMEMALIGN
+                public:
+                  Pipeline (Stages&&... stages) : stages (std::forward<Stages> (stages)...) { }
+                  void execute () { run (typename seq<sizeof...(Stages)>::type()); }
+                private:
+                  template <size_t...> struct indices { NOMEMALIGN };
+                  template <size_t N, size_t... I> struct seq : seq<N-1, N-1, I...> { NOMEMALIGN };
+                  template <size_t... I> struct seq<0, I...> { NOMEMALIGN using type = indices<I...>; };
+                  template <size_t... I>
+                    void run (indices<I...>) { Thread::run_queue (std::forward<Stages> (std::get<I> (stages))...); }
+                  std::tuple<Stages&&...> stages;
+              };
+
+            static constexpr size_t progress_batch_size = 64;
+
+            ReaderInterface<float>& reader;
             const size_t tracks_to_load;
-            std::unique_ptr<ProgressBar> progress;
+            std::shared_ptr<Shared> shared;
+            size_t pending;
+
+            void update_progress () {
+              shared->count += pending;
+              pending = 0;
+              // the loader may also be invoked directly from the main thread:
+              if (std::this_thread::get_id() == App::main_thread_ID)
+                show_progress();
+            }
+
+            void show_progress () {
+              if (!shared->progress)
+                return;
+              const size_t count = shared->count;
+              for (; shared->displayed < count; ++shared->displayed)
+                ++(*shared->progress);
+            }
 
         };
 
@@ -14,6 +14,7 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+
 #include "dwi/tractography/rng.h"
 
 namespace MR
@@ -23,9 +24,33 @@ namespace MR
     namespace Tractography
     {
 
-      thread_local Math::RNG rng;
+      thread_local RNG rng;
+
+
+
+      void RNG::generate ()
+      {
+        std::array<uint32_t,4> x (counter);
+        std::array<uint32_t,2> k (key);
+        for (size_t round = 0; round != 10; ++round) {
+          if (round) {
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+          }
+          const uint64_t p0 = uint64_t (0xD2511F53) * x[0];
+          const uint64_t p1 = uint64_t (0xCD9E8D57) * x[2];
+          x = { uint32_t (p1 >> 32) ^ x[1] ^ k[0], uint32_t (p1),
+                uint32_t (p0 >> 32) ^ x[3] ^ k[1], uint32_t (p0) };
+        }
+        block = x;
+        position = 0;
+        // the lower 64 bits of the counter index successive blocks within the stream:
+        if (!++counter[0])
+          ++counter[1];
+      }
 
     }
   }
 }
 
+
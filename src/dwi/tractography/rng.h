@@ -14,9 +14,13 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+
 #ifndef __dwi_tractography_rng_h__
 #define __dwi_tractography_rng_h__
 
+#include <array>
+#include <cstdint>
+
 #include "math/rng.h"
 
 namespace MR
@@ -26,8 +30,51 @@ namespace MR
     namespace Tractography
     {
 
+      //! random number generator used for tracking
+      /*! By default, this behaves exactly as Math::RNG. Once set_stream() has
+       * been invoked, values are instead drawn from the Philox4x32-10
+       * counter-based generator (Salmon et al., SC'11): the sequence is then
+       * fully determined by the key and stream number provided, independently
+       * of anything previously drawn in this thread. This allows each seed to
+       * be given its own reproducible stream of random numbers, regardless of
+       * which thread ends up processing it. */
+      class RNG : public Math::RNG
+      { NOMEMALIGN
+        public:
+          RNG () : use_stream (false), position (4) { }
+          RNG (const RNG& that) : Math::RNG (that), use_stream (false), position (4) { }
+
+          result_type operator() () {
+            if (!use_stream)
+              return Math::RNG::operator() ();
+            if (position == 4)
+              generate();
+            return block[position++];
+          }
+
+          //! draw all subsequent values from stream \a number under key \a key
+          /*! different \a substream values yield independent sequences for
+           * the same stream number. */
+          void set_stream (const uint32_t key, const uint64_t number, const uint32_t substream = 0) {
+            use_stream = true;
+            this->key = { key, substream };
+            counter = { 0, 0, uint32_t (number), uint32_t (number >> 32) };
+            position = 4;
+          }
+
+        private:
+          bool use_stream;
+          size_t position;
+          std::array<uint32_t,2> key;
+          std::array<uint32_t,4> counter, block;
+
+          void generate ();
+      };
+
+
+
       //! thread-local, but globally accessible RNG to vastly simplify multi-threading
-      extern thread_local Math::RNG rng;
+      extern thread_local RNG rng;
 
     }
   }
@@ -16,7 +16,11 @@
 
 #include "dwi/tractography/seeding/dynamic.h"
 
+#include <zlib.h>
+
 #include "app.h"
+#include "algo/loop.h"
+#include "file/ofstream.h"
 #include "dwi/fmls.h"
 #include "math/SH.h"
 #include "dwi/tractography/rng.h"
@@ -27,6 +31,17 @@
 #include "fixel/legacy/image.h"
 
 
+// layout of the checkpoint file: 16 bytes of magic number, then (in native
+// byte order) a byte order mark, the format version, the checksum of the
+// fixel segmentation, the number of fixels, the track count, the numbers of
+// samples & seeds drawn, and the total track density; this is followed by the
+// state of each fixel (see Fixel_TD_seed::State):
+#define DYNAMIC_SEED_CHECKPOINT_MAGIC "mrtrix dynseed\n"
+#define DYNAMIC_SEED_CHECKPOINT_BYTE_ORDER_MARK 0x01020304U
+#define DYNAMIC_SEED_CHECKPOINT_VERSION 1U
+#define DYNAMIC_SEED_CHECKPOINT_HEADER_SIZE 72
+
+
 
 namespace MR
 {
@@ -39,6 +54,25 @@ namespace MR
 
 
 
+      namespace {
+
+        class CheckpointHeader
+        { NOMEMALIGN
+          public:
+            char magic[16];
+            uint32_t byte_order_mark, version;
+            uint32_t checksum, unused;
+            uint64_t num_fixels;
+            uint64_t track_count, attempts, seeds;
+            double TD_sum;
+        };
+        static_assert (sizeof (CheckpointHeader) == DYNAMIC_SEED_CHECKPOINT_HEADER_SIZE, "unexpected padding in dynamic seeding checkpoint header");
+        static_assert (sizeof (Fixel_TD_seed::State) == 32, "unexpected padding in dynamic seeding checkpoint fixel state");
+
+      }
+
+
+
 
       bool Dynamic_ACT_additions::check_seed (Eigen::Vector3f& p)
       {
@@ -365,6 +399,102 @@ namespace MR
 
 
 
+      vector<size_t> Dynamic::fixel_order() const
+      {
+        // The order in which fixels are stored depends on the order in which voxels
+        //   were segmented, which varies between runs due to multi-threading
+        vector<size_t> order;
+        order.reserve (fixels.size() - 1);
+        VoxelAccessor v (accessor());
+        for (auto l = Loop (v) (v); l; ++l) {
+          for (Fixel_map<Fixel>::ConstIterator i = begin (v); i; ++i)
+            order.push_back (i);
+        }
+        return order;
+      }
+
+
+
+      uint32_t Dynamic::checksum (const vector<size_t>& order) const
+      {
+        // Confirms that the checkpoint was generated from the same FOD image & segmentation
+        uLong crc = crc32 (0L, Z_NULL, 0);
+        for (const auto i : order) {
+          const float values[2] = { float(fixels[i].get_FOD()), float(fixels[i].get_weight()) };
+          crc = crc32 (crc, reinterpret_cast<const Bytef*> (values), sizeof (values));
+          crc = crc32 (crc, reinterpret_cast<const Bytef*> (fixels[i].get_voxel().data()), 3 * sizeof (int));
+        }
+        return crc;
+      }
+
+
+
+      void Dynamic::save (const std::string& path) const
+      {
+        const auto order = fixel_order();
+        CheckpointHeader H;
+        memset (&H, 0, sizeof (H));
+        memcpy (H.magic, DYNAMIC_SEED_CHECKPOINT_MAGIC, sizeof (DYNAMIC_SEED_CHECKPOINT_MAGIC));
+        H.byte_order_mark = DYNAMIC_SEED_CHECKPOINT_BYTE_ORDER_MARK;
+        H.version = DYNAMIC_SEED_CHECKPOINT_VERSION;
+        H.checksum = checksum (order);
+        H.num_fixels = order.size();
+        H.track_count = std::min (track_count.load(), target_trackcount);
+        H.attempts = attempts;
+        H.seeds = seeds;
+        H.TD_sum = SIFT::ModelBase<Fixel_TD_seed>::TD_sum;
+
+        vector<Fixel::State> states;
+        states.reserve (order.size());
+        for (const auto i : order)
+          states.push_back (fixels[i].get_state());
+
+        File::OFStream out (path, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write (reinterpret_cast<const char*> (&H), sizeof (H));
+        out.write (reinterpret_cast<const char*> (states.data()), states.size() * sizeof (Fixel::State));
+        // close explicitly so that any error flushing buffered data is caught:
+        out.close();
+        if (out.fail())
+          throw Exception ("error writing dynamic seeding checkpoint file \"" + path + "\": " + strerror (errno));
+        INFO ("dynamic seeding state after " + str(H.track_count) + " tracks written to file \"" + path + "\"");
+      }
+
+
+
+      void Dynamic::resume (const std::string& path)
+      {
+        std::ifstream in (path, std::ios::in | std::ios::binary);
+        if (!in)
+          throw Exception ("error opening dynamic seeding checkpoint file \"" + path + "\": " + strerror (errno));
+        CheckpointHeader H;
+        in.read (reinterpret_cast<char*> (&H), sizeof (H));
+        if (!in.good() || memcmp (H.magic, DYNAMIC_SEED_CHECKPOINT_MAGIC, sizeof (DYNAMIC_SEED_CHECKPOINT_MAGIC)) ||
+            H.byte_order_mark != DYNAMIC_SEED_CHECKPOINT_BYTE_ORDER_MARK || H.version != DYNAMIC_SEED_CHECKPOINT_VERSION)
+          throw Exception ("file \"" + path + "\" is not a dynamic seeding checkpoint file");
+        const auto order = fixel_order();
+        if (H.num_fixels != order.size() || H.checksum != checksum (order))
+          throw Exception ("dynamic seeding checkpoint file \"" + path + "\" was not generated from FOD image \"" + Base::get_name() + "\"");
+
+        vector<Fixel::State> states (H.num_fixels);
+        in.read (reinterpret_cast<char*> (states.data()), states.size() * sizeof (Fixel::State));
+        if (!in.good())
+          throw Exception ("error reading dynamic seeding checkpoint file \"" + path + "\"");
+        for (size_t n = 0; n != order.size(); ++n)
+          fixels[order[n]].set_state (states[n]);
+
+        SIFT::ModelBase<Fixel_TD_seed>::TD_sum = H.TD_sum;
+        track_count = H.track_count;
+        attempts = H.attempts;
+        seeds = H.seeds;
+        target_trackcount += H.track_count;
+        INFO ("dynamic seeding resumed from state after " + str(H.track_count) + " tracks in file \"" + path + "\"");
+      }
+
+
+
+
+
+
         bool WriteKernelDynamic::operator() (const Tracking::GeneratedTrack& in, Tractography::Streamline<>& out)
         {
           out.set_index (writer.count);
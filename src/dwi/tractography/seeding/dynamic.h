@@ -166,6 +166,26 @@ namespace MR
           size_t get_seed_count() const { return seed_count; }
 
 
+          // The evolving state of the fixel, as stored in dynamic seeding checkpoint files
+          class State
+          { NOMEMALIGN
+            public:
+              double TD;
+              float old_prob, applied_prob;
+              uint64_t track_count_at_last_update, seed_count;
+          };
+
+          State get_state() const { return { get_TD(), old_prob, applied_prob, track_count_at_last_update, seed_count }; }
+          void set_state (const State& state)
+          {
+            TD.store (state.TD, std::memory_order_relaxed);
+            old_prob = state.old_prob;
+            applied_prob = state.applied_prob;
+            track_count_at_last_update = state.track_count_at_last_update;
+            seed_count = state.seed_count;
+          }
+
+
 
         private:
           Eigen::Vector3i voxel;
@@ -224,6 +244,14 @@ namespace MR
         bool get_seed (Eigen::Vector3f&) const override;
         bool get_seed (Eigen::Vector3f&, Eigen::Vector3f&) override;
 
+        // Save the state of the seeder to file, so that tracking can subsequently be resumed
+        //   from that point (i.e. tckgen -seed_dynamic_checkpoint)
+        void save (const std::string& path) const;
+        // Restore the state of the seeder from file (i.e. tckgen -seed_dynamic_resume);
+        //   the requested number of tracks is then generated in addition to those already
+        //   accounted for in that state
+        void resume (const std::string& path);
+
         // Although the ModelBase version of this function is OK, the Fixel_TD_seed class
         //   includes the voxel location for easier determination of seed location
         bool operator() (const FMLS::FOD_lobes&) override;
@@ -256,7 +284,7 @@ namespace MR
             using SIFT::ModelBase<Fixel>::proc_mask;
 
         // New members required for new dynamic seed probability equation
-        const size_t target_trackcount;
+        size_t target_trackcount;
         std::atomic<size_t> track_count;
 
         // Want to know statistics on dynamic seeding sampling
@@ -276,6 +304,9 @@ namespace MR
 
         void perform_fixel_masking();
 
+        vector<size_t> fixel_order() const;
+        uint32_t checksum (const vector<size_t>&) const;
+
       };
 
 
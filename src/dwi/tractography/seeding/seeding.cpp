@@ -104,7 +104,17 @@ namespace MR
         + Argument ("dir").type_sequence_float()
 
       + Option ("output_seeds", "output the seed location of all successful streamlines to a file")
-        + Argument ("path").type_file_out();
+        + Argument ("path").type_file_out()
+
+      + Option ("seed_dynamic_checkpoint", "save the state of the dynamic seeding mechanism to file on completion, "
+                                           "so that tracking can subsequently be resumed from that point using -seed_dynamic_resume")
+        + Argument ("path").type_file_out()
+
+      + Option ("seed_dynamic_resume", "resume dynamic seeding from the state saved in a checkpoint file (see -seed_dynamic_checkpoint); "
+                                       "the number of streamlines requested via -select is then generated in addition to those "
+                                       "already accounted for in that state, though only the new streamlines are written to the output file. "
+                                       "The same FOD image must be provided to the -seed_dynamic option.")
+        + Argument ("path").type_file_in();
 
 
 
@@ -189,6 +199,16 @@ namespace MR
 
         opt = get_options ("output_seeds");
         if (opt.size()) properties["seed_output"] = std::string (opt[0][0]);
+
+        opt = get_options ("seed_dynamic_checkpoint");
+        if (opt.size()) properties["seed_checkpoint"] = std::string (opt[0][0]);
+
+        opt = get_options ("seed_dynamic_resume");
+        if (opt.size()) properties["seed_resume"] = std::string (opt[0][0]);
+
+        if (properties.find ("seed_dynamic") == properties.end() &&
+            (properties.find ("seed_checkpoint") != properties.end() || properties.find ("seed_resume") != properties.end()))
+          throw Exception ("Options -seed_dynamic_checkpoint and -seed_dynamic_resume are only applicable to dynamic seeding");
       }
 
 
@@ -66,7 +66,10 @@ namespace MR
                 typename Method::Shared shared (diff_path, properties);
                 WriteKernel writer (shared, destination, properties);
                 Exec<Method> tracker (shared);
-                Thread::run_queue (Thread::multi (tracker), Thread::batch (GeneratedTrack(), TRACKING_BATCH_SIZE), writer);
+                if (block_size (shared) == 1)
+                  Thread::run_queue (Thread::multi (tracker), GeneratedTrack(), writer);
+                else
+                  Thread::run_queue (Thread::multi (tracker), Thread::batch (GeneratedTrack(), TRACKING_BATCH_SIZE), writer);
 
               } else {
 
@@ -85,6 +88,8 @@ namespace MR
                 Math::SH::check (fod_data);
                 Seeding::Dynamic* seeder = new Seeding::Dynamic (fod_path, fod_data, num_tracks, dirs);
                 properties.seeds.add (seeder); // List is responsible for deleting this from memory
+                if (properties.find ("seed_resume") != properties.end())
+                  seeder->resume (properties["seed_resume"]);
 
                 typename Method::Shared shared (diff_path, properties);
 
@@ -104,6 +109,9 @@ namespace MR
                     Thread::batch (SetDixel(), TRACKING_BATCH_SIZE),
                     *seeder);
 
+                if (properties.find ("seed_checkpoint") != properties.end())
+                  seeder->save (properties["seed_checkpoint"]);
+
               }
 
             }
@@ -114,13 +122,19 @@ namespace MR
               S (shared),
               method (shared),
               track_excluded (false),
-              include_visitation (S.properties.include, S.properties.ordered_include) { }
+              include_visitation (S.properties.include, S.properties.ordered_include),
+              seeds_per_block (block_size (shared)),
+              block_start (0),
+              block_index (seeds_per_block) { }
 
             Exec (const Exec& that) :
               S (that.S),
               method (that.method),
               track_excluded (false),
-              include_visitation (S.properties.include, S.properties.ordered_include) { }
+              include_visitation (S.properties.include, S.properties.ordered_include),
+              seeds_per_block (that.seeds_per_block),
+              block_start (0),
+              block_index (seeds_per_block) { }
 
 
             bool operator() (GeneratedTrack& item) {
@@ -152,6 +166,13 @@ namespace MR
             bool track_excluded;
             IncludeROIVisitation include_visitation;
 
+            // For reproducible tracking: the block of seed numbers currently being
+            //   processed by this thread, and for number-limited seeders, their seeds
+            const size_t seeds_per_block;
+            uint64_t block_start;
+            size_t block_index;
+            vector<std::pair<Eigen::Vector3f, Eigen::Vector3f>> block_seeds;
+
 
             term_t iterate ()
             {
@@ -194,7 +215,7 @@ namespace MR
 
               if (S.properties.seeds.is_finite()) {
 
-                if (!S.properties.seeds.get_seed (method.pos, method.dir))
+                if (!get_finite_seed (tck))
                   return false;
                 if (!method.check_seed() || !method.init()) {
                   track_excluded = true;
@@ -204,6 +225,8 @@ namespace MR
 
               } else {
 
+                if (S.sequencer && !start_stream (tck))
+                  return false;
                 for (size_t num_attempts = 0; num_attempts != MAX_NUM_SEED_ATTEMPTS; ++num_attempts) {
                   if (S.properties.seeds.get_seed (method.pos, method.dir)) {
                     if (!(method.check_seed() && method.init())) {
@@ -214,9 +237,76 @@ namespace MR
                   }
                 }
                 FAIL ("Failed to find suitable seed point after " + str (MAX_NUM_SEED_ATTEMPTS) + " attempts - aborting");
+                // The writer would otherwise wait indefinitely for this seed
+                if (S.sequencer)
+                  S.sequencer->stop();
+                return false;
+
+              }
+            }
+
+
+
+            bool get_finite_seed (GeneratedTrack& tck)
+            {
+              if (!S.sequencer)
+                return S.properties.seeds.get_seed (method.pos, method.dir);
+              if (!start_stream (tck))
+                return false;
+              // Seeder exhausted part-way through this block?
+              if (block_index > block_seeds.size())
+                return false;
+              method.pos = block_seeds[block_index-1].first;
+              method.dir = block_seeds[block_index-1].second;
+              return true;
+            }
+
+
+
+            // Draw all random numbers for this seed from its own stream,
+            //   so that the outcome does not depend on which thread processes it
+            bool start_stream (GeneratedTrack& tck)
+            {
+              if (block_index == seeds_per_block && !next_block())
                 return false;
+              const uint64_t number = block_start + block_index++;
+              tck.set_seed_number (number);
+              rng.set_stream (S.sequencer->key(), number);
+              return true;
+            }
+
+
 
+            // For reproducible tracking, seed numbers are reserved in blocks coinciding
+            //   with the batches sent to the writer, so that a thread never waits for the
+            //   writer to catch up while holding back a partially-filled batch; if batch
+            //   sizes are adapted at runtime, tracks must instead be sent individually
+            static size_t block_size (const SharedBase& shared)
+            {
+              return (shared.sequencer && Thread::queue_batch_is_adaptive()) ? 1 : TRACKING_BATCH_SIZE;
+            }
+
+            bool next_block ()
+            {
+              block_index = 0;
+              if (!S.properties.seeds.is_finite())
+                return S.sequencer->next (seeds_per_block, block_start);
+
+              // Number-limited seeders provide their seeds in a fixed sequence, which
+              //   must be matched to the seed numbers: draw those of the whole block
+              //   up-front, using a separate random number stream for each seed
+              std::lock_guard<std::mutex> lock (S.sequencer->seeding_mutex());
+              if (!S.sequencer->next (seeds_per_block, block_start))
+                return false;
+              block_seeds.clear();
+              for (size_t i = 0; i != seeds_per_block; ++i) {
+                Eigen::Vector3f p, d (NaN, NaN, NaN);
+                rng.set_stream (S.sequencer->key(), block_start + i, 1);
+                if (!S.properties.seeds.get_seed (p, d))
+                  break;
+                block_seeds.push_back (std::make_pair (p, d));
               }
+              return true;
             }
 
 
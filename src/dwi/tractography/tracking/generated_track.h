@@ -44,12 +44,15 @@ namespace MR
 
             enum class status_t { INVALID, SEED_REJECTED, TRACK_REJECTED, ACCEPTED };
 
-            GeneratedTrack() : seed_index (0), status (status_t::INVALID) { }
+            GeneratedTrack() : seed_index (0), seed_number (0), status (status_t::INVALID) { }
+            // Note: the seed number is retained, as it still identifies a rejected streamline
             void clear() { BaseType::clear(); seed_index = 0; status = status_t::INVALID; }
             size_t get_seed_index() const { return seed_index; }
+            uint64_t get_seed_number() const { return seed_number; }
             status_t get_status() const { return status; }
             void reverse() { std::reverse (begin(), end()); seed_index = (size()-1) - seed_index; }
             void set_seed_index (const size_t i) { seed_index = i; }
+            void set_seed_number (const uint64_t i) { seed_number = i; }
             void set_status (const status_t i) { status = i; }
 
             float length (const float step_size) const
@@ -85,6 +88,7 @@ namespace MR
 
           private:
             size_t seed_index;
+            uint64_t seed_number; // only used for reproducible tracking
             status_t status;
 
         };
@@ -61,8 +61,7 @@ namespace MR
             {
               if (!source.scanner (position))
                 return false;
-              for (auto l = Loop (3) (source); l; ++l)
-                values[source.index(3)] = source.value();
+              source.row (3, values);
               return !std::isnan (values[0]);
             }
 
@@ -0,0 +1,81 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#include "dwi/tractography/tracking/sequencer.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+        Sequencer::Sequencer (const uint32_t key, const size_t window, const uint64_t first) :
+            rng_key (key),
+            window (window),
+            first_number (first),
+            next_number (first),
+            num_written (first),
+            stopped (false) { }
+
+
+
+        bool Sequencer::next (const size_t count, uint64_t& first)
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          cond.wait (lock, [&] { return stopped || next_number + count <= num_written + window; });
+          if (stopped)
+            return false;
+          first = next_number;
+          next_number += count;
+          return true;
+        }
+
+
+
+        void Sequencer::written (const uint64_t number)
+        {
+          {
+            std::lock_guard<std::mutex> lock (mutex);
+            num_written = number;
+          }
+          cond.notify_all();
+        }
+
+
+
+        void Sequencer::stop ()
+        {
+          {
+            std::lock_guard<std::mutex> lock (mutex);
+            stopped = true;
+          }
+          cond.notify_all();
+        }
+
+
+
+      }
+    }
+  }
+}
+
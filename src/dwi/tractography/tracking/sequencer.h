@@ -0,0 +1,87 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#ifndef __dwi_tractography_tracking_sequencer_h__
+#define __dwi_tractography_tracking_sequencer_h__
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "memory.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+        //! hands out consecutive seed numbers for reproducible tracking
+        /*! Each tracking thread obtains the numbers of its next seeds via
+         * next(), and uses each to select the random number stream for that
+         * seed; the writer then outputs streamlines in order of seed number,
+         * reporting its progress via written(). The tracking threads are held
+         * back whenever they get more than \a window seeds ahead of the
+         * writer, which bounds the number of streamlines the writer needs to
+         * buffer. Numbering starts from \a first, so that a run can process
+         * its own portion of a larger set of seeds (see tckgen -shard). */
+        class Sequencer
+        { NOMEMALIGN
+          public:
+            Sequencer (const uint32_t key, const size_t window, const uint64_t first = 0);
+
+            uint32_t key () const { return rng_key; }
+            uint64_t first () const { return first_number; }
+
+            //! a lock to be held if the seed number must be drawn together with the seed itself
+            std::mutex& seeding_mutex () { return seeding; }
+
+            //! reserve the next \a count seed numbers, starting from \a first
+            /*! returns false once processing has stopped */
+            bool next (const size_t count, uint64_t& first);
+
+            //! record that all seeds prior to \a number have been written
+            void written (const uint64_t number);
+
+            //! release all waiting threads, and stop handing out seed numbers
+            void stop ();
+
+          private:
+            const uint32_t rng_key;
+            const size_t window;
+            const uint64_t first_number;
+            std::mutex mutex, seeding;
+            std::condition_variable cond;
+            uint64_t next_number, num_written;
+            bool stopped;
+        };
+
+
+
+      }
+    }
+  }
+}
+
+#endif
+
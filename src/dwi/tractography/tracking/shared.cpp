@@ -16,6 +16,9 @@
 
 #include "dwi/tractography/tracking/shared.h"
 
+#include "thread.h"
+#include "math/rng.h"
+
 
 namespace MR
 {
@@ -90,6 +93,16 @@ namespace MR
           if (properties.find ("downsample_factor") != properties.end())
             downsampler.set_ratio (to<int> (properties["downsample_factor"]));
 
+          if (properties.find ("reproducible") != properties.end() && to<bool> (properties["reproducible"])) {
+            if (properties.find ("seed_dynamic") != properties.end())
+              throw Exception ("Reproducible tracking cannot be used in conjunction with dynamic seeding");
+            const uint64_t first_seed = properties.find ("shard") == properties.end() ? 0 : select_shard();
+            sequencer.reset (new Sequencer (Math::RNG::base_seed(),
+                                            TRACKING_REPRODUCIBLE_WINDOW * std::max (Thread::threads_to_execute(), size_t(1)),
+                                            first_seed));
+            properties["rng_seed"] = str(sequencer->key());
+          }
+
           for (size_t i = 0; i != TERMINATION_REASON_COUNT; ++i)
             terminations[i] = 0;
           for (size_t i = 0; i != REJECTION_REASON_COUNT; ++i)
@@ -122,6 +135,40 @@ namespace MR
         }
 
 
+        uint64_t SharedBase::select_shard ()
+        {
+          const auto spec = parse_ints<uint64_t> (properties["shard"]);
+          assert (spec.size() == 2 && spec[0] < spec[1]);
+          const uint64_t index = spec[0], num_shards = spec[1];
+
+          if (!properties.seeds.is_finite()) {
+            // Each shard processes a fixed number of seeds: the shard index
+            //   then determines the seed numbers (and hence the random number
+            //   streams) to be used
+            if (implicit_max_num_seeds)
+              throw Exception ("the maximum number of seeds per shard must be set explicitly (-seeds option) when using -shard");
+            return index * max_num_seeds;
+          }
+
+          // Number-limited seeds are divided into contiguous portions of (near-)equal size
+          const uint64_t total = properties.seeds.get_total_count();
+          const uint64_t per_shard = (total + num_shards - 1) / num_shards;
+          const uint64_t first = std::min (total, index * per_shard);
+          max_num_seeds = max_num_tracks = std::min (total, first + per_shard) - first;
+          if (!max_num_seeds)
+            throw Exception ("shard " + str(index) + " of " + str(num_shards) + " holds no seeds (only " + str(total) + " seeds available)");
+          properties["max_num_seeds"] = properties["max_num_tracks"] = str(max_num_seeds);
+
+          // Skip the seeds preceding this shard, so that the seeder yields the same sequence
+          //   of seeds as it would for a single run
+          Eigen::Vector3f p, d;
+          for (uint64_t n = 0; n != first; ++n)
+            properties.seeds.get_seed (p, d);
+          return first;
+        }
+
+
+
         SharedBase::~SharedBase()
         {
           size_t sum_terminations = 0;
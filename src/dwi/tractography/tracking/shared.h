@@ -27,6 +27,7 @@
 #include "dwi/tractography/roi.h"
 #include "dwi/tractography/ACT/shared.h"
 #include "dwi/tractography/resampling/downsampler.h"
+#include "dwi/tractography/tracking/sequencer.h"
 #include "dwi/tractography/tracking/types.h"
 #include "dwi/tractography/tracking/tractography.h"
 
@@ -34,6 +35,10 @@
 // If this is enabled, images will be output in the current directory showing the density of streamline terminations due to different termination mechanisms throughout the brain
 //#define DEBUG_TERMINATIONS
 
+// For reproducible tracking, the maximal number of seeds (per thread) by
+//   which the tracking threads may run ahead of the writer
+#define TRACKING_REPRODUCIBLE_WINDOW 256
+
 
 
 namespace MR
@@ -70,6 +75,9 @@ namespace MR
             bool unidirectional, rk4, stop_on_all_include, implicit_max_num_seeds;
             DWI::Tractography::Resampling::Downsampler downsampler;
 
+            // Only set for reproducible tracking
+            std::unique_ptr<Sequencer> sequencer;
+
             // Additional members for ACT
             bool is_act() const { return bool (act_shared_additions); }
             const ACT::ACT_Shared_additions& act() const { return *act_shared_additions; }
@@ -105,6 +113,10 @@ namespace MR
 
             std::unique_ptr<ACT::ACT_Shared_additions> act_shared_additions;
 
+            //! restrict processing to the seeds of the shard requested via tckgen -shard
+            /*! returns the number of the first seed of the shard */
+            uint64_t select_shard ();
+
 #ifdef DEBUG_TERMINATIONS
             Header debug_header;
             Image<uint32_t>* debug_images[TERMINATION_REASON_COUNT];
@@ -95,7 +95,23 @@ namespace MR
 
       + Option ("downsample", "downsample the generated streamlines to reduce output file size "
                               "(default is (samples-1) for iFOD2, no downsampling for all other algorithms)")
-          + Argument ("factor").type_integer (1);
+          + Argument ("factor").type_integer (1)
+
+      + Option ("reproducible", "generate streamlines reproducibly, regardless of the number of threads used: "
+                                "each seed is given its own stream of random numbers, determined by its seed number "
+                                "and the random number generator seed (stored in the output file header as rng_seed, "
+                                "and set using the MRTRIX_RNG_SEED environment variable), and streamlines are written "
+                                "in order of seed number. Not compatible with dynamic seeding.")
+
+      + Option ("shard", "generate only shard k (counting from zero) of a tractogram split into N shards, "
+                         "for processing in separate invocations (e.g. on different machines); implies -reproducible. "
+                         "For number-limited seeding mechanisms, the seeds are divided as evenly as possible between "
+                         "the shards; otherwise, each shard processes the number of seeds set via the -seeds option, "
+                         "which must be provided. Provided each shard uses the same random number generator seed "
+                         "(MRTRIX_RNG_SEED environment variable), and no shard terminates early (e.g. due to -select), "
+                         "concatenating all shards in order (see tckmerge) yields the same streamlines as a single "
+                         "invocation processing all seeds.")
+        + Argument ("k,N").type_sequence_int();
 
 
       /**
@@ -151,6 +167,18 @@ namespace MR
         opt = get_options ("downsample");
         if (opt.size()) properties["downsample_factor"] = str<unsigned int> (opt[0][0]);
 
+        opt = get_options ("reproducible");
+        if (opt.size()) properties["reproducible"] = "1";
+
+        opt = get_options ("shard");
+        if (opt.size()) {
+          const auto shard = parse_ints<uint64_t> (opt[0][0]);
+          if (shard.size() != 2 || !shard[1] || shard[0] >= shard[1])
+            throw Exception ("invalid shard specification \"" + std::string (opt[0][0]) + "\": expected k,N with 0 <= k < N");
+          properties["shard"] = str(shard[0]) + "," + str(shard[1]);
+          properties["reproducible"] = "1";
+        }
+
         opt = get_options ("grad");
         if (opt.size()) properties["DW_scheme"] = std::string (opt[0][0]);
 
@@ -47,10 +47,52 @@ namespace MR
 
 
 
+        // Linear interpolation of all volumes at once, re-using the neighbourhood
+        //   fetched from the image for as long as successive positions fall within
+        //   the same voxel cell, as is typical of the closely-spaced samples along
+        //   candidate paths evaluated during tracking. This is only done for images
+        //   whose contents cannot change during tracking (i.e. not for adapters
+        //   such as the bootstrap used by Tensor_Prob), and only for 4D images.
+        template <class ImageType>
+          class LinearRowCache : public Interp::Linear<ImageType> { MEMALIGN(LinearRowCache<ImageType>)
+            public:
+              using value_type = typename ImageType::value_type;
+
+              LinearRowCache (const ImageType& parent, value_type value_when_out_of_bounds = Interp::Base<ImageType>::default_out_of_bounds_value()) :
+                  Interp::Linear<ImageType> (parent, value_when_out_of_bounds),
+                  cell {{ -1, -1, -1 }} { }
+
+              using Interp::Linear<ImageType>::row;
+
+              template <class VectorType>
+              void row (size_t axis, VectorType& values)
+              {
+                if (!Interp::has_direct_io<ImageType>::value || ImageType::ndim() != 4)
+                  return Interp::Linear<ImageType>::row (axis, values);
+                if (Interp::Base<ImageType>::out_of_bounds) {
+                  values.setConstant (Interp::Base<ImageType>::out_of_bounds_value);
+                  return;
+                }
+
+                const ssize_t c[] = { ssize_t (std::floor (this->P[0])), ssize_t (std::floor (this->P[1])), ssize_t (std::floor (this->P[2])) };
+                if (c[0] != cell[0] || c[1] != cell[1] || c[2] != cell[2] || this->coeff_matrix.rows() != ImageType::size(axis)) {
+                  this->coeff_matrix.resize (ImageType::size(axis), 8);
+                  Interp::Base<ImageType>::template get_neighbourhood_rows<2> (c, axis, this->coeff_matrix);
+                  cell = {{ c[0], c[1], c[2] }};
+                }
+                values.noalias() = this->coeff_matrix * this->factors;
+              }
+
+            private:
+              std::array<ssize_t,3> cell;
+          };
+
+
+
         template <class ImageType>
           class Interpolator { MEMALIGN(Interpolator<ImageType>)
             public:
-              using type = Interp::Masked<Interp::Linear<ImageType>>;
+              using type = Interp::Masked<LinearRowCache<ImageType>>;
           };
 
 
@@ -28,6 +28,43 @@ namespace MR
 
 
           bool WriteKernel::operator() (const GeneratedTrack& tck)
+          {
+            if (!S.sequencer)
+              return write (tck);
+            try {
+              if (write_in_order (tck))
+                return true;
+            } catch (...) {
+              S.sequencer->stop();
+              throw;
+            }
+            S.sequencer->stop();
+            return false;
+          }
+
+
+
+          bool WriteKernel::write_in_order (const GeneratedTrack& tck)
+          {
+            if (tck.get_seed_number() != next_seed_number) {
+              pending.insert (std::make_pair (tck.get_seed_number(), tck));
+              return true;
+            }
+            if (!write (tck))
+              return false;
+            ++next_seed_number;
+            for (auto i = pending.begin(); i != pending.end() && i->first == next_seed_number; i = pending.erase (i)) {
+              if (!write (i->second))
+                return false;
+              ++next_seed_number;
+            }
+            S.sequencer->written (next_seed_number);
+            return true;
+          }
+
+
+
+          bool WriteKernel::write (const GeneratedTrack& tck)
           {
             if (complete())
               return false;
@@ -18,6 +18,7 @@
 #define __dwi_tractography_tracking_write_kernel_h__
 
 #include <cinttypes>
+#include <map>
 #include <string>
 
 #include "timer.h"
@@ -58,6 +59,7 @@ namespace MR
                 seeds (0),
                 streamlines (0),
                 selected (0),
+                next_seed_number (S.sequencer ? S.sequencer->first() : 0),
                 progress (printf ("       0 seeds,        0 streamlines,        0 selected", 0, 0), always_increment ? S.max_num_seeds : S.max_num_tracks),
                 early_exit (shared)
           {
@@ -98,9 +100,15 @@ namespace MR
           Writer<> writer;
           const bool always_increment, warn_on_max_seeds;
           size_t seeds, streamlines, selected;
+          // For reproducible tracking: streamlines received ahead of their turn, indexed by seed number
+          uint64_t next_seed_number;
+          std::map<uint64_t, GeneratedTrack> pending;
           std::unique_ptr<File::OFStream> output_seeds;
           ProgressBar progress;
           EarlyExit early_exit;
+
+          bool write (const GeneratedTrack&);
+          bool write_in_order (const GeneratedTrack&);
       };
 
 
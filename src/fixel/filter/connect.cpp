@@ -71,7 +71,7 @@ namespace MR
                 to_expand.pop();
                 output.index(0) = index;
                 output.value() = cluster_index;
-                const auto connections = matrix[index];
+                const auto connections = matrix.row (index);
                 for (const auto& c : connections) {
                   input.index (0) = c.index();
                   if (!processed[c.index()] && c.value() >= connectivity_threshold && input.value() >= value_threshold) {
@@ -31,6 +31,110 @@ namespace MR
 
 
 
+      namespace
+      {
+        class Source
+        { NOMEMALIGN
+          public:
+            Source (const size_t N) :
+                number (N),
+                counter (0) { }
+            bool operator() (size_t& fixel)
+            {
+              if ((fixel = counter) == number)
+                return false;
+              ++counter;
+              return true;
+            }
+          private:
+            const size_t number;
+            size_t counter;
+        };
+      }
+
+
+
+      template <class ValuesType>
+      class Smooth::Worker
+      { MEMALIGN(Smooth::Worker<ValuesType>)
+        public:
+          Worker (const Smooth& master, const ValuesType& values, const Image<float>& input, const Image<float>& output) :
+              master (master),
+              matrix (master.matrix),
+              values (values),
+              input (input),
+              output (output),
+              mask (master.mask_image) { }
+
+          bool operator() (const size_t fixel)
+          {
+            mask.index(0) = output.index(0) = fixel;
+            if (mask.value()) {
+              const Eigen::Vector3f& pos (master.fixel_positions[fixel]);
+              const auto connectivity = matrix.row (fixel, values);
+              default_type sum_weights (0.0);
+              output.value() = 0.0;
+              for (const auto& c : connectivity) {
+                mask.index (0) = input.index(0) = c.index();
+                if (mask.value() && std::isfinite (static_cast<float>(input.value()))) {
+                  const Matrix::connectivity_value_type weight = c.value() * master.gaussian_const1 * std::exp (master.gaussian_const2 * (master.fixel_positions[c.index()] - pos).squaredNorm());
+                  if (weight >= master.threshold) {
+                    output.value() += weight * input.value();
+                    sum_weights += weight;
+                  }
+                }
+              }
+              if (sum_weights) {
+                output.value() /= sum_weights;
+              } else if (connectivity.empty()) {
+                // Provide unsmoothed value if disconnected
+                input.index(0) = fixel;
+                output.value() = input.value();
+              } else {
+                output.value() = std::numeric_limits<float>::quiet_NaN();
+              }
+            } else {
+              output.value() = std::numeric_limits<float>::quiet_NaN();
+            }
+            return true;
+          }
+
+        private:
+          const Smooth& master;
+          // Need a local copy of each of these
+          Matrix::Reader matrix;
+          const ValuesType values;
+          Image<float> input;
+          Image<float> output;
+          Image<bool> mask;
+      };
+
+
+
+      class Smooth::Run
+      { NOMEMALIGN
+        public:
+          Run (const Smooth& master, Image<float>& input, Image<float>& output) :
+              master (master),
+              input (input),
+              output (output) { }
+
+          template <class ValuesType>
+          void operator() (const ValuesType& values)
+          {
+            Thread::run_queue (Source (input.size (0)),
+                               Thread::batch (size_t()),
+                               Thread::multi (Worker<ValuesType> (master, values, input, output)));
+          }
+
+        private:
+          const Smooth& master;
+          Image<float>& input;
+          Image<float>& output;
+      };
+
+
+
       Smooth::Smooth (Image<index_type> index_image,
                       const Matrix::Reader& matrix,
                       const Image<bool>& mask_image,
@@ -104,80 +208,7 @@ namespace MR
           throw Exception ("Size of fixel data file \"" + input.name() + "\" (" + str(input.size(0)) +
                            ") does not match fixel connectivity matrix (" + str(matrix.size()) + ")");
 
-        class Source
-        { NOMEMALIGN
-          public:
-            Source (const size_t N) :
-                number (N),
-                counter (0) { }
-            bool operator() (size_t& fixel)
-            {
-              if ((fixel = counter) == number)
-                return false;
-              ++counter;
-              return true;
-            }
-          private:
-            const size_t number;
-            size_t counter;
-        };
-
-        class Worker
-        { MEMALIGN(Worker)
-          public:
-            Worker (const Smooth& master, const Image<float>& input, const Image<float>& output) :
-                master (master),
-                matrix (master.matrix),
-                input (input),
-                output (output),
-                mask (master.mask_image) { }
-
-            bool operator() (const size_t fixel)
-            {
-              mask.index(0) = output.index(0) = fixel;
-              if (mask.value()) {
-                const Eigen::Vector3f& pos (master.fixel_positions[fixel]);
-                const auto connectivity = matrix[fixel];
-                default_type sum_weights (0.0);
-                output.value() = 0.0;
-                for (const auto& c : connectivity) {
-                  mask.index (0) = input.index(0) = c.index();
-                  if (mask.value() && std::isfinite (static_cast<float>(input.value()))) {
-                    const Matrix::connectivity_value_type weight = c.value() * master.gaussian_const1 * std::exp (master.gaussian_const2 * (master.fixel_positions[c.index()] - pos).squaredNorm());
-                    if (weight >= master.threshold) {
-                      output.value() += weight * input.value();
-                      sum_weights += weight;
-                    }
-                  }
-                }
-                if (sum_weights) {
-                  output.value() /= sum_weights;
-                } else if (connectivity.empty()) {
-                  // Provide unsmoothed value if disconnected
-                  input.index(0) = fixel;
-                  output.value() = input.value();
-                } else {
-                  output.value() = std::numeric_limits<float>::quiet_NaN();
-                }
-              } else {
-                output.value() = std::numeric_limits<float>::quiet_NaN();
-              }
-              return true;
-            }
-
-          private:
-            const Smooth& master;
-            // Need a local copy of each of these
-            Matrix::Reader matrix;
-            Image<float> input;
-            Image<float> output;
-            Image<bool> mask;
-        };
-
-        Thread::run_queue (Source (input.size (0)),
-                           Thread::batch (size_t()),
-                           Thread::multi (Worker (*this, input, output)));
-
+        matrix.visit_values (Run (*this, input, output));
       }
 
 
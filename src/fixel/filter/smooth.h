@@ -79,6 +79,11 @@ namespace MR
           vector<Eigen::Vector3f> fixel_positions;
           float stdev, gaussian_const1, gaussian_const2, threshold;
 
+          // Smooths the data of individual fixels, with the connectivity values
+          //   obtained through a Matrix::Reader::Values accessor
+          template <class ValuesType> class Worker;
+          class Run;
+
       };
     //! @}
 
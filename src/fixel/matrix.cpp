@@ -17,7 +17,11 @@
 
 #include "fixel/matrix.h"
 
+#include <queue>
+
 #include "app.h"
+#include "raw.h"
+#include "signal_handler.h"
 #include "thread_queue.h"
 #include "types.h"
 #include "file/ofstream.h"
@@ -123,12 +127,7 @@ namespace MR
 
 
 
-      init_matrix_type generate (
-          const std::string& track_filename,
-          Image<index_type>& index_image,
-          Image<bool>& fixel_mask,
-          const float angular_threshold)
-      {
+      namespace {
 
         class TrackProcessor { MEMALIGN(TrackProcessor)
 
@@ -198,153 +197,524 @@ namespace MR
         };
 
 
-        auto directions_image = Fixel::find_directions_header (Path::dirname (index_image.name())).template get_image<default_type>().with_direct_io ({+2,+1});
-        DWI::Tractography::Properties properties;
-        DWI::Tractography::Reader<float> track_file (track_filename, properties);
-        const uint32_t num_tracks = properties["count"].empty() ? 0 : to<uint32_t>(properties["count"]);
-        DWI::Tractography::Mapping::TrackLoader loader (track_file, num_tracks, "computing fixel-fixel connectivity matrix");
-        DWI::Tractography::Mapping::TrackMapperBase mapper (index_image);
-        mapper.set_upsample_ratio (DWI::Tractography::Mapping::determine_upsample_ratio (index_image, properties, 0.333f));
-        mapper.set_use_precise_mapping (true);
-        TrackProcessor track_processor (mapper, index_image, directions_image, fixel_mask, angular_threshold);
-        init_matrix_type connectivity_matrix (Fixel::get_number_of_fixels (index_image));
-        Thread::run_queue (loader,
-                           Thread::batch (DWI::Tractography::Streamline<float>()),
-                           track_processor,
-                           Thread::batch (vector<index_type>()),
-                           // Inline lambda function for receiving streamline fixel visitations and
-                           //   updating the connectivity matrix
-                           [&] (const vector<index_type>& fixels)
-                           {
-                             try {
-                               for (auto f : fixels)
-                                 connectivity_matrix[f].add (fixels);
-                               return true;
-                             } catch (...) {
-                               throw Exception ("Error assigning memory for CFE connectivity matrix");
-                               return false;
-                             }
-                           });
-        return connectivity_matrix;
-      }
 
+        // Map all streamlines to fixels, and provide the (sorted) list of
+        //   fixels traversed by each streamline to the functor provided
+        template <class SinkType>
+        void map_tracks (const std::string& track_filename,
+                         Image<index_type>& index_image,
+                         Image<bool>& fixel_mask,
+                         const float angular_threshold,
+                         SinkType&& sink)
+        {
+          auto directions_image = Fixel::find_directions_header (Path::dirname (index_image.name())).template get_image<default_type>().with_direct_io ({+2,+1});
+          DWI::Tractography::Properties properties;
+          DWI::Tractography::Reader<float> track_file (track_filename, properties);
+          const uint32_t num_tracks = properties["count"].empty() ? 0 : to<uint32_t>(properties["count"]);
+          DWI::Tractography::Mapping::TrackLoader loader (track_file, num_tracks, "computing fixel-fixel connectivity matrix");
+          DWI::Tractography::Mapping::TrackMapperBase mapper (index_image);
+          mapper.set_upsample_ratio (DWI::Tractography::Mapping::determine_upsample_ratio (index_image, properties, 0.333f));
+          mapper.set_use_precise_mapping (true);
+          TrackProcessor track_processor (mapper, index_image, directions_image, fixel_mask, angular_threshold);
+          loader.run_queue (Thread::batch (DWI::Tractography::Streamline<float>()),
+                            track_processor,
+                            Thread::batch (vector<index_type>()),
+                            std::forward<SinkType> (sink));
+        }
 
 
 
+        // Writes the normalised & thresholded connectivity of each fixel in turn
+        //   to the three images of the matrix directory
+        class MatrixWriter { NOMEMALIGN
+          public:
+            MatrixWriter (const std::string& path,
+                          const size_t num_fixels,
+                          const connectivity_value_type threshold,
+                          const KeyValues& keyvals,
+                          const DataType value_datatype) :
+                threshold (threshold),
+                quantised_max (0),
+                value_type_on_disk (DataType::from<connectivity_value_type>()),
+                fixel_index (0),
+                data_count (0)
+            {
+              if (value_datatype.is_integer()) {
+                if (value_datatype.bytes() == 1) {
+                  value_type_on_disk = DataType::UInt8;
+                  quantised_max = std::numeric_limits<uint8_t>::max();
+                } else if (value_datatype.bytes() == 2) {
+                  value_type_on_disk = DataType::UInt16LE;
+                  quantised_max = std::numeric_limits<uint16_t>::max();
+                } else {
+                  throw Exception ("Fixel-fixel connectivity values can only be quantised to 8 or 16 bits");
+                }
+              }
 
-      void normalise_and_write (init_matrix_type& matrix,
-                                const connectivity_value_type threshold,
-                                const std::string& path,
-                                const KeyValues& keyvals)
-      {
+              if (Path::exists (path)) {
+                if (!Path::is_dir (path)) {
+                  if (App::overwrite_files) {
+                    File::remove (path);
+                  } else {
+                    throw Exception ("Cannot create fixel-fixel connectivity matrix \"" + path + "\": Already exists as file");
+                  }
+                }
+              } else {
+                File::mkdir (path);
+              }
 
-        if (Path::exists (path)) {
-          if (!Path::is_dir (path)) {
-            if (App::overwrite_files) {
-              File::remove (path);
-            } else {
-              throw Exception ("Cannot create fixel-fixel connectivity matrix \"" + path + "\": Already exists as file");
+              Header index_header;
+              index_header.ndim() = 4;
+              index_header.size(0) = num_fixels;
+              index_header.size(1) = 1;
+              index_header.size(2) = 1;
+              index_header.size(3) = 2;
+              index_header.stride(0) = 2;
+              index_header.stride(1) = 3;
+              index_header.stride(2) = 4;
+              index_header.stride(3) = 1;
+              index_header.spacing(0) = index_header.spacing(1) = index_header.spacing(2) = 1.0;
+              index_header.transform() = transform_type::Identity();
+              index_header.keyval() = keyvals;
+              index_header.keyval()["nfixels"] = str(num_fixels);
+              index_header.datatype() = DataType::from<index_image_type>();
+              index_image = Image<index_image_type>::create (Path::join (path, "index.mif"), index_header);
+
+              // Can't use function write_mrtrix_header() as the file offset of the
+              //   first entry of the "dim" field needs to be known
+              //   (and enough space needs to be left to fill in a large number upon completion)
+              fixel_stream.open (Path::join (path, "fixels.mif"), std::ios_base::out | std::ios_base::binary);
+              value_stream.open (Path::join (path, "values.mif"), std::ios_base::out | std::ios_base::binary);
+
+              Eigen::IOFormat fmt(Eigen::FullPrecision, Eigen::DontAlignCols, ", ", "\ntransform: ", "", "", "\ntransform: ", "");
+
+              for (size_t stream_index = 0; stream_index != 2; ++stream_index) {
+                File::OFStream& stream (stream_index ? value_stream : fixel_stream);
+                stream << leadin() << std::string (dim_padding(), ' ') << "\n";
+                stream << "vox: 1,1,1\n";
+                stream << "layout: +0,+1,+2\n";
+                stream << "datatype: ";
+                if (stream_index)
+                  stream << value_type_on_disk.specifier();
+                else
+                  stream << DataType::from<index_type>().specifier();
+                stream << transform_type::Identity().matrix().topLeftCorner(3,4).format(fmt) << "\n";
+                if (stream_index && quantised_max)
+                  stream << "scaling: 0," << str(1.0 / quantised_max, 10) << "\n";
+                else
+                  stream << "scaling: 0,1\n";
+                stream << "nfixels: " + str(num_fixels) + "\n";
+                File::KeyValue::write (stream, keyvals, "", true);
+                stream << "file: ";
+                uint64_t offset = uint64_t(stream.tellp()) + 18;
+                offset += ((4 - (offset % 4)) % 4);
+                stream << ". " << offset << "\nEND\n";
+                stream << std::string (offset - uint64_t(stream.tellp()), '\0');
+              }
+            }
+
+            // Write the connectivity of the next fixel, given the list of
+            //   connected fixels & associated streamline counts, and the
+            //   total number of streamlines traversing this fixel
+            template <class ConnectionsType>
+            void operator() (const ConnectionsType& connections, const count_type track_count)
+            {
+              fixel_buffer.clear();
+              value_buffer.clear();
+              fixel_buffer.reserve (connections.size());
+              value_buffer.reserve (connections.size());
+
+              const connectivity_value_type normalisation_factor = connectivity_value_type(1) / connectivity_value_type (track_count);
+              for (const auto& it : connections) {
+                const connectivity_value_type connectivity = normalisation_factor * it.value();
+                if (connectivity >= threshold) {
+                  fixel_buffer.push_back (it.index());
+                  value_buffer.push_back (connectivity);
+                }
+              }
+
+              index_image.index (0) = fixel_index++;
+              index_image.index (3) = 0; index_image.value() = uint64_t(fixel_buffer.size());
+              index_image.index (3) = 1; index_image.value() = fixel_buffer.size() ? data_count : uint64_t(0);
+
+              fixel_stream.write (reinterpret_cast<const char*>(fixel_buffer.data()), fixel_buffer.size() * sizeof (index_type));
+              if (quantised_max) {
+                quantised_buffer.resize (value_buffer.size() * value_type_on_disk.bytes());
+                for (size_t i = 0; i != value_buffer.size(); ++i) {
+                  const uint32_t quantised = std::min (quantised_max, uint32_t (std::round (value_buffer[i] * quantised_max)));
+                  if (quantised_max == std::numeric_limits<uint8_t>::max())
+                    quantised_buffer[i] = quantised;
+                  else
+                    Raw::store_LE<uint16_t> (quantised, quantised_buffer.data(), i);
+                }
+                value_stream.write (reinterpret_cast<const char*>(quantised_buffer.data()), quantised_buffer.size());
+              } else {
+                value_stream.write (reinterpret_cast<const char*>(value_buffer.data()), value_buffer.size() * sizeof (connectivity_value_type));
+              }
+
+              data_count += fixel_buffer.size();
+            }
+
+            // Update headers to reflect the number of fixel-fixel connections
+            void finalise ()
+            {
+              assert (fixel_index == size_t(index_image.size (0)));
+              std::string dim_string = str(data_count) + ",1,1";
+              dim_string += std::string (dim_padding() - dim_string.size(), ' ');
+              for (size_t stream_index = 0; stream_index != 2; ++stream_index) {
+                File::OFStream& stream (stream_index ? value_stream : fixel_stream);
+                stream.seekp (leadin().size());
+                stream << dim_string;
+              }
+            }
+
+          private:
+            const connectivity_value_type threshold;
+            uint32_t quantised_max; // zero if values are not to be quantised
+            DataType value_type_on_disk;
+            Image<index_image_type> index_image;
+            File::OFStream fixel_stream, value_stream;
+            size_t fixel_index;
+            uint64_t data_count;
+            vector<index_type> fixel_buffer;
+            vector<connectivity_value_type> value_buffer;
+            vector<uint8_t> quantised_buffer;
+
+            static std::string leadin () { return "mrtrix image\ndim: "; }
+            // Need enough space for the largest possible 64-bit unsigned integer,
+            //   plus ",1,1" for the two dummy axes
+            static size_t dim_padding () { return std::log10 (std::numeric_limits<size_t>::max()) + 4; }
+        };
+
+
+
+
+
+        // Support for out-of-core construction of the connectivity matrix:
+        //   each fixel-fixel pair is encoded as a single 64-bit key (with the
+        //   first fixel in the upper 32 bits) so that sorting the keys sorts
+        //   the pairs in the order in which they are to be written; runs of
+        //   sorted keys with their associated streamline counts are held in
+        //   temporary files, each record being 12 bytes (key & count, little-endian)
+        using pair_key_type = uint64_t;
+        constexpr size_t run_record_size = sizeof (pair_key_type) + sizeof (count_type);
+        // Number of records read from / written to a temporary file at once
+        constexpr size_t run_records_per_block = 16384;
+        // Maximum number of runs to be merged in a single pass
+        constexpr size_t max_runs_per_merge = 64;
+
+        FORCE_INLINE pair_key_type pair_key (const index_type a, const index_type b) { return (pair_key_type (a) << 32) | pair_key_type (b); }
+
+
+
+        // A temporary file holding a single sorted run, deleted on destruction
+        class Run { NOMEMALIGN
+          public:
+            Run () : path (File::create_tempfile (0, "bin")), num_records (0) {
+              SignalHandler::mark_file_for_deletion (path);
+            }
+            Run (const Run&) = delete;
+            ~Run () {
+              try {
+                File::remove (path);
+                SignalHandler::unmark_file_for_deletion (path);
+              } catch (Exception& e) {
+                e.display();
+              }
+            }
+
+            const std::string path;
+            size_t num_records;
+        };
+
+
+
+        // Sequential buffered read access to a run
+        class RunReader { NOMEMALIGN
+          public:
+            RunReader (const Run& run) :
+                in (run.path, std::ios_base::in | std::ios_base::binary),
+                remaining (run.num_records),
+                position (0)
+            {
+              if (!in)
+                throw Exception ("Error opening temporary file \"" + run.path + "\": " + strerror (errno));
+              next();
+            }
+
+            bool valid () const { return position < buffer.size(); }
+            pair_key_type key () const { return Raw::fetch_LE<pair_key_type> (buffer.data() + position); }
+            count_type count () const { return Raw::fetch_LE<count_type> (buffer.data() + position + sizeof (pair_key_type)); }
+
+            void next ()
+            {
+              position += run_record_size;
+              if (position < buffer.size())
+                return;
+              const size_t num_to_read = std::min (remaining, run_records_per_block);
+              buffer.resize (num_to_read * run_record_size);
+              position = 0;
+              if (!num_to_read)
+                return;
+              in.read (reinterpret_cast<char*> (buffer.data()), buffer.size());
+              if (!in)
+                throw Exception ("Error reading temporary file during construction of fixel-fixel connectivity matrix");
+              remaining -= num_to_read;
+            }
+
+          private:
+            std::ifstream in;
+            size_t remaining, position;
+            vector<uint8_t> buffer;
+        };
+
+
+
+        // Buffered write access to a run
+        class RunWriter { NOMEMALIGN
+          public:
+            RunWriter (Run& run) :
+                run (run),
+                out (run.path, std::ios_base::out | std::ios_base::binary) { }
+
+            ~RunWriter () { flush(); }
+
+            void operator() (const pair_key_type key, const count_type count)
+            {
+              const size_t offset = buffer.size();
+              buffer.resize (offset + run_record_size);
+              Raw::store_LE<pair_key_type> (key, buffer.data() + offset);
+              Raw::store_LE<count_type> (count, buffer.data() + offset + sizeof (pair_key_type));
+              ++run.num_records;
+              if (run.num_records % run_records_per_block == 0)
+                flush();
+            }
+
+            void flush ()
+            {
+              out.write (reinterpret_cast<const char*> (buffer.data()), buffer.size());
+              buffer.clear();
+            }
+
+          private:
+            Run& run;
+            File::OFStream out;
+            vector<uint8_t> buffer;
+        };
+
+
+
+        // Merge the sorted runs in the range provided, summing the counts of
+        //   pairs that appear in more than one run, and providing each unique
+        //   fixel-fixel pair in turn to the functor
+        template <class Functor>
+        void merge_runs (const vector<std::unique_ptr<Run>>& runs, const size_t first, const size_t last, Functor&& functor)
+        {
+          vector<std::unique_ptr<RunReader>> readers;
+          for (size_t i = first; i != last; ++i)
+            readers.emplace_back (new RunReader (*runs[i]));
+          using queue_entry_type = std::pair<pair_key_type, size_t>;
+          std::priority_queue<queue_entry_type, vector<queue_entry_type>, std::greater<queue_entry_type>> queue;
+          for (size_t i = 0; i != readers.size(); ++i) {
+            if (readers[i]->valid())
+              queue.push (std::make_pair (readers[i]->key(), i));
+          }
+          while (!queue.empty()) {
+            const pair_key_type key = queue.top().first;
+            count_type count = 0;
+            while (!queue.empty() && queue.top().first == key) {
+              RunReader& reader (*readers[queue.top().second]);
+              const size_t index = queue.top().second;
+              queue.pop();
+              count += reader.count();
+              reader.next();
+              if (reader.valid())
+                queue.push (std::make_pair (reader.key(), index));
             }
+            functor (key, count);
           }
-        } else {
-          File::mkdir (path);
         }
 
-        Header index_header;
-        index_header.ndim() = 4;
-        index_header.size(0) = matrix.size();
-        index_header.size(1) = 1;
-        index_header.size(2) = 1;
-        index_header.size(3) = 2;
-        index_header.stride(0) = 2;
-        index_header.stride(1) = 3;
-        index_header.stride(2) = 4;
-        index_header.stride(3) = 1;
-        index_header.spacing(0) = index_header.spacing(1) = index_header.spacing(2) = 1.0;
-        index_header.transform() = transform_type::Identity();
-        index_header.keyval() = keyvals;
-        index_header.keyval()["nfixels"] = str(matrix.size());
-        index_header.datatype() = DataType::from<index_image_type>();
-        Image<index_image_type> index_image = Image<index_image_type>::create (Path::join (path, "index.mif"), index_header);
-
-        // Can't use function write_mrtrix_header() as the file offset of the
-        //   first entry of the "dim" field needs to be known
-        //   (and enough space needs to be left to fill in a large number upon completion)
-        File::OFStream fixel_stream (Path::join (path, "fixels.mif"), std::ios_base::out | std::ios_base::binary);
-        File::OFStream value_stream (Path::join (path, "values.mif"), std::ios_base::out | std::ios_base::binary);
-
-        const std::string leadin = "mrtrix image\ndim: ";
-        // Need enough space for the largest possible 64-bit unsigned integer,
-        //   plus ",1,1" for the two dummy axes
-        const size_t dim_padding = std::log10 (std::numeric_limits<size_t>::max()) + 4;
-
-        Eigen::IOFormat fmt(Eigen::FullPrecision, Eigen::DontAlignCols, ", ", "\ntransform: ", "", "", "\ntransform: ", "");
-
-        for (size_t stream_index = 0; stream_index != 2; ++stream_index) {
-          File::OFStream& stream (stream_index ? value_stream : fixel_stream);
-          stream << leadin << std::string (dim_padding, ' ') << "\n";
-          stream << "vox: 1,1,1\n";
-          stream << "layout: +0,+1,+2\n";
-          stream << "datatype: ";
-          if (stream_index)
-            stream << DataType::from<connectivity_value_type>().specifier();
-          else
-            stream << DataType::from<index_type>().specifier();
-          stream << transform_type::Identity().matrix().topLeftCorner(3,4).format(fmt) << "\n";
-          stream << "scaling: 0,1\n";
-          stream << "nfixels: " + str(matrix.size()) + "\n";
-          File::KeyValue::write (stream, keyvals, "", true);
-          stream << "file: ";
-          uint64_t offset = uint64_t(stream.tellp()) + 18;
-          offset += ((4 - (offset % 4)) % 4);
-          stream << ". " << offset << "\nEND\n";
-          stream << std::string (offset - uint64_t(stream.tellp()), '\0');
-        }
 
-        ProgressBar progress ("Normalising and writing fixel-fixel connectivity matrix to directory \"" + path + "\"", matrix.size());
-        size_t data_count = 0;
-        vector<index_type> fixel_buffer;
-        vector<connectivity_value_type> value_buffer;
-        for (size_t fixel_index = 0; fixel_index != matrix.size(); ++fixel_index) {
 
-          fixel_buffer.clear();
-          value_buffer.clear();
-          fixel_buffer.reserve (matrix[fixel_index].size());
-          value_buffer.reserve (matrix[fixel_index].size());
-
-          const connectivity_value_type normalisation_factor = connectivity_value_type(1) / connectivity_value_type (matrix[fixel_index].count());
-          for (auto& it : matrix[fixel_index]) {
-            const connectivity_value_type connectivity = normalisation_factor * it.value();
-            if (connectivity >= threshold) {
-              fixel_buffer.push_back (it.index());
-              value_buffer.push_back (connectivity);
+        // Accumulates the fixel-fixel pairs visited by each streamline in a
+        //   fixed-size buffer; whenever this fills, the pairs are sorted,
+        //   collapsed into unique pairs with associated counts, and written to
+        //   a new run
+        class ExternalBuilder { NOMEMALIGN
+          public:
+            ExternalBuilder (const size_t num_fixels, const size_t buffer_bytes) :
+                capacity (std::max (buffer_bytes / sizeof (pair_key_type), size_t (1))),
+                track_counts (num_fixels, 0)
+            {
+              buffer.reserve (capacity);
+            }
+
+            bool operator() (const vector<index_type>& fixels)
+            {
+              for (auto a : fixels) {
+                ++track_counts[a];
+                for (auto b : fixels) {
+                  buffer.push_back (pair_key (a, b));
+                  if (buffer.size() == capacity)
+                    spill();
+                }
+              }
+              return true;
+            }
+
+            void spill ()
+            {
+              if (buffer.empty())
+                return;
+              std::sort (buffer.begin(), buffer.end());
+              runs.emplace_back (new Run());
+              RunWriter writer (*runs.back());
+              for (size_t i = 0; i != buffer.size(); ) {
+                size_t j = i + 1;
+                while (j != buffer.size() && buffer[j] == buffer[i])
+                  ++j;
+                writer (buffer[i], count_type (j - i));
+                i = j;
+              }
+              buffer.clear();
+            }
+
+            // Write all data currently held in RAM to file, then repeatedly
+            //   merge groups of runs until few enough remain for a single final merge
+            void reduce ()
+            {
+              spill();
+              vector<uint64_t>().swap (buffer);
+              while (runs.size() > max_runs_per_merge) {
+                vector<std::unique_ptr<Run>> merged_runs;
+                for (size_t first = 0; first < runs.size(); first += max_runs_per_merge) {
+                  const size_t last = std::min (first + max_runs_per_merge, runs.size());
+                  merged_runs.emplace_back (new Run());
+                  {
+                    RunWriter writer (*merged_runs.back());
+                    merge_runs (runs, first, last, writer);
+                  }
+                  for (size_t i = first; i != last; ++i)
+                    runs[i].reset();
+                }
+                std::swap (runs, merged_runs);
+              }
             }
-          }
 
-          index_image.index (0) = fixel_index;
-          index_image.index (3) = 0; index_image.value() = uint64_t(fixel_buffer.size());
-          index_image.index (3) = 1; index_image.value() = fixel_buffer.size() ? data_count : uint64_t(0);
+            size_t num_runs () const { return runs.size(); }
 
-          fixel_stream.write (reinterpret_cast<const char*>(fixel_buffer.data()), fixel_buffer.size() * sizeof (index_type));
-          value_stream.write (reinterpret_cast<const char*>(value_buffer.data()), value_buffer.size() * sizeof (connectivity_value_type));
+            // Provide the full set of connections of each fixel in turn to the writer
+            void write (MatrixWriter& writer, ProgressBar& progress)
+            {
+              reduce();
+              InitFixel::BaseType connections;
+              size_t fixel_index = 0;
+              merge_runs (runs, 0, runs.size(), [&] (const pair_key_type key, const count_type count)
+              {
+                const index_type a = key >> 32;
+                while (fixel_index != a) {
+                  writer (connections, track_counts[fixel_index++]);
+                  connections.clear();
+                  ++progress;
+                }
+                connections.emplace_back (InitElement (index_type (key), count));
+              });
+              while (fixel_index != track_counts.size()) {
+                writer (connections, track_counts[fixel_index++]);
+                connections.clear();
+                ++progress;
+              }
+              runs.clear();
+            }
 
-          data_count += fixel_buffer.size();
+          private:
+            const size_t capacity;
+            vector<pair_key_type> buffer;
+            vector<count_type> track_counts;
+            vector<std::unique_ptr<Run>> runs;
+        };
 
+      }
+
+
+
+
+
+      init_matrix_type generate (
+          const std::string& track_filename,
+          Image<index_type>& index_image,
+          Image<bool>& fixel_mask,
+          const float angular_threshold)
+      {
+        init_matrix_type connectivity_matrix (Fixel::get_number_of_fixels (index_image));
+        map_tracks (track_filename, index_image, fixel_mask, angular_threshold,
+                    // Inline lambda function for receiving streamline fixel visitations and
+                    //   updating the connectivity matrix
+                    [&] (const vector<index_type>& fixels)
+                    {
+                      try {
+                        for (auto f : fixels)
+                          connectivity_matrix[f].add (fixels);
+                        return true;
+                      } catch (...) {
+                        throw Exception ("Error assigning memory for CFE connectivity matrix");
+                        return false;
+                      }
+                    });
+        return connectivity_matrix;
+      }
+
+
+
+
+
+      void normalise_and_write (init_matrix_type& matrix,
+                                const connectivity_value_type threshold,
+                                const std::string& path,
+                                const KeyValues& keyvals,
+                                const DataType value_datatype)
+      {
+        MatrixWriter writer (path, matrix.size(), threshold, keyvals, value_datatype);
+        ProgressBar progress ("Normalising and writing fixel-fixel connectivity matrix to directory \"" + path + "\"", matrix.size());
+        for (size_t fixel_index = 0; fixel_index != matrix.size(); ++fixel_index) {
+          writer (matrix[fixel_index], matrix[fixel_index].count());
           // Force deallocation of memory used for this fixel in the generated matrix
           InitFixel().swap (matrix[fixel_index]);
-
           ++progress;
         }
+        writer.finalise();
+      }
+
+
 
-        // Update headers to reflect the number of fixel-fixel connections
-        std::string dim_string = str(data_count) + ",1,1";
-        dim_string += std::string (dim_padding - dim_string.size(), ' ');
-        for (size_t stream_index = 0; stream_index != 2; ++stream_index) {
-          File::OFStream& stream (stream_index ? value_stream : fixel_stream);
-          stream.seekp (leadin.size());
-          stream << dim_string;
-        }
 
+
+      void generate_and_write (const std::string& track_filename,
+                               Image<index_type>& index_image,
+                               Image<bool>& fixel_mask,
+                               const float angular_threshold,
+                               const connectivity_value_type threshold,
+                               const std::string& path,
+                               const size_t memory_limit,
+                               const KeyValues& keyvals,
+                               const DataType value_datatype)
+      {
+        const size_t num_fixels = Fixel::get_number_of_fixels (index_image);
+        // The streamline count of each fixel is held in RAM in addition to the buffer of fixel-fixel pairs
+        const size_t fixed_memory = num_fixels * sizeof (count_type);
+        if (memory_limit <= fixed_memory)
+          throw Exception ("Memory limit for construction of fixel-fixel connectivity matrix must exceed " + str(fixed_memory / (1024*1024) + 1) + " MB for this fixel template");
+        ExternalBuilder builder (num_fixels, memory_limit - fixed_memory);
+        map_tracks (track_filename, index_image, fixel_mask, angular_threshold,
+                    [&] (const vector<index_type>& fixels) { return builder (fixels); });
+        builder.reduce();
+        INFO ("Fixel-fixel connectivity matrix constructed from " + str(builder.num_runs()) + " sorted runs in temporary files");
+
+        MatrixWriter writer (path, num_fixels, threshold, keyvals, value_datatype);
+        ProgressBar progress ("Normalising and writing fixel-fixel connectivity matrix to directory \"" + path + "\"", num_fixels);
+        builder.write (writer, progress);
+        writer.finalise();
       }
 
 
@@ -359,9 +729,14 @@ namespace MR
 
 
 
-      Reader::Reader (const std::string& path, const Image<bool>& mask) :
+      Reader::Reader (const std::string& path, const Image<bool>& mask_image) :
           directory (path),
-          mask_image (mask)
+          num_fixels (0),
+          index_data (nullptr),
+          fixel_data (nullptr),
+          value_data (nullptr),
+          value_storage (storage_t::FLOAT32),
+          value_scale (connectivity_value_type (1))
       {
         try {
           index_image = Image<index_image_type>::open (Path::join (directory, "index.mif"));
@@ -369,12 +744,53 @@ namespace MR
             throw Exception ("Fixel-fixel connectivity matrix index image must be 4D");
           if (index_image.size (1) != 1 || index_image.size (2) != 1 || index_image.size (3) != 2)
             throw Exception ("Fixel-fixel connectivity matrix index image must have size Nx1x1x2");
-          fixel_image = Image<fixel_index_type>::open (Path::join (directory, "fixels.mif"));
-          value_image = Image<connectivity_value_type>::open (Path::join (directory, "values.mif"));
-          if (value_image.size (0) != fixel_image.size (0))
-            throw Exception ("Number of fixels in value image (" + str(value_image.size (0)) + ") does not match number of fixels in fixel image (" + str(fixel_image.size (0)) + ")");
-          if (mask_image.valid() && size_t(mask_image.size (0)) != size())
-            throw Exception ("Fixel image \"" + mask_image.name() + "\" has different number of fixels (" + str(mask_image.size (0)) + ") to fixel-fixel connectivity matrix (" + str(size()) + ")");
+          num_fixels = index_image.size (0);
+          // Count & offset of each fixel must be adjacent in memory
+          index_image = index_image.with_direct_io ({ 2, 3, 4, 1 });
+          index_data = index_image.address();
+
+          fixel_image = Image<fixel_index_type>::open (Path::join (directory, "fixels.mif")).with_direct_io();
+          fixel_data = fixel_image.address();
+
+          Header value_header = Header::open (Path::join (directory, "values.mif"));
+          if (value_header.size (0) != fixel_image.size (0))
+            throw Exception ("Number of fixels in value image (" + str(value_header.size (0)) + ") does not match number of fixels in fixel image (" + str(fixel_image.size (0)) + ")");
+          switch (value_header.datatype()() & ~(DataType::BigEndian | DataType::LittleEndian)) {
+            case DataType::UInt8:
+              value_storage = storage_t::UINT8;
+              break;
+            case DataType::UInt16:
+              value_storage = storage_t::UINT16;
+              break;
+            default:
+              value_storage = storage_t::FLOAT32;
+          }
+          if (value_storage == storage_t::FLOAT32) {
+            value_image_float32 = value_header.get_image<connectivity_value_type>().with_direct_io();
+            value_data = value_image_float32.address();
+          } else {
+            if (value_header.intensity_offset())
+              throw Exception ("Quantised fixel-fixel connectivity values must have zero intensity offset");
+            value_scale = value_header.intensity_scale();
+            // Access the quantised values directly; scaling is applied on access
+            value_header.reset_intensity_scaling();
+            if (value_storage == storage_t::UINT8) {
+              value_image_uint8 = value_header.get_image<uint8_t>().with_direct_io();
+              value_data = value_image_uint8.address();
+            } else {
+              value_image_uint16 = value_header.get_image<uint16_t>().with_direct_io();
+              value_data = value_image_uint16.address();
+            }
+          }
+
+          if (mask_image.valid()) {
+            if (size_t(mask_image.size (0)) != size())
+              throw Exception ("Fixel image \"" + mask_image.name() + "\" has different number of fixels (" + str(mask_image.size (0)) + ") to fixel-fixel connectivity matrix (" + str(size()) + ")");
+            Image<bool> temp (mask_image);
+            mask.resize (size());
+            for (temp.index (0) = 0; temp.index (0) != temp.size (0); ++temp.index (0))
+              mask[temp.index (0)] = temp.value();
+          }
         } catch (Exception& e) {
           throw Exception (e, "Unable to load path \"" + directory + "\" as fixel-fixel connectivity data");
         }
@@ -392,43 +808,10 @@ namespace MR
 
       NormFixel Reader::operator[] (const size_t i) const
       {
-        // For thread-safety
-        Image<index_image_type> index (index_image);
-        Image<fixel_index_type> fixel (fixel_image);
-        Image<connectivity_value_type> value (value_image);
-        Image<bool> mask (mask_image);
         NormFixel result;
-        if (mask.valid()) {
-          mask.index(0) = i;
-          if (!mask.value())
-            return result;
-        }
-        index.index (0) = i;
-        index.index (3) = 0;
-        const index_image_type num_connections = index.value();
-        if (!num_connections)
-          return result;
-        index.index (3) = 1;
-        const index_image_type offset = index.value();
-        connectivity_value_type sum (connectivity_value_type (0));
-        fixel.index (0) = value.index (0) = offset;
-        if (mask.valid()) {
-          for (size_t i = 0; i != num_connections; ++i) {
-            mask.index(0) = fixel.value();
-            if (mask.value()) {
-              result.emplace_back (NormElement (fixel.value(), value.value()));
-              sum += value.value();
-            }
-            fixel.index (0)++; value.index (0)++;
-          }
-        } else {
-          for (size_t i = 0; i != num_connections; ++i) {
-            result.emplace_back (NormElement (fixel.value(), value.value()));
-            sum += value.value();
-            fixel.index (0)++; value.index (0)++;
-          }
-        }
-        result.normalise (sum);
+        for (const auto c : row (i))
+          result.push_back (c);
+        result.normalise();
         return result;
       }
 
@@ -436,18 +819,6 @@ namespace MR
 
 
 
-      size_t Reader::size (const size_t fixel) const
-      {
-        // For thread-safety
-        Image<index_image_type> index (index_image);
-        index.index (0) = fixel;
-        index.index (3) = 0;
-        return index.value();
-      }
-
-
-
-
 
 
 
@@ -181,15 +181,45 @@ namespace MR
       // - Normalisation of the matrix
       // - Writing to the three images
       // - Erasing the memory used for that matrix in the initial building
-
+      //
+      // The connectivity values are written as 32-bit floating-point unless
+      //   an unsigned integer type (UInt8 or UInt16) is requested, in which
+      //   case they are quantised over the range [0.0, 1.0]
       void normalise_and_write (init_matrix_type& matrix,
                                 const connectivity_value_type threshold,
                                 const std::string& path,
-                                const KeyValues& keyvals = KeyValues());
+                                const KeyValues& keyvals = KeyValues(),
+                                const DataType value_datatype = DataType::from<connectivity_value_type>());
+
+
+
+      // Generate the fixel-fixel connectivity matrix and write it to the filesystem,
+      //   without ever holding the whole matrix in RAM
+      // Fixel-fixel pairs visited by streamlines are accumulated in a buffer of
+      //   bounded size (memory_limit, in bytes); whenever this fills, its contents
+      //   are sorted, combined and written to a temporary file (see config file
+      //   option TmpFileDir). Once all streamlines have been processed, these
+      //   sorted runs are merged directly into the compressed sparse row output.
+      void generate_and_write (const std::string& track_filename,
+                               Image<fixel_index_type>& index_image,
+                               Image<bool>& fixel_mask,
+                               const float angular_threshold,
+                               const connectivity_value_type threshold,
+                               const std::string& path,
+                               const size_t memory_limit,
+                               const KeyValues& keyvals = KeyValues(),
+                               const DataType value_datatype = DataType::from<connectivity_value_type>());
 
 
 
       // Wrapper class for reading the connectivity matrix from the filesystem
+      //
+      // The three images are accessed directly as compressed sparse row (CSR)
+      //   arrays; where their data type & strides permit (as is the case for
+      //   matrices written by normalise_and_write()), these are memory-mapped
+      //   rather than loaded into RAM. Connectivity values may be stored either as
+      //   32-bit floating-point, or quantised to 8 or 16 bit unsigned integers
+      //   (with the appropriate intensity scaling in the image header).
       class Reader
       { MEMALIGN(Reader)
 
@@ -197,35 +227,137 @@ namespace MR
           Reader (const std::string& path, const Image<bool>& mask);
           Reader (const std::string& path);
 
-          // TODO Entirely feasible to construct this thing using scratch storage;
-          //   would need two passes over the pre-normalised data in order to calculate
-          //   the number of fixel-fixel connections, but it could be done
-          //
-          // It would require restoration of the old Matrix::normalise() function,
-          //   but modification to write out to scratch index / fixel / value images
-          //   rather than "norm_matrix_type"
-          //
-          // This would permit usage of fixelcfestats with tractogram as input
-          //
-          // TODO Could pre-exponentiation of connectivity values be done beforehand using an mrcalc call?
-          // Expect fixelcfestats to be provided with a data file, from which it will find the
-          //   index & fixel images
+          // Typed access to the connectivity values (with the intensity scaling
+          //   of quantised values applied), for a given storage type
+          template <typename StorageType>
+          class Values
+          { NOMEMALIGN
+            public:
+              Values (const void* data, const connectivity_value_type scale) :
+                  data (static_cast<const StorageType*> (data)), scale (scale) { }
+              FORCE_INLINE connectivity_value_type operator[] (const uint64_t position) const { return scale * connectivity_value_type (data[position]); }
+            private:
+              const StorageType* data;
+              connectivity_value_type scale;
+          };
+
+          // Access to the connectivity values through value(), i.e. resolving
+          //   the storage type at each access
+          class DynamicValues
+          { NOMEMALIGN
+            public:
+              DynamicValues (const Reader& reader) : reader (&reader) { }
+              FORCE_INLINE connectivity_value_type operator[] (const uint64_t position) const { return reader->value (position); }
+            private:
+              const Reader* reader;
+          };
+
+          // A view of the connections of a single fixel, decoded on the fly
+          //   from the matrix data without any memory allocation; any connections
+          //   to fixels outside the mask are skipped
+          template <class ValuesType>
+          class Row
+          { NOMEMALIGN
+            public:
+              class const_iterator
+              { NOMEMALIGN
+                public:
+                  const_iterator (const Reader& reader, const ValuesType& values, const uint64_t position, const uint64_t end) :
+                      reader (&reader), values (values), position (position), end (end) { skip(); }
+                  FORCE_INLINE NormElement operator* () const { return NormElement (reader->fixel (position), values[position]); }
+                  FORCE_INLINE const_iterator& operator++ () { ++position; skip(); return *this; }
+                  FORCE_INLINE bool operator!= (const const_iterator& that) const { return position != that.position; }
+                private:
+                  const Reader* reader;
+                  ValuesType values;
+                  uint64_t position, end;
+                  FORCE_INLINE void skip () { while (position != end && !reader->in_mask (reader->fixel (position))) ++position; }
+              };
+
+              Row (const Reader& reader, const ValuesType& values, const uint64_t first, const uint64_t last) :
+                  reader (reader), values (values), first (first), last (last) { }
+
+              const_iterator begin() const { return const_iterator (reader, values, first, last); }
+              const_iterator end() const { return const_iterator (reader, values, last, last); }
+              bool empty() const { return !(begin() != end()); }
+
+              // Equivalent to NormFixel::norm_multiplier
+              connectivity_value_type norm_multiplier () const
+              {
+                connectivity_value_type sum (connectivity_value_type (0));
+                for (const auto c : *this)
+                  sum += c.value();
+                return sum ? (connectivity_value_type (1) / sum) : connectivity_value_type (0);
+              }
+
+            private:
+              const Reader& reader;
+              const ValuesType values;
+              const uint64_t first, last;
+          };
+
+          // The connections of a fixel, with values obtained through the
+          //   accessor provided (see visit_values())
+          template <class ValuesType>
+          Row<ValuesType> row (const size_t index, const ValuesType& values) const {
+            if (!in_mask (index))
+              return Row<ValuesType> (*this, values, 0, 0);
+            return Row<ValuesType> (*this, values, offset (index), offset (index) + size (index));
+          }
+          Row<DynamicValues> row (const size_t index) const { return row (index, DynamicValues (*this)); }
+
+          // Invoke the templated operator() of functor with the Values accessor
+          //   matching the storage type of the connectivity values, such that
+          //   this type is resolved once for an entire loop rather than at each
+          //   access as with value()
+          template <class Functor>
+          void visit_values (Functor&& functor) const {
+            switch (value_storage) {
+              case storage_t::UINT8:  functor (Values<uint8_t> (value_data, value_scale)); break;
+              case storage_t::UINT16: functor (Values<uint16_t> (value_data, value_scale)); break;
+              default: functor (Values<connectivity_value_type> (value_data, value_scale));
+            }
+          }
 
+          // Unlike row(), this involves copying the connections of the fixel
           NormFixel operator[] (const size_t index) const;
 
-          // TODO Define iteration constructs?
-
-          size_t size() const { return index_image.size (0); }
-          size_t size (const size_t) const;
+          size_t size() const { return num_fixels; }
+          size_t size (const size_t index) const { return index_data[2*index]; }
+
+          // Raw access to the CSR arrays
+          //   (the connections of fixel i are at positions offset(i) to offset(i)+size(i)-1)
+          uint64_t offset (const size_t index) const { return index_data[2*index+1]; }
+          FORCE_INLINE fixel_index_type fixel (const uint64_t position) const { return fixel_data[position]; }
+          FORCE_INLINE connectivity_value_type value (const uint64_t position) const {
+            switch (value_storage) {
+              case storage_t::UINT8:  return value_scale * connectivity_value_type (static_cast<const uint8_t*> (value_data)[position]);
+              case storage_t::UINT16: return value_scale * connectivity_value_type (static_cast<const uint16_t*> (value_data)[position]);
+              default: return static_cast<const connectivity_value_type*> (value_data)[position];
+            }
+          }
+          FORCE_INLINE bool in_mask (const size_t index) const { return mask.empty() || mask[index]; }
 
         protected:
+          enum class storage_t { FLOAT32, UINT16, UINT8 };
+
           const std::string directory;
-          // Not to be manipulated directly; need to copy in order to ensure thread-safety
+          size_t num_fixels;
+          vector<bool> mask;
+
+          // Retained only to keep the underlying data mapped / allocated;
+          //   only one of the value images is used, depending on the storage type
           Image<index_image_type> index_image;
           Image<fixel_index_type> fixel_image;
-          Image<connectivity_value_type> value_image;
-          Image<bool> mask_image;
-
+          Image<connectivity_value_type> value_image_float32;
+          Image<uint16_t> value_image_uint16;
+          Image<uint8_t> value_image_uint8;
+
+          const index_image_type* index_data;
+          const fixel_index_type* fixel_data;
+          const void* value_data;
+          storage_t value_storage;
+          connectivity_value_type value_scale;
 
       };
 
@@ -16,6 +16,8 @@
 
 #include "stats/cfe.h"
 
+#include "progressbar.h"
+
 namespace MR
 {
   namespace Stats
@@ -23,6 +25,45 @@ namespace MR
 
 
 
+    namespace
+    {
+      class NormMultipliers
+      { NOMEMALIGN
+        public:
+          NormMultipliers (const Fixel::Matrix::Reader& matrix, vector<Fixel::Matrix::connectivity_value_type>& norm_multipliers) :
+              matrix (matrix),
+              norm_multipliers (norm_multipliers) { }
+          template <class ValuesType>
+          void operator() (const ValuesType& values) const
+          {
+            for (size_t fixel = 0; fixel != matrix.size(); ++fixel)
+              norm_multipliers[fixel] = matrix.row (fixel, values).norm_multiplier();
+          }
+        private:
+          const Fixel::Matrix::Reader& matrix;
+          vector<Fixel::Matrix::connectivity_value_type>& norm_multipliers;
+      };
+    }
+
+
+
+    class CFE::Enhance
+    { NOMEMALIGN
+      public:
+        Enhance (const CFE& cfe, in_column_type stats, out_column_type enhanced_stats) :
+            cfe (cfe),
+            stats (stats),
+            enhanced_stats (enhanced_stats) { }
+        template <class ValuesType>
+        void operator() (const ValuesType& values) { cfe.enhance (values, stats, enhanced_stats); }
+      private:
+        const CFE& cfe;
+        in_column_type stats;
+        out_column_type enhanced_stats;
+    };
+
+
+
     CFE::CFE (const Fixel::Matrix::Reader& connectivity_matrix,
               const value_type dh,
               const value_type E,
@@ -34,51 +75,85 @@ namespace MR
         E (E),
         H (H),
         C (C),
-        normalise (norm) { }
+        normalise (norm),
+        norm_multipliers (matrix.size())
+    {
+      if (C == 1.0) {
+        matrix.visit_values (NormMultipliers (matrix, norm_multipliers));
+        return;
+      }
+      // Need to re-normalise based on the value of the power C
+      ProgressBar progress ("Pre-computing exponentiated fixel-fixel connectivity for CFE", matrix.size());
+      uint64_t num_connections = 0;
+      for (size_t fixel = 0; fixel != matrix.size(); ++fixel)
+        num_connections = std::max (num_connections, matrix.offset (fixel) + matrix.size (fixel));
+      exponentiated_values.resize (num_connections);
+      for (size_t fixel = 0; fixel != matrix.size(); ++fixel) {
+        default_type sum = 0.0;
+        for (uint64_t i = matrix.offset (fixel); i != matrix.offset (fixel) + matrix.size (fixel); ++i) {
+          // run once only, so resolving the storage type at each access is acceptable here:
+          exponentiated_values[i] = std::pow (matrix.value (i), Fixel::Matrix::connectivity_value_type (C));
+          if (matrix.in_mask (matrix.fixel (i)))
+            sum += exponentiated_values[i];
+        }
+        norm_multipliers[fixel] = sum ? Fixel::Matrix::connectivity_value_type (1) / Fixel::Matrix::connectivity_value_type (sum) : Fixel::Matrix::connectivity_value_type (0);
+        ++progress;
+      }
+    }
 
 
 
     void CFE::operator() (in_column_type stats, out_column_type enhanced_stats) const
+    {
+      if (exponentiated_values.size())
+        enhance (Fixel::Matrix::Reader::Values<Fixel::Matrix::connectivity_value_type> (exponentiated_values.data(), 1.0), stats, enhanced_stats);
+      else
+        matrix.visit_values (Enhance (*this, stats, enhanced_stats));
+    }
+
+
+
+    template <class ValuesType>
+    void CFE::enhance (const ValuesType& values, in_column_type stats, out_column_type enhanced_stats) const
     {
       enhanced_stats.setZero();
-      vector<default_type> connected_stats;
-      for (size_t fixel = 0; fixel < matrix.size(); ++fixel) {
-        if (stats[fixel] < dh)
+      const value_type max_stat = stats.maxCoeff();
+      if (!(max_stat >= dh))
+        return;
+
+      // Number of heights at which each fixel contributes to the extent of its neighbours
+      vector<uint32_t> levels (stats.size());
+      for (size_t fixel = 0; fixel != levels.size(); ++fixel)
+        levels[fixel] = stats[fixel] > dh && matrix.in_mask (fixel) ? uint32_t (std::floor (stats[fixel] / dh)) : 0;
+
+      const size_t max_levels = std::floor (max_stat / dh);
+      vector<value_type> h_pow_H (max_levels);
+      for (size_t ih = 0; ih != max_levels; ++ih)
+        h_pow_H[ih] = std::pow (dh*(ih+1), H);
+
+      // Rather than incrementing the extent at every height up to the statistic
+      //   of each connected fixel, accumulate each connection only at the highest
+      //   such height; the extent at each height is then the sum over all heights
+      //   above it
+      vector<Fixel::Matrix::connectivity_value_type> extents (max_levels);
+      for (size_t fixel = 0; fixel != matrix.size(); ++fixel) {
+        if (stats[fixel] < dh || !matrix.in_mask (fixel))
           continue;
-        auto connections = matrix[fixel];
-        // Need to re-normalise based on the value of the power C
-        if (C != 1.0) {
-          default_type sum = 0.0;
-          for (auto& c : connections) {
-            c.exponentiate (C);
-            sum += c.value();
-          }
-          connections.normalise (Fixel::Matrix::connectivity_value_type (sum));
-        }
-        // Rather than allocating data for the stats and then looping over dh,
-        //   divide statistic by dh to determine the number of cluster sizes that should
-        //   be incremented, and dynamically increment all cluster sizes for that
-        //   particular connected fixel
-        vector<Fixel::Matrix::connectivity_value_type> extents (std::floor (stats[fixel]/dh), Fixel::Matrix::connectivity_value_type(0));
-        for (const auto& connection : connections) {
-          const default_type connection_stat = stats[connection.index()];
-          if (connection_stat > dh) {
-            const size_t cluster_count = std::min (extents.size(), size_t(std::floor (connection_stat / dh)));
-            for (size_t cluster_index = 0; cluster_index != cluster_count; ++cluster_index)
-              extents[cluster_index] += connection.value();
-          }
+        const uint32_t num_levels = std::floor (stats[fixel] / dh);
+        std::fill (extents.begin(), extents.begin() + num_levels, Fixel::Matrix::connectivity_value_type (0));
+        const uint64_t end = matrix.offset (fixel) + matrix.size (fixel);
+        for (uint64_t i = matrix.offset (fixel); i != end; ++i) {
+          const uint32_t connection_levels = levels[matrix.fixel (i)];
+          if (connection_levels)
+            extents[std::min (connection_levels, num_levels) - 1] += values[i];
         }
-        // Pre-calculate h^H
-        if (h_pow_H.size() < extents.size()) {
-          const size_t old_size = h_pow_H.size();
-          h_pow_H.resize (extents.size());
-          for (size_t ih = old_size; ih != h_pow_H.size(); ++ih)
-            h_pow_H[ih] = std::pow (dh*(ih+1), H);
+        value_type sum = 0.0;
+        Fixel::Matrix::connectivity_value_type extent (0);
+        for (size_t ih = num_levels; ih--; ) {
+          extent += extents[ih];
+          sum += std::pow (extent, E) * h_pow_H[ih];
         }
-        for (size_t cluster_index = 0; cluster_index != extents.size(); ++cluster_index)
-          enhanced_stats[fixel] += std::pow (extents[cluster_index], E) * h_pow_H[cluster_index];
-        if (normalise)
-          enhanced_stats[fixel] *= connections.norm_multiplier;
+        enhanced_stats[fixel] = normalise ? sum * norm_multipliers[fixel] : sum;
       }
     }
 
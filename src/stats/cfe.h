@@ -46,9 +46,17 @@ namespace MR
         const value_type dh, E, H, C;
         const bool normalise;
 
-        mutable vector<value_type> h_pow_H;
+        // Connectivity values raised to the power C, computed once on construction
+        //   (only if C != 1); these are stored at the same positions as in the matrix
+        vector<Fixel::Matrix::connectivity_value_type> exponentiated_values;
+        vector<Fixel::Matrix::connectivity_value_type> norm_multipliers;
 
         void operator() (in_column_type, out_column_type) const override;
+
+        // The enhancement proper, for a given accessor of the connectivity values
+        template <class ValuesType>
+        void enhance (const ValuesType& values, in_column_type, out_column_type) const;
+        class Enhance;
     };
 
 
@@ -37,6 +37,83 @@ namespace MR
 
 
 
+
+      void ClusterSizeTFCE::operator() (in_column_type input, out_column_type output) const
+      {
+        using index_t = Filter::Connector::Adjacency::index_t;
+        const index_t none = std::numeric_limits<index_t>::max();
+        const size_t num_elements = input.size();
+        output.setZero();
+
+        // Only those elements exceeding the lowest height can contribute
+        vector<index_t> order;
+        for (size_t i = 0; i != num_elements; ++i) {
+          if (input[i] > dH)
+            order.push_back (i);
+        }
+        if (order.empty())
+          return;
+        std::sort (order.begin(), order.end(), [&] (const index_t a, const index_t b) { return input[a] > input[b]; });
+
+        // Union-find forest; only the entries of the root of each cluster
+        //   hold its size, & the running TFCE sum at which that size was reached.
+        //   The enhanced statistic of an element is the sum of the contributions
+        //   along its path to the root.
+        vector<index_t> parent (num_elements, none);
+        vector<uint32_t> size (num_elements, 0);
+        vector<value_type> since (num_elements, 0.0), contribution (num_elements, 0.0);
+
+        // Sum of h^H over all heights above the current one
+        value_type height_sum = 0.0;
+
+        auto find = [&] (index_t i) { while (parent[i] != i) i = parent[i]; return i; };
+        auto update = [&] (const index_t root) {
+          contribution[root] += std::pow (value_type(size[root]), E) * (height_sum - since[root]);
+          since[root] = height_sum;
+        };
+
+        size_t next = 0;
+        for (size_t level = std::ceil (input[order[0]] / dH); level; --level) {
+          const value_type h = level * dH;
+          for (; next != order.size() && input[order[next]] > h; ++next) {
+            const index_t i = order[next];
+            parent[i] = i;
+            size[i] = 1;
+            since[i] = height_sum;
+            for (const auto j : connector.adjacency[i]) {
+              if (parent[j] == none)
+                continue;
+              index_t a = find (i), b = find (j);
+              if (a == b)
+                continue;
+              update (a);
+              update (b);
+              // Union by size, keeping the trees shallow
+              if (size[a] < size[b])
+                std::swap (a, b);
+              parent[b] = a;
+              contribution[b] -= contribution[a];
+              size[a] += size[b];
+            }
+          }
+          height_sum += std::pow (h, H);
+        }
+
+        for (const auto i : order) {
+          if (parent[i] == i)
+            update (i);
+        }
+        for (const auto i : order) {
+          value_type sum = 0.0;
+          index_t j = i;
+          for (; parent[j] != j; j = parent[j])
+            sum += contribution[j];
+          output[i] = sum + contribution[j];
+        }
+      }
+
+
+
     }
   }
 }
@@ -56,6 +56,30 @@ namespace MR
 
           void operator() (in_column_type, const value_type, out_column_type) const override;
       };
+
+
+
+      /*! TFCE enhancement of cluster size, computed in a single pass
+       * Rather than running connected components at each height in turn (as is
+       * done when wrapping ClusterSize in a TFCE::Wrapper), elements are visited
+       * in order of decreasing statistic, and merged into clusters using a
+       * union-find structure as the height is lowered. The TFCE integral of each
+       * cluster is only updated when that cluster grows or merges with another,
+       * and is propagated lazily to its members; the cost therefore no longer
+       * scales with the number of heights times the number of elements. */
+      class ClusterSizeTFCE : public Stats::EnhancerBase
+      { MEMALIGN (ClusterSizeTFCE)
+        public:
+          ClusterSizeTFCE (const Filter::Connector& connector, const value_type dh, const value_type e, const value_type h) :
+                           connector (connector), dH (dh), E (e), H (h) { }
+          virtual ~ClusterSizeTFCE() { }
+
+        protected:
+          const Filter::Connector& connector;
+          const value_type dH, E, H;
+
+          void operator() (in_column_type, out_column_type) const override;
+      };
       //! @}
 
 
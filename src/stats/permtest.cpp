@@ -16,6 +16,8 @@
 
 #include "stats/permtest.h"
 
+#include "file/config.h"
+
 namespace MR
 {
   namespace Stats
@@ -37,7 +39,6 @@ namespace MR
           global_enhanced_count (global_enhanced_count),
           enhanced_sum (matrix_type::Zero (stats_calculator->num_elements(), stats_calculator->num_hypotheses())),
           enhanced_count (count_matrix_type::Zero (stats_calculator->num_elements(), stats_calculator->num_hypotheses())),
-          stats (global_enhanced_sum.rows(), global_enhanced_sum.cols()),
           enhanced_stats (global_enhanced_sum.rows(), global_enhanced_sum.cols()),
           mutex (new std::mutex())
       {
@@ -56,17 +57,19 @@ namespace MR
 
 
 
-      bool PreProcessor::operator() (const Math::Stats::Shuffle& shuffle)
+      bool PreProcessor::operator() (const Math::Stats::ShuffleBatch& shuffles)
       {
-        if (!shuffle.data.rows())
+        if (!shuffles.size())
           return false;
-        (*stats_calculator) (shuffle.data, stats);
-        (*enhancer) (stats, enhanced_stats);
-        for (size_t ih = 0; ih != stats_calculator->num_hypotheses(); ++ih) {
-          for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
-            if (enhanced_stats(ie, ih) > 0.0) {
-              enhanced_sum(ie, ih) += std::pow (enhanced_stats(ie, ih), skew);
-              enhanced_count(ie, ih)++;
+        (*stats_calculator) (shuffles.data, stats);
+        for (const auto& shuffle_stats : stats) {
+          (*enhancer) (shuffle_stats, enhanced_stats);
+          for (size_t ih = 0; ih != stats_calculator->num_hypotheses(); ++ih) {
+            for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
+              if (enhanced_stats(ie, ih) > 0.0) {
+                enhanced_sum(ie, ih) += std::pow (enhanced_stats(ie, ih), skew);
+                enhanced_count(ie, ih)++;
+              }
             }
           }
         }
@@ -90,7 +93,6 @@ namespace MR
           enhancer (enhancer),
           empirical_enhanced_statistics (empirical_enhanced_statistics),
           default_enhanced_statistics (default_enhanced_statistics),
-          statistics (stats_calculator->num_elements(), stats_calculator->num_hypotheses()),
           enhanced_statistics (stats_calculator->num_elements(), stats_calculator->num_hypotheses()),
           null_dist (perm_dist),
           global_null_dist_contributions (perm_dist_contributions),
@@ -113,33 +115,37 @@ namespace MR
 
 
 
-      bool Processor::operator() (const Math::Stats::Shuffle& shuffle)
+      bool Processor::operator() (const Math::Stats::ShuffleBatch& shuffles)
       {
-        (*stats_calculator) (shuffle.data, statistics);
-        if (enhancer)
-          (*enhancer) (statistics, enhanced_statistics);
-        else
-          enhanced_statistics = statistics;
-
-        if (empirical_enhanced_statistics.size())
-          enhanced_statistics.array() /= empirical_enhanced_statistics.array();
-
-        if (null_dist.cols() == 1) { // strong fwe control
-          ssize_t max_element, max_hypothesis;
-          null_dist(shuffle.index, 0) = enhanced_statistics.maxCoeff (&max_element, &max_hypothesis);
-          null_dist_contribution_counter(max_element, max_hypothesis)++;
-        } else { // weak fwe control
-          ssize_t max_index;
-          for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
-            null_dist(shuffle.index, ih) = enhanced_statistics.col (ih).maxCoeff (&max_index);
-            null_dist_contribution_counter(max_index, ih)++;
+        (*stats_calculator) (shuffles.data, statistics);
+
+        for (size_t is = 0; is != shuffles.size(); ++is) {
+          if (enhancer)
+            (*enhancer) (statistics[is], enhanced_statistics);
+          else
+            enhanced_statistics = statistics[is];
+
+          if (empirical_enhanced_statistics.size())
+            enhanced_statistics.array() /= empirical_enhanced_statistics.array();
+
+          const size_t index = shuffles.index[is];
+          if (null_dist.cols() == 1) { // strong fwe control
+            ssize_t max_element, max_hypothesis;
+            null_dist(index, 0) = enhanced_statistics.maxCoeff (&max_element, &max_hypothesis);
+            null_dist_contribution_counter(max_element, max_hypothesis)++;
+          } else { // weak fwe control
+            ssize_t max_index;
+            for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
+              null_dist(index, ih) = enhanced_statistics.col (ih).maxCoeff (&max_index);
+              null_dist_contribution_counter(max_index, ih)++;
+            }
           }
-        }
 
-        for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
-          for (ssize_t ie = 0; ie != enhanced_statistics.rows(); ++ie) {
-            if (default_enhanced_statistics(ie, ih) > enhanced_statistics(ie, ih))
-              uncorrected_pvalue_counter(ie, ih)++;
+          for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
+            for (ssize_t ie = 0; ie != enhanced_statistics.rows(); ++ie) {
+              if (default_enhanced_statistics(ie, ih) > enhanced_statistics(ie, ih))
+                uncorrected_pvalue_counter(ie, ih)++;
+            }
           }
         }
 
@@ -152,6 +158,28 @@ namespace MR
 
 
 
+      size_t batch_size (const size_t num_shuffles)
+      {
+        //CONF option: StatsShuffleBatchSize
+        //CONF default: 16
+        //CONF The maximal number of shuffles for which the GLM is evaluated
+        //CONF together during permutation testing in statistical inference
+        //CONF commands. For fixed designs, the regression of the data
+        //CONF against the nuisance variables is then shared between all
+        //CONF shuffles of the batch, which is substantially faster than
+        //CONF processing them one at a time; set to 1 to disable batching.
+        static const size_t max_batch_size = std::max (File::Config::get_int ("StatsShuffleBatchSize", 16), 1);
+        // Ensure there remain enough batches to keep all threads busy
+        const size_t num_threads = std::max (Thread::number_of_threads(), size_t(1));
+        return std::max (std::min (max_batch_size, num_shuffles / (4 * num_threads)), size_t(1));
+      }
+
+
+
+
+
+
+
       void precompute_empirical_stat (const std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator,
                                       const std::shared_ptr<EnhancerBase> enhancer,
                                       const default_type skew,
@@ -162,8 +190,9 @@ namespace MR
         count_matrix_type global_enhanced_count (count_matrix_type::Zero (stats_calculator->num_elements(), stats_calculator->num_hypotheses()));
         {
           Math::Stats::Shuffler shuffler (stats_calculator->num_inputs(), true, "Pre-computing empirical statistic for non-stationarity correction");
+          shuffler.set_batch_size (batch_size (shuffler.size()));
           PreProcessor preprocessor (stats_calculator, enhancer, skew, empirical_statistic, global_enhanced_count);
-          Thread::run_queue (shuffler, Math::Stats::Shuffle(), Thread::multi (preprocessor));
+          Thread::run_queue (shuffler, Math::Stats::ShuffleBatch(), Thread::multi (preprocessor));
         }
         for (size_t contrast = 0; contrast != stats_calculator->num_hypotheses(); ++contrast) {
           for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
@@ -220,6 +249,7 @@ namespace MR
       {
         assert (stats_calculator);
         Math::Stats::Shuffler shuffler (stats_calculator->num_inputs(), false, "Running permutations");
+        shuffler.set_batch_size (batch_size (shuffler.size()));
         null_dist.resize (shuffler.size(), fwe_strong ? 1 : stats_calculator->num_hypotheses());
         null_dist_contributions = count_matrix_type::Zero (stats_calculator->num_elements(), stats_calculator->num_hypotheses());
 
@@ -231,7 +261,7 @@ namespace MR
                                null_dist,
                                null_dist_contributions,
                                global_uncorrected_pvalue_count);
-          Thread::run_queue (shuffler, Math::Stats::Shuffle(), Thread::multi (processor));
+          Thread::run_queue (shuffler, Math::Stats::ShuffleBatch(), Thread::multi (processor));
         }
         uncorrected_pvalues = global_uncorrected_pvalue_count.cast<default_type>() / default_type(shuffler.size());
       }
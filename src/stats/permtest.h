@@ -64,7 +64,7 @@ namespace MR
 
           ~PreProcessor();
 
-          bool operator() (const Math::Stats::Shuffle&);
+          bool operator() (const Math::Stats::ShuffleBatch&);
 
         protected:
           std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator;
@@ -74,7 +74,7 @@ namespace MR
           count_matrix_type& global_enhanced_count;
           matrix_type enhanced_sum;
           count_matrix_type enhanced_count;
-          matrix_type stats;
+          vector<matrix_type> stats;
           matrix_type enhanced_stats;
           std::shared_ptr<std::mutex> mutex;
       };
@@ -95,14 +95,14 @@ namespace MR
 
           ~Processor();
 
-          bool operator() (const Math::Stats::Shuffle&);
+          bool operator() (const Math::Stats::ShuffleBatch&);
 
         protected:
           std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator;
           std::shared_ptr<EnhancerBase> enhancer;
           const matrix_type& empirical_enhanced_statistics;
           const matrix_type& default_enhanced_statistics;
-          matrix_type statistics;
+          vector<matrix_type> statistics;
           matrix_type enhanced_statistics;
           matrix_type& null_dist;
           count_matrix_type& global_null_dist_contributions;
@@ -115,6 +115,12 @@ namespace MR
 
 
 
+      // The number of shuffles to be processed together by each thread
+      size_t batch_size (const size_t num_shuffles);
+
+
+
+
       // Precompute the empircal test statistic for non-stationarity adjustment
       void precompute_empirical_stat (const std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator,
                                       const std::shared_ptr<EnhancerBase> enhancer,
@@ -0,0 +1,162 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "header.h"
+#include "image.h"
+#include "timer.h"
+#include "adapter/base.h"
+#include "algo/loop.h"
+#include "interp/cubic.h"
+#include "interp/linear.h"
+#include "math/rng.h"
+
+
+using namespace MR;
+using namespace App;
+
+
+void usage ()
+{
+  AUTHOR = "J-Donald Tournier (jdtournier@gmail.com)";
+  SYNOPSIS = "Measure the performance of linear & cubic interpolation with & without direct access to the image data";
+
+  DESCRIPTION
+  + "A 4D image filled with random values is interpolated at random positions, "
+    "either one volume at a time (using value()) or for all volumes at once "
+    "(using row()). For each interpolator, the same positions are processed "
+    "with the image accessed directly in RAM (using precomputed memory offsets), "
+    "and via an adapter that hides direct access (as for the original "
+    "implementation), and the number of positions processed per second is "
+    "reported for each. The results obtained are also checked to be identical.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("size", "the size of the image along each spatial axis (default: 64)")
+    + Argument ("number").type_integer (4)
+
+  + Option ("volumes", "the number of volumes in the image (default: 45)")
+    + Argument ("number").type_integer (1)
+
+  + Option ("positions", "the number of positions to interpolate at (default: 100000)")
+    + Argument ("number").type_integer (1)
+
+  + Option ("spatially_contiguous", "store the image with its spatial axes contiguous in memory, "
+                                    "rather than its volumes");
+}
+
+
+
+// hides direct access to the image data, so that the interpolators
+// fall back to setting the image indices & fetching each value in turn:
+class Indirect : public Adapter::Base<Indirect, Image<float>> { MEMALIGN (Indirect)
+  public:
+    using base_type = Adapter::Base<Indirect, Image<float>>;
+    Indirect (const Image<float>& parent) : base_type (parent) { }
+};
+
+
+
+using Matrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic>;
+
+
+
+template <class InterpType>
+double run_values (InterpType& interp, const vector<Eigen::Vector3d>& positions, Matrix& results)
+{
+  Timer timer;
+  for (size_t n = 0; n < positions.size(); ++n) {
+    interp.voxel (positions[n]);
+    for (ssize_t v = 0; v < interp.size(3); ++v) {
+      interp.index(3) = v;
+      results (v, n) = interp.value();
+    }
+  }
+  return positions.size() / timer.elapsed();
+}
+
+
+
+template <class InterpType>
+double run_rows (InterpType& interp, const vector<Eigen::Vector3d>& positions, Matrix& results)
+{
+  Timer timer;
+  for (size_t n = 0; n < positions.size(); ++n) {
+    interp.voxel (positions[n]);
+    results.col (n) = interp.row (3);
+  }
+  return positions.size() / timer.elapsed();
+}
+
+
+
+template <template <class> class InterpType>
+void compare (const std::string& name, Image<float>& image, const vector<Eigen::Vector3d>& positions)
+{
+  InterpType<Image<float>> direct (image);
+  const Indirect indirect_image (image);
+  InterpType<Indirect> indirect (indirect_image);
+  Matrix direct_results (image.size(3), positions.size()), indirect_results (image.size(3), positions.size());
+
+  for (size_t mode = 0; mode < 2; ++mode) {
+    const double indirect_rate = mode ? run_rows (indirect, positions, indirect_results) : run_values (indirect, positions, indirect_results);
+    const double direct_rate = mode ? run_rows (direct, positions, direct_results) : run_values (direct, positions, direct_results);
+    if (direct_results != indirect_results)
+      throw Exception ("mismatch between direct & indirect " + name + " interpolation");
+    std::cout << name << "\t" << (mode ? "row" : "value") << "\t" << str(indirect_rate, 4) << "\t"
+      << str(direct_rate, 4) << "\t" << str(direct_rate / indirect_rate, 3) << "\n";
+  }
+}
+
+
+
+void run ()
+{
+  const size_t size = get_option_value<size_t> ("size", 64);
+  const size_t num_volumes = get_option_value<size_t> ("volumes", 45);
+  const size_t num_positions = get_option_value<size_t> ("positions", 100000);
+
+  Header header;
+  header.ndim() = 4;
+  for (size_t n = 0; n < 3; ++n) {
+    header.size(n) = size;
+    header.spacing(n) = 1.0;
+  }
+  header.size(3) = num_volumes;
+  header.spacing(3) = 1.0;
+  header.transform().setIdentity();
+  Stride::set (header, get_options ("spatially_contiguous").size() ?
+      Stride::contiguous_along_spatial_axes (header) : Stride::contiguous_along_axis (3, header));
+
+  auto image = Image<float>::scratch (header, "random data");
+  Math::RNG::Uniform<float> rng;
+  for (auto l = Loop (image) (image); l; ++l)
+    image.value() = rng();
+
+  // include positions right up to the edges of the image, where
+  // neighbours need to be clamped:
+  Math::RNG::Uniform<double> position_rng;
+  vector<Eigen::Vector3d> positions (num_positions);
+  for (auto& p : positions)
+    for (size_t n = 0; n < 3; ++n)
+      p[n] = -0.49 + (size - 0.02) * position_rng();
+
+  std::cout << "interp\tmode\tindirect (positions/s)\tdirect (positions/s)\tspeedup\n";
+  compare<Interp::Linear> ("linear", image, positions);
+  compare<Interp::Cubic> ("cubic", image, positions);
+}
+
@@ -0,0 +1,167 @@
+/* Copyright (c) 2008-2021 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <atomic>
+
+#include "command.h"
+#include "exception.h"
+#include "thread_queue.h"
+#include "timer.h"
+
+
+using namespace MR;
+using namespace App;
+
+
+void usage ()
+{
+  AUTHOR = "J-Donald Tournier (jdtournier@gmail.com)";
+  SYNOPSIS = "Measure the throughput of Thread::Queue for its mutex-based and lock-free backends";
+
+  DESCRIPTION
+  + "For each number of threads requested, the same number of writer & reader "
+    "threads are run concurrently on a single queue, and the number of items "
+    "passed through the queue per second is reported for each backend.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("threads", "the numbers of writer (& reader) threads to test (default: 1,2,4,8,16,32)")
+    + Argument ("list").type_sequence_int()
+
+  + Option ("items", "the total number of items to pass through the queue (default: 1000000)")
+    + Argument ("number").type_integer (1)
+
+  + Option ("work", "the number of iterations of a dummy computation to perform per item "
+                    "in both writers & readers, to mimic a realistic workload (default: 0)")
+    + Argument ("number").type_integer (0)
+
+  + Option ("capacity", "the capacity of the queue (default: " + str(MRTRIX_QUEUE_DEFAULT_CAPACITY) + ")")
+    + Argument ("number").type_integer (1);
+}
+
+
+
+using ItemQueue = Thread::Queue<size_t>;
+
+size_t work;
+// accumulates the results of dummy_work() to prevent it being optimised away:
+std::atomic<size_t> work_checksum (0);
+
+inline size_t dummy_work (size_t value)
+{
+  for (size_t n = 0; n < work; ++n)
+    value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+  return value;
+}
+
+
+
+class Writer { NOMEMALIGN
+  public:
+    Writer (ItemQueue& queue, std::atomic<size_t>& next, size_t num_items) :
+      writer (queue), next (next), num_items (num_items) { }
+
+    void execute () {
+      auto out = writer.placeholder();
+      size_t n, checksum = 0;
+      while ((n = next++) < num_items) {
+        checksum += dummy_work (n);
+        *out = n;
+        if (!out.write())
+          break;
+      }
+      work_checksum += checksum;
+    }
+
+  protected:
+    ItemQueue::Writer writer;
+    std::atomic<size_t>& next;
+    const size_t num_items;
+};
+
+
+
+class Reader { NOMEMALIGN
+  public:
+    Reader (ItemQueue& queue, std::atomic<size_t>& count, std::atomic<size_t>& sum) :
+      reader (queue), count (count), sum (sum) { }
+
+    void execute () {
+      auto in = reader.placeholder();
+      size_t local_count = 0, local_sum = 0, checksum = 0;
+      while (in.read()) {
+        checksum += dummy_work (*in);
+        local_sum += *in;
+        ++local_count;
+      }
+      count += local_count;
+      sum += local_sum;
+      work_checksum += checksum;
+    }
+
+  protected:
+    ItemQueue::Reader reader;
+    std::atomic<size_t>& count;
+    std::atomic<size_t>& sum;
+};
+
+
+
+double throughput (size_t num_threads, size_t num_items, size_t capacity, bool lock_free)
+{
+  ItemQueue queue ("benchmark", capacity, lock_free);
+  std::atomic<size_t> next (0), count (0), sum (0);
+  Writer writer (queue, next, num_items);
+  Reader reader (queue, count, sum);
+
+  Timer timer;
+  {
+    auto writers = Thread::run (Thread::multi (writer, num_threads), "writers");
+    auto readers = Thread::run (Thread::multi (reader, num_threads), "readers");
+    writers.wait();
+    readers.wait();
+  }
+  const double elapsed = timer.elapsed();
+
+  if (count != num_items || sum != num_items * (num_items-1) / 2)
+    throw Exception ("items lost in " + std::string (lock_free ? "lock-free" : "mutex-based")
+        + " queue with " + str(num_threads) + " threads: expected " + str(num_items) + ", received " + str(count.load()));
+  return num_items / elapsed;
+}
+
+
+
+void run ()
+{
+  vector<int> thread_counts = { 1, 2, 4, 8, 16, 32 };
+  auto opt = get_options ("threads");
+  if (opt.size())
+    thread_counts = parse_ints<int> (opt[0][0]);
+  const size_t num_items = get_option_value<size_t> ("items", 1000000);
+  const size_t capacity = get_option_value<size_t> ("capacity", MRTRIX_QUEUE_DEFAULT_CAPACITY);
+  work = get_option_value<size_t> ("work", 0);
+
+  std::cout << "threads\tmutex (items/s)\tlock-free (items/s)\tspeedup\n";
+  for (auto n : thread_counts) {
+    if (n < 1)
+      throw Exception ("number of threads must be positive");
+    const double mutex_rate = throughput (n, num_items, capacity, false);
+    const double lock_free_rate = throughput (n, num_items, capacity, true);
+    std::cout << n << "\t" << str(mutex_rate, 4) << "\t" << str(lock_free_rate, 4) << "\t" << str(lock_free_rate / mutex_rate, 3) << "\n";
+  }
+}
+